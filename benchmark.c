@@ -0,0 +1,235 @@
+#include "benchmark.h"
+
+/*
+        Mide cada etapa (parseo, validación, compilación, derivación de una
+        palabra y generación masiva en un hilo) sobre gramáticas sintéticas de
+        10 a 10000 producciones. Las gramáticas y las palabras se generan con
+        una semilla fija, así dos corridas de distintas compilaciones miden el
+        mismo trabajo y sus salidas (CSV o JSON) se pueden comparar.
+        Cada gramática sintética usa todos los terminales y un no terminal
+        cada cuatro producciones (de 2 a 2500): los primeros 26 son mayúsculas
+        y el resto se llaman "<N26>", "<N27>", ... Cada no terminal tiene al
+        menos una producción terminal y una de cada cuatro de las demás
+        producciones también es terminal, así que la longitud esperada de las
+        palabras es acotada.
+ */
+
+#define SEMILLA_BENCHMARK 0x5EED
+
+// Cantidad de producciones procesadas por etapa: las gramáticas chicas se repiten más veces.
+#define TRABAJO_BENCHMARK 2000000
+
+// Cantidad de palabras generadas en las etapas de derivación y generación.
+#define PALABRAS_BENCHMARK 1000000
+
+#define PALABRAS_POR_LOTE_BENCHMARK 1024
+
+typedef struct {
+    char *cadenaProducciones;
+    char *copiaProducciones;    // parsearProducciones modifica la cadena, así que se parsea una copia.
+    size_t longitudProducciones;
+    Gramatica *gramatica;
+    GramaticaCompilada *compilada;
+    GeneradorAleatorio generador;
+    BufferPalabras palabras;
+} ContextoBenchmark;
+
+typedef bool (*OperacionBenchmark)(ContextoBenchmark* contexto);
+
+typedef struct {
+    const char *etapa;
+    int cantidadProducciones;
+    int cantidadNoTerminales;
+    size_t operaciones;
+    double segundos;
+    size_t palabrasPorOperacion;    // 0 si la etapa no genera palabras.
+    size_t asignaciones;
+    size_t picoHeap;
+} ResultadoBenchmark;
+
+// Agrega el nombre del no terminal sintético: una mayúscula para los primeros 26 y "<N26>", "<N27>", ... para el resto.
+static bool agregarNoTerminalSintetico(BufferPalabras *cadena, const int indice) {
+    char nombre[16];
+    const int longitud = indice < 26 ? snprintf(nombre, sizeof(nombre), "%c", SIMBOLOS_NO_TERMINALES[indice])
+                                     : snprintf(nombre, sizeof(nombre), "<N%d>", indice);
+    if (!reservarBufferPalabras(cadena, cadena->longitud + longitud + 1)) {
+        return false;
+    }
+    memcpy(cadena->datos + cadena->longitud, nombre, longitud + 1);
+    cadena->longitud += longitud;
+    return true;
+}
+
+// Arma la lista de producciones "S->aT,..." de una gramática sintética lineal a derecha.
+static char *generarProduccionesSinteticas(const int cantidadProducciones, const int cantidadNoTerminales, GeneradorAleatorio *generador) {
+    BufferPalabras cadena;
+    inicializarBufferPalabras(&cadena, MEMORIA_PARSEO);
+    for (int i = 0; i < cantidadProducciones; i++) {
+        if (!agregarNoTerminalSintetico(&cadena, i % cantidadNoTerminales) || !reservarBufferPalabras(&cadena, cadena.longitud + 4)) {
+            liberarBufferPalabras(&cadena);
+            return NULL;
+        }
+        cadena.datos[cadena.longitud++] = '-';
+        cadena.datos[cadena.longitud++] = '>';
+        cadena.datos[cadena.longitud++] = SIMBOLOS_TERMINALES[aleatorioEnRango(generador, 26)];
+        if (i >= cantidadNoTerminales && aleatorioEnRango(generador, 4) != 0 &&
+            !agregarNoTerminalSintetico(&cadena, aleatorioEnRango(generador, cantidadNoTerminales))) {
+            liberarBufferPalabras(&cadena);
+            return NULL;
+        }
+        cadena.datos[cadena.longitud++] = i + 1 < cantidadProducciones ? ',' : '\0';
+    }
+    return cadena.datos;
+}
+
+static bool operacionParseo(ContextoBenchmark *contexto) {
+    memcpy(contexto->copiaProducciones, contexto->cadenaProducciones, contexto->longitudProducciones + 1);
+    int cantidadProducciones;
+    Produccion *producciones = parsearProducciones(contexto->copiaProducciones, &contexto->gramatica->noTerminales, &cantidadProducciones);
+    tfree(producciones);
+    return producciones != NULL;
+}
+
+static bool operacionValidacion(ContextoBenchmark *contexto) {
+    return cumpleValidaciones(contexto->gramatica);
+}
+
+static bool operacionCompilacion(ContextoBenchmark *contexto) {
+    GramaticaCompilada *compilada = compilarGramatica(contexto->gramatica);
+    destruirGramaticaCompilada(compilada);
+    return compilada != NULL;
+}
+
+static bool operacionDerivacion(ContextoBenchmark *contexto) {
+    char *palabra = generarPalabraAleatoria(contexto->compilada, &contexto->generador, false);
+    tfree(palabra);
+    return palabra != NULL;
+}
+
+static bool operacionGeneracion(ContextoBenchmark *contexto) {
+    contexto->palabras.longitud = 0;
+    return generarPalabras(contexto->compilada, &contexto->generador, PALABRAS_POR_LOTE_BENCHMARK, &contexto->palabras) == PALABRAS_POR_LOTE_BENCHMARK;
+}
+
+static bool medirEtapa(ContextoBenchmark *contexto, const OperacionBenchmark operacion, const size_t repeticiones, ResultadoBenchmark *resultado) {
+    volcarContadoresMemoria();
+    reiniciarPicoMemoria();
+    const size_t asignacionesIniciales = atomic_load(&heapUsado[CANTIDAD_SUBSISTEMAS].asignaciones);
+    const double inicio = obtenerTiempoSegundos();
+    for (size_t i = 0; i < repeticiones; i++) {
+        if (!operacion(contexto)) {
+            return false;
+        }
+    }
+    resultado->segundos = obtenerTiempoSegundos() - inicio;
+    volcarContadoresMemoria();
+    resultado->operaciones = repeticiones;
+    resultado->asignaciones = atomic_load(&heapUsado[CANTIDAD_SUBSISTEMAS].asignaciones) - asignacionesIniciales;
+    resultado->picoHeap = atomic_load(&heapUsado[CANTIDAD_SUBSISTEMAS].pico);
+    return true;
+}
+
+static void mostrarResultadoBenchmark(const ResultadoBenchmark *resultado, const FormatoBenchmark formato, const bool esPrimero, FILE *salida) {
+    const double nsPorOperacion = resultado->segundos * 1e9 / (double)resultado->operaciones;
+    const double palabrasPorSegundo = resultado->segundos > 0 ? (double)(resultado->operaciones * resultado->palabrasPorOperacion) / resultado->segundos : 0.0;
+    const double asignacionesPorOperacion = (double)resultado->asignaciones / (double)resultado->operaciones;
+    if (formato == FORMATO_CSV) {
+        fprintf(salida, "%s,%d,%d,%zu,%.1f,%.0f,%.3f,%zu\n", resultado->etapa, resultado->cantidadProducciones, resultado->cantidadNoTerminales,
+                resultado->operaciones, nsPorOperacion, palabrasPorSegundo, asignacionesPorOperacion, resultado->picoHeap);
+    } else {
+        fprintf(salida, "%s  {\"etapa\": \"%s\", \"producciones\": %d, \"no_terminales\": %d, \"operaciones\": %zu, \"ns_por_op\": %.1f, "
+                "\"palabras_por_s\": %.0f, \"asignaciones_por_op\": %.3f, \"pico_heap_bytes\": %zu}",
+                esPrimero ? "" : ",\n", resultado->etapa, resultado->cantidadProducciones, resultado->cantidadNoTerminales,
+                resultado->operaciones, nsPorOperacion, palabrasPorSegundo, asignacionesPorOperacion, resultado->picoHeap);
+    }
+}
+
+static void destruirContextoBenchmark(ContextoBenchmark *contexto) {
+    tfree(contexto->cadenaProducciones);
+    tfree(contexto->copiaProducciones);
+    destruirGramatica(contexto->gramatica);
+    destruirGramaticaCompilada(contexto->compilada);
+    liberarBufferPalabras(&contexto->palabras);
+}
+
+static bool prepararContextoBenchmark(ContextoBenchmark *contexto, const int cantidadProducciones, const int cantidadNoTerminales) {
+    memset(contexto, 0, sizeof(ContextoBenchmark));
+    inicializarBufferPalabras(&contexto->palabras, MEMORIA_GENERACION);
+    sembrarGenerador(&contexto->generador, SEMILLA_BENCHMARK + cantidadProducciones);
+    contexto->cadenaProducciones = generarProduccionesSinteticas(cantidadProducciones, cantidadNoTerminales, &contexto->generador);
+    if (contexto->cadenaProducciones == NULL) {
+        return false;
+    }
+    contexto->longitudProducciones = strlen(contexto->cadenaProducciones);
+    contexto->copiaProducciones = tmalloc(contexto->longitudProducciones + 1, MEMORIA_PARSEO);
+    BufferPalabras noTerminales;
+    inicializarBufferPalabras(&noTerminales, MEMORIA_PARSEO);
+    bool hayNoTerminales = true;
+    for (int i = 0; i < cantidadNoTerminales && hayNoTerminales; i++) {
+        hayNoTerminales = agregarNoTerminalSintetico(&noTerminales, i);
+    }
+    const char axioma[2] = {SIMBOLOS_NO_TERMINALES[0], '\0'};
+    if (hayNoTerminales) {
+        contexto->gramatica = crearGramaticaDesdeCadenas(noTerminales.datos, SIMBOLOS_TERMINALES, contexto->cadenaProducciones, axioma);
+    }
+    liberarBufferPalabras(&noTerminales);
+    if (contexto->copiaProducciones == NULL || contexto->gramatica == NULL || !cumpleValidaciones(contexto->gramatica)) {
+        return false;
+    }
+    contexto->compilada = compilarGramatica(contexto->gramatica);
+    return contexto->compilada != NULL;
+}
+
+// Corre todas las etapas sobre cada tamaño de gramática y escribe una fila (u objeto JSON) por etapa y tamaño.
+bool ejecutarBenchmark(const FormatoBenchmark formato, FILE *salida) {
+    static const int TAMANIOS[] = {10, 100, 1000, 10000};
+    static const struct {
+        const char *etapa;
+        OperacionBenchmark operacion;
+        bool porProduccion;     // Si el costo de la operación crece con la cantidad de producciones.
+        size_t palabrasPorOperacion;
+    } ETAPAS[] = {
+        {"parseo", operacionParseo, true, 0},
+        {"validacion", operacionValidacion, true, 0},
+        {"compilacion", operacionCompilacion, true, 0},
+        {"derivacion", operacionDerivacion, false, 1},
+        {"generacion", operacionGeneracion, false, PALABRAS_POR_LOTE_BENCHMARK},
+    };
+    if (formato == FORMATO_CSV) {
+        fprintf(salida, "etapa,producciones,no_terminales,operaciones,ns_por_op,palabras_por_s,asignaciones_por_op,pico_heap_bytes\n");
+    } else {
+        fprintf(salida, "[\n");
+    }
+    bool esPrimero = true;
+    for (size_t t = 0; t < sizeof(TAMANIOS) / sizeof(TAMANIOS[0]); t++) {
+        const int cantidadProducciones = TAMANIOS[t];
+        const int cantidadNoTerminales = cantidadProducciones / 4;
+        ContextoBenchmark contexto;
+        if (!prepararContextoBenchmark(&contexto, cantidadProducciones, cantidadNoTerminales)) {
+            printerr("No se pudo preparar la gramatica sintetica de %d producciones.\n", cantidadProducciones);
+            destruirContextoBenchmark(&contexto);
+            return false;
+        }
+        for (size_t e = 0; e < sizeof(ETAPAS) / sizeof(ETAPAS[0]); e++) {
+            const size_t repeticiones = ETAPAS[e].porProduccion ? TRABAJO_BENCHMARK / (size_t)cantidadProducciones
+                                                                : PALABRAS_BENCHMARK / ETAPAS[e].palabrasPorOperacion;
+            ResultadoBenchmark resultado = {.etapa = ETAPAS[e].etapa,
+                                            .cantidadProducciones = cantidadProducciones,
+                                            .cantidadNoTerminales = cantidadNoTerminales,
+                                            .palabrasPorOperacion = ETAPAS[e].palabrasPorOperacion};
+            if (!medirEtapa(&contexto, ETAPAS[e].operacion, repeticiones, &resultado)) {
+                printerr("Fallo la etapa %s con %d producciones.\n", ETAPAS[e].etapa, cantidadProducciones);
+                destruirContextoBenchmark(&contexto);
+                return false;
+            }
+            mostrarResultadoBenchmark(&resultado, formato, esPrimero, salida);
+            esPrimero = false;
+        }
+        destruirContextoBenchmark(&contexto);
+    }
+    if (formato == FORMATO_JSON) {
+        fprintf(salida, "\n]\n");
+    }
+    fflush(salida);
+    return true;
+}
@@ -0,0 +1,13 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "gramatica.h"
+
+typedef enum {
+    FORMATO_CSV,
+    FORMATO_JSON
+} FormatoBenchmark;
+
+bool ejecutarBenchmark(FormatoBenchmark formato, FILE* salida);
+
+#endif
@@ -0,0 +1,412 @@
+#include "busqueda.h"
+
+/*
+        Busca en un archivo (mapeado en memoria) las subcadenas no vacías que
+        pertenecen a L(G), como "grep -o": de izquierda a derecha se toma la
+        coincidencia que empieza más a la izquierda y, entre las que empiezan
+        ahí, la más larga; la búsqueda sigue donde termina.
+        El recorrido se hace con el AFD no anclado de Σ*·L, que se obtiene
+        determinizando un AFN con los estados del AFD mínimo de L más un estado
+        inicial que lee cualquier byte y lanza en cada posición una copia del
+        estado inicial de L. Sus estados son los conjuntos de estados de L que
+        siguen vivos; no se minimiza para que el estado inicial siga indicando
+        exactamente que no hay ninguna coincidencia en curso. Cuando acepta, se
+        sabe dónde termina la primera coincidencia pero no dónde empieza: desde
+        la última vez que estuvo en el estado inicial se simulan en paralelo las
+        copias del AFD mínimo, guardando para cada estado el menor inicio que lo
+        alcanza, hasta que no quede ninguna que pueda dar una coincidencia más
+        a la izquierda o más larga.
+        El archivo se divide en fragmentos que se recorren en paralelo; cada uno
+        informa las coincidencias que empiezan en él (pueden terminar en los
+        siguientes). Si la última coincidencia de un fragmento termina dentro
+        del siguiente, este se vuelve a recorrer desde ese punto hasta reencontrar
+        una coincidencia que ya tenía: a partir de ahí sus resultados coinciden.
+        Si todas las palabras empiezan con el mismo byte, mientras no haya
+        ninguna coincidencia en curso se salta hasta su próxima aparición con
+        memchr.
+ */
+
+// Fragmentos más chicos no compensan el costo de crear un hilo (las pruebas lo achican para cruzar más bordes).
+#ifndef TAMANIO_MINIMO_FRAGMENTO
+#define TAMANIO_MINIMO_FRAGMENTO (1 << 20)
+#endif
+
+#define SIN_INICIO SIZE_MAX
+
+typedef struct {
+    size_t inicio;
+    size_t fin;                 // La coincidencia ocupa [inicio, fin).
+} Coincidencia;
+
+typedef struct {
+    Coincidencia *elementos;
+    size_t cantidad;
+    size_t capacidad;
+} ListaCoincidencias;
+
+// Espacio de trabajo de la simulación del AFD mínimo: menor inicio que alcanza cada estado (o SIN_INICIO) y estados alcanzados.
+typedef struct {
+    size_t *inicios[2];
+    int32_t *activos[2];
+} EspacioBusqueda;
+
+// AFN de Σ*·L: los estados del AFD mínimo (salvo el sumidero) más uno inicial que vuelve a sí mismo con cada símbolo.
+static bool construirAFNNoAnclado(const Automata *automata, AFN *afn) {
+    const int columnas = automata->cantidadColumnas;
+    const int estadoLanzador = automata->cantidadEstados;
+    afn->cantidadEstados = automata->cantidadEstados + 1;
+    afn->palabrasPorConjunto = palabrasConjunto(afn->cantidadEstados);
+    afn->inicioAristas = tcalloc(afn->cantidadEstados + 1, sizeof(int), MEMORIA_AUTOMATA);
+    afn->aristas = tmalloc(((size_t)afn->cantidadEstados * columnas + columnas) * sizeof(AristaAFN), MEMORIA_AUTOMATA);
+    afn->iniciales = tcalloc(afn->palabrasPorConjunto, sizeof(uint64_t), MEMORIA_AUTOMATA);
+    afn->finales = tcalloc(afn->palabrasPorConjunto, sizeof(uint64_t), MEMORIA_AUTOMATA);
+    if (afn->inicioAristas == NULL || afn->aristas == NULL || afn->iniciales == NULL || afn->finales == NULL) {
+        destruirAFN(afn);
+        return false;
+    }
+    agregarElemento(afn->iniciales, estadoLanzador);
+    int cantidadAristas = 0;
+    for (int q = 0; q < afn->cantidadEstados; q++) {
+        afn->inicioAristas[q] = cantidadAristas;
+        if (q == ESTADO_SUMIDERO) {
+            continue;
+        }
+        if (q < estadoLanzador && automata->esFinal[q]) {
+            agregarElemento(afn->finales, q);
+        }
+        // El estado lanzador hace lo mismo que el inicial de L (sin ser final: no hay coincidencias vacías) y además se queda.
+        const int origen = q == estadoLanzador ? automata->estadoInicial : q;
+        for (int columna = 0; columna < columnas - 1; columna++) {
+            if (q == estadoLanzador) {
+                afn->aristas[cantidadAristas++] = (AristaAFN){columna, estadoLanzador};
+            }
+            const int destino = automata->transiciones[(size_t)origen * columnas + columna];
+            if (destino != ESTADO_SUMIDERO) {
+                afn->aristas[cantidadAristas++] = (AristaAFN){columna, destino};
+            }
+        }
+    }
+    afn->inicioAristas[afn->cantidadEstados] = cantidadAristas;
+    return true;
+}
+
+Buscador *crearBuscador(const Automata *automata) {
+    Buscador *buscador = tcalloc(1, sizeof(Buscador), MEMORIA_BUSQUEDA);
+    Automata *noAnclado = tcalloc(1, sizeof(Automata), MEMORIA_AUTOMATA);
+    AFN afn;
+    memset(&afn, 0, sizeof(AFN));
+    if (buscador == NULL || noAnclado == NULL || (noAnclado->simbolos = tmalloc(automata->cantidadColumnas, MEMORIA_AUTOMATA)) == NULL ||
+        !construirAFNNoAnclado(automata, &afn)) {
+        memprinterr();
+        tfree(buscador);
+        destruirAutomata(noAnclado);
+        return NULL;
+    }
+    noAnclado->cantidadColumnas = automata->cantidadColumnas;
+    memcpy(noAnclado->clase, automata->clase, sizeof(automata->clase));
+    memcpy(noAnclado->simbolos, automata->simbolos, automata->cantidadColumnas);
+    noAnclado->estadosAFN = afn.cantidadEstados;
+    const bool exito = determinizar(&afn, noAnclado);
+    destruirAFN(&afn);
+    if (!exito) {
+        tfree(buscador);
+        destruirAutomata(noAnclado);
+        return NULL;
+    }
+    // Los bytes fuera del alfabeto cortan cualquier coincidencia en curso: vuelven al estado inicial (no al sumidero, que es inalcanzable).
+    const int columnas = noAnclado->cantidadColumnas;
+    for (int estado = 0; estado < noAnclado->cantidadEstados; estado++) {
+        noAnclado->transiciones[(size_t)estado * columnas + columnas - 1] = noAnclado->estadoInicial;
+    }
+    buscador->anclado = automata;
+    buscador->noAnclado = noAnclado;
+    buscador->primerByte = -1;
+    int columnasIniciales = 0;
+    for (int columna = 0; columna < columnas - 1; columna++) {
+        if (automata->transiciones[(size_t)automata->estadoInicial * columnas + columna] != ESTADO_SUMIDERO) {
+            buscador->primerByte = (unsigned char)automata->simbolos[columna];
+            columnasIniciales++;
+        }
+    }
+    if (columnasIniciales != 1) {
+        buscador->primerByte = -1;
+    }
+    return buscador;
+}
+
+void destruirBuscador(Buscador *buscador) {
+    if (buscador != NULL) {
+        destruirAutomata(buscador->noAnclado);
+        tfree(buscador);
+    }
+}
+
+static bool inicializarEspacioBusqueda(EspacioBusqueda *espacio, const int cantidadEstados) {
+    for (int i = 0; i < 2; i++) {
+        espacio->inicios[i] = tmalloc(cantidadEstados * sizeof(size_t), MEMORIA_BUSQUEDA);
+        espacio->activos[i] = tmalloc(cantidadEstados * sizeof(int32_t), MEMORIA_BUSQUEDA);
+        if (espacio->inicios[i] == NULL || espacio->activos[i] == NULL) {
+            return false;
+        }
+        for (int q = 0; q < cantidadEstados; q++) {
+            espacio->inicios[i][q] = SIN_INICIO;
+        }
+    }
+    return true;
+}
+
+static void liberarEspacioBusqueda(EspacioBusqueda *espacio) {
+    for (int i = 0; i < 2; i++) {
+        tfree(espacio->inicios[i]);
+        tfree(espacio->activos[i]);
+    }
+}
+
+static bool agregarCoincidencia(ListaCoincidencias *lista, const Coincidencia coincidencia) {
+    if (lista->cantidad == lista->capacidad) {
+        const size_t nuevaCapacidad = lista->capacidad > 0 ? lista->capacidad * 2 : 64;
+        Coincidencia *nuevos = trealloc(lista->elementos, nuevaCapacidad * sizeof(Coincidencia), MEMORIA_BUSQUEDA);
+        if (nuevos == NULL) {
+            return false;
+        }
+        lista->elementos = nuevos;
+        lista->capacidad = nuevaCapacidad;
+    }
+    lista->elementos[lista->cantidad++] = coincidencia;
+    return true;
+}
+
+// Simula desde "desde" todas las copias del AFD mínimo que empiezan antes de "limiteInicio" y devuelve la coincidencia más a la
+// izquierda y más larga. Puede leer más allá de "limiteInicio" (hasta el final del texto). Devuelve false si no hay ninguna.
+static bool buscarCoincidenciaDesde(const Automata *automata, const unsigned char *texto, const size_t tamanio, const size_t desde,
+                                    const size_t limiteInicio, EspacioBusqueda *espacio, Coincidencia *coincidencia) {
+    const int columnas = automata->cantidadColumnas;
+    size_t *inicios = espacio->inicios[0], *nuevosInicios = espacio->inicios[1];
+    int32_t *activos = espacio->activos[0], *nuevosActivos = espacio->activos[1];
+    int cantidadActivos = 0;
+    bool encontrada = false;
+    for (size_t posicion = desde; posicion < tamanio; posicion++) {
+        // Una vez encontrada una coincidencia, las que empiezan después ya no pueden ganarle.
+        if (!encontrada && posicion < limiteInicio && inicios[automata->estadoInicial] == SIN_INICIO) {
+            inicios[automata->estadoInicial] = posicion;
+            activos[cantidadActivos++] = automata->estadoInicial;
+        }
+        if (cantidadActivos == 0) {
+            break;
+        }
+        const int columna = automata->clase[texto[posicion]];
+        int cantidadNuevos = 0;
+        for (int i = 0; i < cantidadActivos; i++) {
+            const int32_t estado = activos[i];
+            const size_t inicio = inicios[estado];
+            inicios[estado] = SIN_INICIO;
+            if (encontrada && inicio > coincidencia->inicio) {
+                continue;
+            }
+            const int32_t destino = automata->transiciones[(size_t)estado * columnas + columna];
+            if (destino == ESTADO_SUMIDERO) {
+                continue;
+            }
+            if (nuevosInicios[destino] == SIN_INICIO) {
+                nuevosActivos[cantidadNuevos++] = destino;
+                nuevosInicios[destino] = inicio;
+            } else if (inicio < nuevosInicios[destino]) {
+                nuevosInicios[destino] = inicio;
+            }
+        }
+        size_t *auxiliarInicios = inicios;
+        inicios = nuevosInicios;
+        nuevosInicios = auxiliarInicios;
+        int32_t *auxiliarActivos = activos;
+        activos = nuevosActivos;
+        nuevosActivos = auxiliarActivos;
+        cantidadActivos = cantidadNuevos;
+        for (int i = 0; i < cantidadActivos; i++) {
+            const int32_t estado = activos[i];
+            if (automata->esFinal[estado] && (!encontrada || inicios[estado] <= coincidencia->inicio)) {
+                coincidencia->inicio = inicios[estado];
+                coincidencia->fin = posicion + 1;
+                encontrada = true;
+            }
+        }
+    }
+    // Deja todos los inicios en SIN_INICIO para la próxima búsqueda.
+    for (int i = 0; i < cantidadActivos; i++) {
+        inicios[activos[i]] = SIN_INICIO;
+    }
+    return encontrada;
+}
+
+static size_t buscarInicioCoincidencia(const ListaCoincidencias *lista, const size_t inicio) {
+    size_t izquierda = 0, derecha = lista->cantidad;
+    while (izquierda < derecha) {
+        const size_t medio = izquierda + (derecha - izquierda) / 2;
+        if (lista->elementos[medio].inicio < inicio) {
+            izquierda = medio + 1;
+        } else {
+            derecha = medio;
+        }
+    }
+    return izquierda < lista->cantidad && lista->elementos[izquierda].inicio == inicio ? izquierda : SIN_INICIO;
+}
+
+// Agrega a "lista" las coincidencias que empiezan en [desde, fin). Si "anteriores" no es NULL (las coincidencias de una búsqueda en el
+// mismo fragmento desde un punto anterior), se detiene en la primera coincidencia que ya estaba y copia las que le siguen.
+static bool buscarEnFragmento(const Buscador *buscador, const unsigned char *texto, const size_t tamanio, size_t posicion, const size_t fin,
+                              const ListaCoincidencias *anteriores, EspacioBusqueda *espacio, ListaCoincidencias *lista) {
+    const Automata *noAnclado = buscador->noAnclado;
+    const int32_t *transiciones = noAnclado->transiciones;
+    const uint16_t *clase = noAnclado->clase;
+    const size_t columnas = noAnclado->cantidadColumnas;
+    const int32_t sinCoincidencias = noAnclado->estadoInicial;
+    int32_t estado = sinCoincidencias;
+    size_t ultimoSinCoincidencias = posicion;
+    while (posicion < fin) {
+        if (estado == sinCoincidencias) {
+            if (buscador->primerByte >= 0) {
+                const unsigned char *siguiente = memchr(texto + posicion, buscador->primerByte, fin - posicion);
+                if (siguiente == NULL) {
+                    return true;
+                }
+                posicion = (size_t)(siguiente - texto);
+            }
+            ultimoSinCoincidencias = posicion;
+        }
+        estado = transiciones[estado * columnas + clase[texto[posicion++]]];
+        if (!noAnclado->esFinal[estado]) {
+            continue;
+        }
+        // Termina una coincidencia: todas las que siguen en curso empezaron después de la última vez que no había ninguna.
+        Coincidencia coincidencia;
+        buscarCoincidenciaDesde(buscador->anclado, texto, tamanio, ultimoSinCoincidencias, fin, espacio, &coincidencia);
+        if (!agregarCoincidencia(lista, coincidencia)) {
+            return false;
+        }
+        if (anteriores != NULL) {
+            const size_t indice = buscarInicioCoincidencia(anteriores, coincidencia.inicio);
+            if (indice != SIN_INICIO) {
+                for (size_t i = indice + 1; i < anteriores->cantidad; i++) {
+                    if (!agregarCoincidencia(lista, anteriores->elementos[i])) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        }
+        posicion = coincidencia.fin;
+        estado = sinCoincidencias;
+    }
+    // Las coincidencias que siguen en curso al final del fragmento pueden terminar en el siguiente.
+    Coincidencia coincidencia;
+    if (estado != sinCoincidencias && buscarCoincidenciaDesde(buscador->anclado, texto, tamanio, ultimoSinCoincidencias, fin, espacio, &coincidencia)) {
+        return agregarCoincidencia(lista, coincidencia);
+    }
+    return true;
+}
+
+typedef struct {
+    const Buscador *buscador;
+    const ArchivoMapeado *archivo;
+    size_t inicio;
+    size_t fin;
+    ListaCoincidencias coincidencias;
+    bool exito;
+} TrabajoBusqueda;
+
+static RETORNO_HILO ejecutarTrabajoBusqueda(void *argumento) {
+    TrabajoBusqueda *trabajo = argumento;
+    EspacioBusqueda espacio;
+    memset(&espacio, 0, sizeof(EspacioBusqueda));
+    trabajo->exito = inicializarEspacioBusqueda(&espacio, trabajo->buscador->anclado->cantidadEstados) &&
+                     buscarEnFragmento(trabajo->buscador, trabajo->archivo->datos, trabajo->archivo->tamanio, trabajo->inicio, trabajo->fin,
+                                       NULL, &espacio, &trabajo->coincidencias);
+    liberarEspacioBusqueda(&espacio);
+    volcarContadoresMemoria();
+    return 0;
+}
+
+// Escribe cada coincidencia como "desplazamiento<TAB>subcadena" (el desplazamiento en bytes desde el principio del archivo).
+static bool escribirCoincidencias(const ListaCoincidencias *lista, const unsigned char *texto, FILE *salida) {
+    for (size_t i = 0; i < lista->cantidad; i++) {
+        const Coincidencia coincidencia = lista->elementos[i];
+        const size_t longitud = coincidencia.fin - coincidencia.inicio;
+        if (fprintf(salida, "%zu\t", coincidencia.inicio) < 0 || fwrite(texto + coincidencia.inicio, 1, longitud, salida) != longitud ||
+            fputc('\n', salida) == EOF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool buscarEnArchivo(const Buscador *buscador, const char *ruta, int cantidadHilos, FILE *salida) {
+    ArchivoMapeado archivo;
+    if (!mapearArchivo(ruta, &archivo)) {
+        printerr("No se pudo abrir el archivo (o esta vacio): %s\n", ruta);
+        return false;
+    }
+    const size_t maximoFragmentos = archivo.tamanio / TAMANIO_MINIMO_FRAGMENTO + 1;
+    if (cantidadHilos < 1) {
+        cantidadHilos = 1;
+    }
+    if (cantidadHilos > MAX_HILOS) {
+        cantidadHilos = MAX_HILOS;
+    }
+    const int cantidadFragmentos = (size_t)cantidadHilos < maximoFragmentos ? cantidadHilos : (int)maximoFragmentos;
+    TrabajoBusqueda *trabajos = tcalloc(cantidadFragmentos, sizeof(TrabajoBusqueda), MEMORIA_BUSQUEDA);
+    Hilo *hilos = tmalloc(cantidadFragmentos * sizeof(Hilo), MEMORIA_BUSQUEDA);
+    EspacioBusqueda espacio;
+    memset(&espacio, 0, sizeof(EspacioBusqueda));
+    if (trabajos == NULL || hilos == NULL || !inicializarEspacioBusqueda(&espacio, buscador->anclado->cantidadEstados)) {
+        memprinterr();
+        tfree(trabajos);
+        tfree(hilos);
+        liberarEspacioBusqueda(&espacio);
+        desmapearArchivo(&archivo);
+        return false;
+    }
+    const double inicio = obtenerTiempoSegundos();
+    for (int i = 0; i < cantidadFragmentos; i++) {
+        trabajos[i].buscador = buscador;
+        trabajos[i].archivo = &archivo;
+        trabajos[i].inicio = archivo.tamanio / cantidadFragmentos * i;
+        trabajos[i].fin = i + 1 < cantidadFragmentos ? archivo.tamanio / cantidadFragmentos * (i + 1) : archivo.tamanio;
+    }
+    ejecutarEnParalelo(ejecutarTrabajoBusqueda, trabajos, sizeof(TrabajoBusqueda), cantidadFragmentos, hilos);
+    size_t cantidadCoincidencias = 0, finAnterior = 0;
+    bool exito = true;
+    for (int i = 0; exito && i < cantidadFragmentos; i++) {
+        TrabajoBusqueda *trabajo = &trabajos[i];
+        exito = trabajo->exito;
+        if (exito && finAnterior > trabajo->inicio) {
+            ListaCoincidencias corregidas = {NULL, 0, 0};
+            exito = buscarEnFragmento(buscador, archivo.datos, archivo.tamanio, finAnterior, trabajo->fin, &trabajo->coincidencias, &espacio, &corregidas);
+            tfree(trabajo->coincidencias.elementos);
+            trabajo->coincidencias = corregidas;
+        }
+        if (exito && trabajo->coincidencias.cantidad > 0) {
+            finAnterior = trabajo->coincidencias.elementos[trabajo->coincidencias.cantidad - 1].fin;
+            cantidadCoincidencias += trabajo->coincidencias.cantidad;
+            exito = escribirCoincidencias(&trabajo->coincidencias, archivo.datos, salida);
+        }
+    }
+    const double tiempo = obtenerTiempoSegundos() - inicio;
+    fflush(salida);
+    if (exito) {
+        fprintf(stderr, "Coincidencias: %zu en %zu bytes (%.3f s con %d fragmento(s), AFD no anclado de %d estados", cantidadCoincidencias,
+                archivo.tamanio, tiempo, cantidadFragmentos, buscador->noAnclado->cantidadEstados);
+        if (buscador->primerByte >= 0) {
+            fprintf(stderr, ", saltando hasta cada '%c'", buscador->primerByte);
+        }
+        fprintf(stderr, ")\n");
+    } else {
+        memprinterr();
+    }
+    for (int i = 0; i < cantidadFragmentos; i++) {
+        tfree(trabajos[i].coincidencias.elementos);
+    }
+    tfree(trabajos);
+    tfree(hilos);
+    liberarEspacioBusqueda(&espacio);
+    desmapearArchivo(&archivo);
+    return exito;
+}
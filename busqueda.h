@@ -0,0 +1,18 @@
+#ifndef BUSQUEDA_H
+#define BUSQUEDA_H
+
+#include "gramatica.h"
+
+typedef struct {
+    const Automata *anclado;    // AFD mínimo de L.
+    Automata *noAnclado;        // AFD de Σ*·L; su estado inicial es el de ninguna coincidencia en curso.
+    int primerByte;             // Byte con el que empiezan todas las palabras, o -1 si no hay uno solo.
+} Buscador;
+
+Buscador* crearBuscador(const Automata* automata);
+
+bool buscarEnArchivo(const Buscador* buscador, const char* ruta, int cantidadHilos, FILE* salida);
+
+void destruirBuscador(Buscador* buscador);
+
+#endif
@@ -0,0 +1,382 @@
+#include "cache.h"
+
+/*
+        Muchas gramáticas que se procesan son iguales salvo por el orden de
+        las producciones o de los símbolos. Después de parsear y validar la
+        gramática (así la caché no cambia qué gramáticas se aceptan) se arma
+        una forma canónica (símbolos ordenados, producciones ordenadas y el
+        axioma) y su hash de 64 bits indexa una caché LRU de gramáticas
+        compiladas con su autómata. Si la gramática ya está, no se compila ni
+        se construye el autómata. Como la compilación ordena las producciones
+        de cada fila de forma canónica (ver ordenarProduccionesCanonicas), la
+        gramática de la caché genera las mismas palabras con la misma semilla
+        que la ingresada, con o sin caché. Las producciones repetidas se
+        conservan, porque cambian la probabilidad de elegir cada alternativa.
+
+        Opcionalmente la caché se respalda en un directorio, con un archivo
+        "<hash>.grc" por gramática en el formato de --guardar, que se
+        comparte entre ejecuciones. En memoria se compara además la forma
+        canónica completa; en el directorio solo el hash.
+ */
+
+#define SIN_ENTRADA (-1)
+
+static bool agregarTextoForma(BufferPalabras *forma, const char *texto, const size_t longitud) {
+    if (!reservarBufferPalabras(forma, forma->longitud + longitud)) {
+        return false;
+    }
+    memcpy(forma->datos + forma->longitud, texto, longitud);
+    forma->longitud += longitud;
+    return true;
+}
+
+static bool agregarCaracterForma(BufferPalabras *forma, const char caracter) {
+    return agregarTextoForma(forma, &caracter, 1);
+}
+
+static int compararCadenas(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static int compararCaracteres(const void *a, const void *b) {
+    return *(const unsigned char *)a - *(const unsigned char *)b;
+}
+
+// Agrega los textos ordenados, separados por "separador" (si no es '\0') y seguidos de '\0'.
+static bool agregarTextosOrdenados(BufferPalabras *forma, const char **textos, const size_t cantidad, const char separador) {
+    qsort(textos, cantidad, sizeof(char *), compararCadenas);
+    for (size_t i = 0; i < cantidad; i++) {
+        if ((i > 0 && separador != '\0' && !agregarCaracterForma(forma, separador)) ||
+            !agregarTextoForma(forma, textos[i], strlen(textos[i]))) {
+            return false;
+        }
+    }
+    return agregarCaracterForma(forma, '\0');
+}
+
+// Escribe en "textos" cada producción como "L->R" (con ":peso" si lo tiene) seguida de '\0', y en "inicios" dónde empieza cada una.
+static bool describirProduccionesCanonicas(const Gramatica *gramatica, BufferPalabras *textos, size_t *inicios) {
+    for (int i = 0; i < gramatica->cantidadProducciones; i++) {
+        const Produccion *produccion = &gramatica->producciones[i];
+        TextoProduccion texto;
+        describirProduccionGramatica(gramatica, produccion, &texto);
+        inicios[i] = textos->longitud;
+        if (!agregarTextoForma(textos, texto.ladoIzquierdo, strlen(texto.ladoIzquierdo)) || !agregarTextoForma(textos, "->", 2)) {
+            return false;
+        }
+        for (int j = 0; j < LADO_DERECHO_MAX; j++) {
+            if (!agregarTextoForma(textos, texto.ladoDerecho[j], strlen(texto.ladoDerecho[j]))) {
+                return false;
+            }
+        }
+        // El peso se escribe en hexadecimal para que la forma lo represente exactamente.
+        char peso[64];
+        const int longitudPeso = produccion->peso != PESO_POR_DEFECTO ? snprintf(peso, sizeof(peso), "%c%a", SEPARADOR_PESO, produccion->peso) : 0;
+        if (!agregarTextoForma(textos, peso, longitudPeso) || !agregarCaracterForma(textos, '\0')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+        Arma en "forma" los campos canónicos de una gramática ya validada: los
+        nombres de los no terminales ordenados, los terminales ordenados, las
+        producciones ordenadas y separadas por comas, y el axioma, cada uno
+        terminado en '\0'.
+ */
+static bool canonicalizarGramatica(const Gramatica *gramatica, BufferPalabras *forma) {
+    const TablaNoTerminales *noTerminales = &gramatica->noTerminales;
+    const int cantidadNombres = noTerminales->cantidadDeclarados;
+    const int cantidadProducciones = gramatica->cantidadProducciones;
+    const size_t cantidadTextos = (size_t)(cantidadNombres > cantidadProducciones ? cantidadNombres : cantidadProducciones) + 1;
+    const char **textos = tmalloc(cantidadTextos * sizeof(char *), MEMORIA_CACHE);
+    size_t *inicios = tmalloc(((size_t)cantidadProducciones + 1) * sizeof(size_t), MEMORIA_CACHE);
+    BufferPalabras producciones;
+    inicializarBufferPalabras(&producciones, MEMORIA_CACHE);
+    bool exito = textos != NULL && inicios != NULL;
+    forma->longitud = 0;
+    if (exito) {
+        for (int i = 0; i < cantidadNombres; i++) {
+            textos[i] = noTerminales->nombres.datos + noTerminales->inicioNombre[i];
+        }
+        exito = agregarTextosOrdenados(forma, textos, cantidadNombres, '\0');
+    }
+    if (exito) {
+        const size_t inicioTerminales = forma->longitud;
+        exito = agregarTextoForma(forma, gramatica->simbolosTerminales, strlen(gramatica->simbolosTerminales));
+        if (exito) {
+            qsort(forma->datos + inicioTerminales, forma->longitud - inicioTerminales, 1, compararCaracteres);
+            exito = agregarCaracterForma(forma, '\0');
+        }
+    }
+    if (exito) {
+        exito = describirProduccionesCanonicas(gramatica, &producciones, inicios);
+    }
+    if (exito) {
+        for (int i = 0; i < cantidadProducciones; i++) {
+            textos[i] = producciones.datos + inicios[i];
+        }
+        exito = agregarTextosOrdenados(forma, textos, cantidadProducciones, ',');
+    }
+    if (exito) {
+        const char *axioma = noTerminales->nombres.datos + noTerminales->inicioNombre[indiceNoTerminal(gramatica->axioma)];
+        exito = agregarTextoForma(forma, axioma, strlen(axioma)) && agregarCaracterForma(forma, '\0');
+    }
+    tfree(textos);
+    tfree(inicios);
+    liberarBufferPalabras(&producciones);
+    return exito;
+}
+
+static uint64_t hashFormaCanonica(const char *forma, const size_t longitud) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < longitud; i++) {
+        hash = (hash ^ (unsigned char)forma[i]) * 0x100000001B3ULL;
+    }
+    return hash ^ hash >> 31;
+}
+
+static size_t posicionInicialCache(const CacheGramaticas *cache, const uint64_t hash) {
+    return (size_t)(hash ^ hash >> 32) & (cache->capacidadTabla - 1);
+}
+
+CacheGramaticas *crearCacheGramaticas(const int capacidad, const char *directorio) {
+    CacheGramaticas *cache = tcalloc(1, sizeof(CacheGramaticas), MEMORIA_CACHE);
+    if (cache == NULL) {
+        memprinterr();
+        return NULL;
+    }
+    cache->capacidad = capacidad;
+    cache->capacidadTabla = 2;
+    while (cache->capacidadTabla < 2 * (size_t)capacidad) {
+        cache->capacidadTabla <<= 1;
+    }
+    cache->entradas = tmalloc(capacidad * sizeof(EntradaCache), MEMORIA_CACHE);
+    cache->tabla = tcalloc(cache->capacidadTabla, sizeof(int32_t), MEMORIA_CACHE);
+    if (cache->entradas == NULL || cache->tabla == NULL) {
+        memprinterr();
+        destruirCacheGramaticas(cache);
+        return NULL;
+    }
+    cache->masReciente = SIN_ENTRADA;
+    cache->menosReciente = SIN_ENTRADA;
+    cache->directorio = directorio;
+    return cache;
+}
+
+static void destruirEntradaCache(EntradaCache *entrada) {
+    tfree(entrada->formaCanonica);
+    if (entrada->cargada != NULL) {
+        cerrarGramaticaCargada(entrada->cargada);
+        tfree(entrada->cargada);
+    } else {
+        destruirAutomata(entrada->automata);
+        destruirGramaticaCompilada(entrada->compilada);
+    }
+}
+
+void destruirCacheGramaticas(CacheGramaticas *cache) {
+    if (cache != NULL) {
+        for (int i = 0; i < cache->cantidadEntradas; i++) {
+            destruirEntradaCache(&cache->entradas[i]);
+        }
+        tfree(cache->entradas);
+        tfree(cache->tabla);
+        tfree(cache);
+    }
+}
+
+static void desenlazarEntrada(CacheGramaticas *cache, const int indice) {
+    EntradaCache *entrada = &cache->entradas[indice];
+    if (entrada->anterior != SIN_ENTRADA) {
+        cache->entradas[entrada->anterior].siguiente = entrada->siguiente;
+    } else {
+        cache->masReciente = entrada->siguiente;
+    }
+    if (entrada->siguiente != SIN_ENTRADA) {
+        cache->entradas[entrada->siguiente].anterior = entrada->anterior;
+    } else {
+        cache->menosReciente = entrada->anterior;
+    }
+}
+
+static void enlazarAlPrincipio(CacheGramaticas *cache, const int indice) {
+    EntradaCache *entrada = &cache->entradas[indice];
+    entrada->anterior = SIN_ENTRADA;
+    entrada->siguiente = cache->masReciente;
+    if (cache->masReciente != SIN_ENTRADA) {
+        cache->entradas[cache->masReciente].anterior = indice;
+    } else {
+        cache->menosReciente = indice;
+    }
+    cache->masReciente = indice;
+}
+
+static int buscarEntradaCache(const CacheGramaticas *cache, const uint64_t hash, const char *forma, const size_t longitud) {
+    const size_t mascara = cache->capacidadTabla - 1;
+    for (size_t i = posicionInicialCache(cache, hash); cache->tabla[i] != 0; i = (i + 1) & mascara) {
+        const EntradaCache *entrada = &cache->entradas[cache->tabla[i] - 1];
+        if (entrada->hash == hash && entrada->longitudForma == longitud && memcmp(entrada->formaCanonica, forma, longitud) == 0) {
+            return cache->tabla[i] - 1;
+        }
+    }
+    return SIN_ENTRADA;
+}
+
+// Quita la entrada de la tabla corriendo hacia atrás las que quedaron después de ella en la misma secuencia de sondeo.
+static void quitarDeTablaCache(CacheGramaticas *cache, const int indice) {
+    const size_t mascara = cache->capacidadTabla - 1;
+    size_t libre = posicionInicialCache(cache, cache->entradas[indice].hash);
+    while (cache->tabla[libre] != indice + 1) {
+        libre = (libre + 1) & mascara;
+    }
+    for (size_t i = (libre + 1) & mascara; cache->tabla[i] != 0; i = (i + 1) & mascara) {
+        const size_t inicial = posicionInicialCache(cache, cache->entradas[cache->tabla[i] - 1].hash);
+        // La entrada de "i" puede ocupar "libre" si su posición inicial no está en el tramo circular (libre, i].
+        if (((i - inicial) & mascara) >= ((i - libre) & mascara)) {
+            cache->tabla[libre] = cache->tabla[i];
+            libre = i;
+        }
+    }
+    cache->tabla[libre] = 0;
+}
+
+static void agregarATablaCache(CacheGramaticas *cache, const int indice) {
+    const size_t mascara = cache->capacidadTabla - 1;
+    size_t i = posicionInicialCache(cache, cache->entradas[indice].hash);
+    while (cache->tabla[i] != 0) {
+        i = (i + 1) & mascara;
+    }
+    cache->tabla[i] = indice + 1;
+}
+
+static void rutaEntradaCache(const CacheGramaticas *cache, const uint64_t hash, char *ruta, const size_t tamanio) {
+    snprintf(ruta, tamanio, "%s/%016llx.grc", cache->directorio, (unsigned long long)hash);
+}
+
+// Busca la gramática en el directorio de la caché. Un archivo inexistente no es un error; uno inválido se informa y se reemplaza.
+static bool cargarEntradaDirectorio(const char *ruta, EntradaCache *entrada) {
+    GramaticaCargada *cargada = tcalloc(1, sizeof(GramaticaCargada), MEMORIA_CACHE);
+    if (cargada == NULL) {
+        return false;
+    }
+    if (!mapearArchivo(ruta, &cargada->archivo)) {
+        tfree(cargada);
+        return false;
+    }
+    const char *error = leerGramaticaMapeada(cargada);
+    if (error != NULL) {
+        fprintf(stderr, "Aviso: se ignora el archivo %s de la cache porque %s.\n", ruta, error);
+        desmapearArchivo(&cargada->archivo);
+        tfree(cargada);
+        return false;
+    }
+    entrada->cargada = cargada;
+    entrada->compilada = &cargada->compilada;
+    entrada->automata = &cargada->automata;
+    return true;
+}
+
+// Parsea y valida la gramática. Devuelve NULL si tiene errores.
+static Gramatica *parsearDescripcion(const DescripcionGramatica *descripcion) {
+    Gramatica *gramatica = crearGramaticaDesdeCadenas(descripcion->simbolosNoTerminales, descripcion->simbolosTerminales,
+                                                      descripcion->producciones, descripcion->axioma);
+    if (gramatica != NULL && !esGramaticaRegular(gramatica)) {
+        printerr("La gramatica ingresada no es regular\n");
+        destruirGramatica(gramatica);
+        return NULL;
+    }
+    return gramatica;
+}
+
+// Compila la gramática y construye su autómata.
+static bool compilarConAutomata(const Gramatica *gramatica, GramaticaCompilada **compilada, Automata **automata) {
+    *compilada = compilarGramatica(gramatica);
+    if (*compilada == NULL) {
+        return false;
+    }
+    *automata = construirAutomata(*compilada);
+    if (*automata == NULL) {
+        destruirGramaticaCompilada(*compilada);
+        return false;
+    }
+    return true;
+}
+
+// Parsea, valida y compila la gramática y construye su autómata.
+bool compilarDescripcion(const DescripcionGramatica *descripcion, GramaticaCompilada **compilada, Automata **automata) {
+    Gramatica *gramatica = parsearDescripcion(descripcion);
+    const bool exito = gramatica != NULL && compilarConAutomata(gramatica, compilada, automata);
+    destruirGramatica(gramatica);
+    return exito;
+}
+
+/*
+        Devuelve la gramática compilada (con su autómata) que corresponde a la
+        descripción, compilándola solo si no está en la caché. La entrada
+        devuelve vale hasta la próxima llamada. Devuelve NULL si la gramática
+        tiene errores o no hay memoria.
+ */
+const EntradaCache *obtenerGramaticaCompilada(CacheGramaticas *cache, const DescripcionGramatica *descripcion) {
+    Gramatica *gramatica = parsearDescripcion(descripcion);
+    if (gramatica == NULL) {
+        return NULL;
+    }
+    BufferPalabras forma;
+    inicializarBufferPalabras(&forma, MEMORIA_CACHE);
+    if (!canonicalizarGramatica(gramatica, &forma)) {
+        memprinterr();
+        liberarBufferPalabras(&forma);
+        destruirGramatica(gramatica);
+        return NULL;
+    }
+    const uint64_t hash = hashFormaCanonica(forma.datos, forma.longitud);
+    int indice = buscarEntradaCache(cache, hash, forma.datos, forma.longitud);
+    if (indice != SIN_ENTRADA) {
+        cache->aciertos++;
+        liberarBufferPalabras(&forma);
+        destruirGramatica(gramatica);
+        desenlazarEntrada(cache, indice);
+        enlazarAlPrincipio(cache, indice);
+        return &cache->entradas[indice];
+    }
+
+    EntradaCache nueva = {hash, forma.datos, forma.longitud, NULL, NULL, NULL, SIN_ENTRADA, SIN_ENTRADA};
+    char ruta[4096];
+    if (cache->directorio != NULL) {
+        rutaEntradaCache(cache, hash, ruta, sizeof(ruta));
+    }
+    if (cache->directorio != NULL && cargarEntradaDirectorio(ruta, &nueva)) {
+        cache->aciertosDirectorio++;
+    } else if (compilarConAutomata(gramatica, &nueva.compilada, &nueva.automata)) {
+        cache->fallos++;
+        if (cache->directorio != NULL) {
+            guardarGramaticaCompilada(ruta, nueva.compilada, nueva.automata);
+        }
+    } else {
+        liberarBufferPalabras(&forma);
+        destruirGramatica(gramatica);
+        return NULL;
+    }
+    destruirGramatica(gramatica);
+
+    // Si la caché está llena se reemplaza la entrada usada hace más tiempo.
+    if (cache->cantidadEntradas < cache->capacidad) {
+        indice = cache->cantidadEntradas++;
+    } else {
+        indice = cache->menosReciente;
+        quitarDeTablaCache(cache, indice);
+        desenlazarEntrada(cache, indice);
+        destruirEntradaCache(&cache->entradas[indice]);
+    }
+    cache->entradas[indice] = nueva;
+    agregarATablaCache(cache, indice);
+    enlazarAlPrincipio(cache, indice);
+    return &cache->entradas[indice];
+}
+
+void mostrarEstadisticasCache(const CacheGramaticas *cache, FILE *salida) {
+    fprintf(salida, "Cache de gramaticas: %zu aciertos, %zu leidas del directorio, %zu compiladas\n",
+            cache->aciertos, cache->aciertosDirectorio, cache->fallos);
+}
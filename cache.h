@@ -0,0 +1,44 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "gramatica.h"
+#include "serializacion.h"
+
+#define CAPACIDAD_CACHE_POR_DEFECTO 64
+
+typedef struct {
+    uint64_t hash;
+    char *formaCanonica;        // Campos separados por '\0' (ver canonicalizarGramatica).
+    size_t longitudForma;
+    GramaticaCompilada *compilada;
+    Automata *automata;
+    GramaticaCargada *cargada;  // Si la entrada se leyó del directorio, "compilada" y "automata" apuntan a ella.
+    int anterior;               // Lista de entradas ordenada por uso, de la más reciente a la menos reciente.
+    int siguiente;
+} EntradaCache;
+
+typedef struct {
+    EntradaCache *entradas;
+    int cantidadEntradas;
+    int capacidad;
+    int masReciente;
+    int menosReciente;
+    int32_t *tabla;             // Índice de la entrada + 1 por hash (0 significa posición libre).
+    size_t capacidadTabla;      // Potencia de 2, al menos el doble de "capacidad".
+    const char *directorio;     // NULL si la caché es solo en memoria.
+    size_t aciertos;
+    size_t aciertosDirectorio;
+    size_t fallos;
+} CacheGramaticas;
+
+CacheGramaticas* crearCacheGramaticas(int capacidad, const char* directorio);
+
+const EntradaCache* obtenerGramaticaCompilada(CacheGramaticas* cache, const DescripcionGramatica* descripcion);
+
+void mostrarEstadisticasCache(const CacheGramaticas* cache, FILE* salida);
+
+void destruirCacheGramaticas(CacheGramaticas* cache);
+
+bool compilarDescripcion(const DescripcionGramatica* descripcion, GramaticaCompilada** compilada, Automata** automata);
+
+#endif
@@ -0,0 +1,305 @@
+#include "codigo.h"
+
+/*
+        Escribe un programa en C independiente, especializado en una gramática,
+        con un generador y un reconocedor sin tablas. El generador tiene un
+        bloque por no terminal: la cantidad de producciones de cada fila queda
+        como constante (el sorteo de una fila con una sola producción es solo
+        avanzar el generador, y con una potencia de 2 un desplazamiento), las
+        probabilidades de la tabla de alias quedan como literales y cada
+        producción salta con goto al bloque del no terminal que sigue. Usa el
+        mismo generador aleatorio, el mismo sorteo y la misma siembra por
+        bloques que generarPalabrasEnSalida, así que "-n cantidad -s semilla"
+        escribe exactamente las mismas palabras que este programa. El
+        reconocedor tiene un bloque por estado del AFD mínimo (el sumidero no
+        tiene bloque: los símbolos que llevan a él rechazan la cadena).
+ */
+
+static const char *const CODIGO_PROLOGO =
+    "#include <stdint.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "#include <time.h>\n"
+    "\n"
+    "// xoshiro256** sembrado con splitmix64: la misma secuencia que el generador original.\n"
+    "typedef struct {\n"
+    "    uint64_t estado[4];\n"
+    "} GeneradorAleatorio;\n"
+    "\n"
+    "static uint64_t splitmix64(uint64_t *semilla) {\n"
+    "    uint64_t z = (*semilla += 0x9E3779B97F4A7C15ULL);\n"
+    "    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;\n"
+    "    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;\n"
+    "    return z ^ (z >> 31);\n"
+    "}\n"
+    "\n"
+    "static inline uint64_t rotarIzquierda(const uint64_t valor, const int bits) {\n"
+    "    return (valor << bits) | (valor >> (64 - bits));\n"
+    "}\n"
+    "\n"
+    "static void sembrarGenerador(GeneradorAleatorio *generador, uint64_t semilla) {\n"
+    "    for (int i = 0; i < 4; i++) {\n"
+    "        generador->estado[i] = splitmix64(&semilla);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "static inline uint64_t siguienteAleatorio(GeneradorAleatorio *generador) {\n"
+    "    uint64_t *s = generador->estado;\n"
+    "    const uint64_t resultado = rotarIzquierda(s[1] * 5, 7) * 9;\n"
+    "    const uint64_t t = s[1] << 17;\n"
+    "    s[2] ^= s[0];\n"
+    "    s[3] ^= s[1];\n"
+    "    s[1] ^= s[2];\n"
+    "    s[0] ^= s[3];\n"
+    "    s[2] ^= t;\n"
+    "    s[3] = rotarIzquierda(s[3], 45);\n"
+    "    return resultado;\n"
+    "}\n"
+    "\n"
+    "// Método de Lemire con el umbral (-limite % limite) ya calculado.\n"
+    "static inline uint32_t aleatorioEnRango(GeneradorAleatorio *generador, const uint32_t limite, const uint32_t umbral) {\n"
+    "    uint64_t producto = (uint64_t)(uint32_t)(siguienteAleatorio(generador) >> 32) * limite;\n"
+    "    while ((uint32_t)producto < umbral) {\n"
+    "        producto = (uint64_t)(uint32_t)(siguienteAleatorio(generador) >> 32) * limite;\n"
+    "    }\n"
+    "    return (uint32_t)(producto >> 32);\n"
+    "}\n"
+    "\n"
+    "static inline double aleatorioUnitario(GeneradorAleatorio *generador) {\n"
+    "    return (double)(siguienteAleatorio(generador) >> 11) * 0x1.0p-53;\n"
+    "}\n"
+    "\n"
+    "#define BLOQUE_PALABRAS 65536\n"
+    "\n"
+    "#define TAMANIO_SALIDA (1 << 16)\n"
+    "\n"
+    "static char salida[TAMANIO_SALIDA];\n"
+    "static size_t longitudSalida;\n"
+    "\n"
+    "static void vaciarSalida(void) {\n"
+    "    fwrite(salida, 1, longitudSalida, stdout);\n"
+    "    longitudSalida = 0;\n"
+    "}\n"
+    "\n"
+    "static inline void escribir(const char caracter) {\n"
+    "    if (longitudSalida == TAMANIO_SALIDA) {\n"
+    "        vaciarSalida();\n"
+    "    }\n"
+    "    salida[longitudSalida++] = caracter;\n"
+    "}\n"
+    "\n";
+
+static const char *const CODIGO_EPILOGO =
+    "// Lee cadenas de stdin (una por línea) e imprime 1 si pertenecen al lenguaje o 0 si no.\n"
+    "static int reconocerEntrada(void) {\n"
+    "    size_t capacidad = 1 << 20, longitud = 0;\n"
+    "    char *datos = malloc(capacidad);\n"
+    "    int finEntrada = 0;\n"
+    "    while (datos != NULL && !finEntrada) {\n"
+    "        if (capacidad - longitud < capacidad / 2) {\n"
+    "            char *nuevosDatos = realloc(datos, capacidad * 2);\n"
+    "            if (nuevosDatos == NULL) {\n"
+    "                break;\n"
+    "            }\n"
+    "            datos = nuevosDatos;\n"
+    "            capacidad *= 2;\n"
+    "        }\n"
+    "        const size_t leidos = fread(datos + longitud, 1, capacidad - longitud, stdin);\n"
+    "        longitud += leidos;\n"
+    "        finEntrada = leidos == 0;\n"
+    "        size_t inicioLinea = 0;\n"
+    "        while (inicioLinea < longitud) {\n"
+    "            const char *finLinea = memchr(datos + inicioLinea, '\\n', longitud - inicioLinea);\n"
+    "            if (finLinea == NULL && !finEntrada) {\n"
+    "                break;\n"
+    "            }\n"
+    "            const size_t fin = finLinea != NULL ? (size_t)(finLinea - datos) : longitud;\n"
+    "            size_t longitudLinea = fin - inicioLinea;\n"
+    "            if (longitudLinea > 0 && datos[inicioLinea + longitudLinea - 1] == '\\r') {\n"
+    "                longitudLinea--;\n"
+    "            }\n"
+    "            escribir(acepta((const unsigned char *)datos + inicioLinea, longitudLinea) ? '1' : '0');\n"
+    "            escribir('\\n');\n"
+    "            inicioLinea = finLinea != NULL ? fin + 1 : fin;\n"
+    "        }\n"
+    "        memmove(datos, datos + inicioLinea, longitud - inicioLinea);\n"
+    "        longitud -= inicioLinea;\n"
+    "    }\n"
+    "    vaciarSalida();\n"
+    "    const int exito = datos != NULL && finEntrada;\n"
+    "    free(datos);\n"
+    "    return exito && fflush(stdout) == 0 ? 0 : 1;\n"
+    "}\n"
+    "\n"
+    "int main(int argc, char *argv[]) {\n"
+    "    size_t cantidad = 0;\n"
+    "    uint64_t semilla = (uint64_t)time(NULL) ^ ((uint64_t)clock() << 32);\n"
+    "    int reconocer = 0;\n"
+    "    for (int i = 1; i < argc; i++) {\n"
+    "        if (strcmp(argv[i], \"-n\") == 0 && i + 1 < argc) {\n"
+    "            cantidad = (size_t)strtoull(argv[++i], NULL, 10);\n"
+    "        } else if (strcmp(argv[i], \"-s\") == 0 && i + 1 < argc) {\n"
+    "            semilla = strtoull(argv[++i], NULL, 10);\n"
+    "        } else if (strcmp(argv[i], \"--reconocer\") == 0) {\n"
+    "            reconocer = 1;\n"
+    "        } else {\n"
+    "            cantidad = 0;\n"
+    "            break;\n"
+    "        }\n"
+    "    }\n"
+    "    if (reconocer) {\n"
+    "        return reconocerEntrada();\n"
+    "    }\n"
+    "    if (cantidad == 0) {\n"
+    "        fprintf(stderr, \"Uso: %s -n cantidad [-s semilla] | --reconocer\\n\", argv[0]);\n"
+    "        return 1;\n"
+    "    }\n"
+    "    // Cada bloque de BLOQUE_PALABRAS palabras usa su propio generador, como en la generación en paralelo.\n"
+    "    GeneradorAleatorio generador = {{0}};\n"
+    "    for (size_t i = 0; i < cantidad; i++) {\n"
+    "        if (i % BLOQUE_PALABRAS == 0) {\n"
+    "            sembrarGenerador(&generador, semilla + i / BLOQUE_PALABRAS);\n"
+    "        }\n"
+    "        derivar(&generador);\n"
+    "        escribir('\\n');\n"
+    "    }\n"
+    "    vaciarSalida();\n"
+    "    return fflush(stdout) == 0 && !ferror(stdout) ? 0 : 1;\n"
+    "}\n";
+
+static void escribirCaracterC(const char caracter, FILE *salida) {
+    if ((caracter >= 'a' && caracter <= 'z') || (caracter >= '0' && caracter <= '9')) {
+        fprintf(salida, "'%c'", caracter);
+    } else {
+        fprintf(salida, "%d", (int)(unsigned char)caracter);
+    }
+}
+
+static void escribirProduccionC(const GramaticaCompilada *compilada, const int produccion, const char *sangria, FILE *salida) {
+    const Transicion transicion = compilada->transiciones[produccion];
+    if (transicion.terminal != EPSILON) {
+        fprintf(salida, "%sescribir(", sangria);
+        escribirCaracterC(transicion.terminal, salida);
+        fprintf(salida, ");\n");
+    }
+    if (transicion.siguiente == SIN_NO_TERMINAL) {
+        fprintf(salida, "%sreturn;\n", sangria);
+    } else {
+        fprintf(salida, "%sgoto fila_%d;\n", sangria, transicion.siguiente);
+    }
+}
+
+// Con tabla de alias, la producción sorteada se queda con su probabilidad y si no se cambia por su alias (como elegirProduccion).
+static void escribirEleccionC(const GramaticaCompilada *compilada, const int produccion, const char *sangria, FILE *salida) {
+    if (compilada->alias == NULL) {
+        escribirProduccionC(compilada, produccion, sangria, salida);
+        return;
+    }
+    const double probabilidad = compilada->probabilidadAlias[produccion];
+    if (probabilidad >= 1.0 || compilada->alias[produccion] == produccion) {
+        fprintf(salida, "%saleatorioUnitario(generador);\n", sangria);
+        escribirProduccionC(compilada, produccion, sangria, salida);
+        return;
+    }
+    char sangriaInterna[32];
+    snprintf(sangriaInterna, sizeof(sangriaInterna), "%s    ", sangria);
+    fprintf(salida, "%sif (aleatorioUnitario(generador) < %a) {\n", sangria, probabilidad);
+    escribirProduccionC(compilada, produccion, sangriaInterna, salida);
+    fprintf(salida, "%s}\n", sangria);
+    escribirProduccionC(compilada, compilada->alias[produccion], sangria, salida);
+}
+
+static void escribirGeneradorC(const GramaticaCompilada *compilada, FILE *salida) {
+    fprintf(salida, "\n// Un bloque por no terminal; cada producción salta directamente al bloque del no terminal que sigue.\n");
+    fprintf(salida, "static void derivar(GeneradorAleatorio *generador) {\n");
+    fprintf(salida, "    goto fila_%d;\n", compilada->axioma);
+    for (int fila = 0; fila < compilada->cantidadNoTerminales; fila++) {
+        const int inicio = compilada->inicioFila[fila];
+        const uint32_t cantidad = (uint32_t)(compilada->inicioFila[fila + 1] - inicio);
+        if (cantidad == 0) {
+            continue;
+        }
+        const char *nombre = nombreNoTerminal(compilada, fila);
+        fprintf(salida, "fila_%d: // %s\n", fila, *nombre != '\0' ? nombre : "(fila inicial)");
+        if (cantidad == 1) {
+            fprintf(salida, "    siguienteAleatorio(generador);\n");
+            escribirEleccionC(compilada, inicio, "    ", salida);
+            continue;
+        }
+        int bits = 0;
+        while (((uint32_t)1 << bits) < cantidad) {
+            bits++;
+        }
+        if (((uint32_t)1 << bits) == cantidad) {
+            fprintf(salida, "    switch (siguienteAleatorio(generador) >> %d) {\n", 64 - bits);
+        } else {
+            fprintf(salida, "    switch (aleatorioEnRango(generador, %" PRIu32 "u, %" PRIu32 "u)) {\n", cantidad, (uint32_t)(-cantidad % cantidad));
+        }
+        for (uint32_t i = 0; i < cantidad; i++) {
+            if (i + 1 < cantidad) {
+                fprintf(salida, "    case %" PRIu32 ":\n", i);
+            } else {
+                fprintf(salida, "    default:\n");
+            }
+            escribirEleccionC(compilada, inicio + (int)i, "        ", salida);
+        }
+        fprintf(salida, "    }\n");
+    }
+    fprintf(salida, "}\n");
+}
+
+static void escribirReconocedorC(const Automata *automata, FILE *salida) {
+    const int columnas = automata->cantidadColumnas;
+    fprintf(salida, "\n// Un bloque por estado del AFD mínimo; los símbolos que llevan al sumidero rechazan la cadena.\n");
+    fprintf(salida, "static int acepta(const unsigned char *palabra, const size_t longitud) {\n");
+    fprintf(salida, "    const unsigned char *fin = palabra + longitud;\n");
+    if (automata->estadoInicial == ESTADO_SUMIDERO) {
+        fprintf(salida, "    return 0;\n}\n");
+        return;
+    }
+    fprintf(salida, "    goto estado_%d;\n", automata->estadoInicial);
+    for (int estado = 0; estado < automata->cantidadEstados; estado++) {
+        if (estado == ESTADO_SUMIDERO) {
+            continue;
+        }
+        const int32_t *transiciones = &automata->transiciones[(size_t)estado * columnas];
+        fprintf(salida, "estado_%d:\n", estado);
+        fprintf(salida, "    if (palabra == fin) {\n        return %d;\n    }\n", automata->esFinal[estado] ? 1 : 0);
+        fprintf(salida, "    switch (*palabra++) {\n");
+        // Los símbolos que van al mismo estado comparten la rama.
+        for (int columna = 0; columna < columnas - 1; columna++) {
+            const int32_t destino = transiciones[columna];
+            bool yaEscrito = destino == ESTADO_SUMIDERO;
+            for (int anterior = 0; anterior < columna && !yaEscrito; anterior++) {
+                yaEscrito = transiciones[anterior] == destino;
+            }
+            if (yaEscrito) {
+                continue;
+            }
+            for (int otra = columna; otra < columnas - 1; otra++) {
+                if (transiciones[otra] == destino) {
+                    fprintf(salida, "    case ");
+                    escribirCaracterC(automata->simbolos[otra], salida);
+                    fprintf(salida, ":\n");
+                }
+            }
+            fprintf(salida, "        goto estado_%d;\n", destino);
+        }
+        fprintf(salida, "    default:\n        return 0;\n    }\n");
+    }
+    fprintf(salida, "}\n");
+}
+
+// Escribe el programa especializado en la gramática, cuyo lenguaje no puede ser vacío. "automata" es su AFD mínimo.
+bool escribirCodigoC(const GramaticaCompilada *compilada, const Automata *automata, FILE *salida) {
+    fprintf(salida, "// Programa generado a partir de una gramatica de %d no terminales y %d producciones utiles.\n",
+            compilada->cantidadNombres, compilada->cantidadProducciones);
+    fprintf(salida, "// \"-n cantidad -s semilla\" escribe las mismas palabras que el generador original con esos argumentos;\n");
+    fprintf(salida, "// \"--reconocer\" responde igual que su opcion --reconocer. Compilacion: gcc -O3 archivo.c -o programa\n\n");
+    fputs(CODIGO_PROLOGO, salida);
+    escribirGeneradorC(compilada, salida);
+    escribirReconocedorC(automata, salida);
+    fputs(CODIGO_EPILOGO, salida);
+    return fflush(salida) == 0 && !ferror(salida);
+}
@@ -0,0 +1,8 @@
+#ifndef CODIGO_H
+#define CODIGO_H
+
+#include "gramatica.h"
+
+bool escribirCodigoC(const GramaticaCompilada* compilada, const Automata* automata, FILE* salida);
+
+#endif
@@ -0,0 +1,555 @@
+#ifndef GRAMATICA_H
+#define GRAMATICA_H
+
+// Declaraciones compartidas por main.c y los módulos (búsqueda, código C, serialización, caché, servidor y benchmark).
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <float.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <pthread.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+void habilitarColoresConsola();
+
+double obtenerTiempoSegundos();
+
+int obtenerCantidadNucleos();
+
+// Hilos: las funciones de los hilos se declaran como "RETORNO_HILO funcion(void* argumento)" y devuelven 0.
+
+#ifdef _WIN32
+    #define RETORNO_HILO DWORD WINAPI
+    typedef HANDLE Hilo;
+    typedef LPTHREAD_START_ROUTINE FuncionHilo;
+#else
+    #define RETORNO_HILO void*
+    typedef pthread_t Hilo;
+    typedef void* (*FuncionHilo)(void*);
+#endif
+
+bool crearHilo(Hilo* hilo, FuncionHilo funcion, void* argumento);
+
+void esperarHilo(Hilo hilo);
+
+void ejecutarEnParalelo(FuncionHilo funcion, void* trabajos, size_t tamanio, int cantidad, Hilo* hilos);
+
+// Exclusión mutua y variables de condición (SRWLOCK/CONDITION_VARIABLE en Windows).
+
+#ifdef _WIN32
+    typedef SRWLOCK Mutex;
+    typedef CONDITION_VARIABLE Condicion;
+    #define MUTEX_INICIALIZADO SRWLOCK_INIT
+#else
+    typedef pthread_mutex_t Mutex;
+    typedef pthread_cond_t Condicion;
+    #define MUTEX_INICIALIZADO PTHREAD_MUTEX_INITIALIZER
+#endif
+
+void inicializarMutex(Mutex* mutex);
+
+void destruirMutex(Mutex* mutex);
+
+void bloquearMutex(Mutex* mutex);
+
+void desbloquearMutex(Mutex* mutex);
+
+void inicializarCondicion(Condicion* condicion);
+
+void destruirCondicion(Condicion* condicion);
+
+void esperarCondicion(Condicion* condicion, Mutex* mutex);
+
+void despertarUno(Condicion* condicion);
+
+void despertarTodos(Condicion* condicion);
+
+// Archivo de solo lectura mapeado en memoria: las páginas se leen del disco recién cuando se las usa.
+typedef struct {
+    const unsigned char *datos;
+    size_t tamanio;
+#ifdef _WIN32
+    HANDLE archivo;
+    HANDLE mapeo;
+#endif
+} ArchivoMapeado;
+
+bool mapearArchivo(const char* ruta, ArchivoMapeado* mapeado);
+
+void desmapearArchivo(ArchivoMapeado* mapeado);
+
+// --- Macros ---
+
+#define ANSI_COLOR_RED      "\x1b[31m"
+#define ANSI_COLOR_BLUE     "\x1b[34m"
+#define ANSI_COLOR_RESET    "\x1b[0m"
+
+#define printmsg(format,...) \
+    printf(ANSI_COLOR_BLUE format ANSI_COLOR_RESET, ##__VA_ARGS__)
+
+void reportarError(const char* formato, ...) __attribute__((format(printf, 1, 2)));
+
+#define printerr(format,...) \
+    reportarError(format, ##__VA_ARGS__)
+
+// Para mensajes internos.
+#define DESARROLLO true
+
+#define memprinterr() \
+    if(DESARROLLO) printerr("La funcion tmalloc() fallo cuando se ejecuto en: %s()\n",__func__)
+
+// Una gramática regular tiene como máximo 2 símbolos en su lado derecho.
+#define LADO_DERECHO_MAX 2
+
+#define PRODUCCION_MIN 4
+
+#define EPSILON '@'
+
+// Separa una producción de su peso opcional, por ejemplo "S->aS:0.9".
+#define SEPARADOR_PESO ':'
+
+#define PESO_POR_DEFECTO 1.0
+
+#define SIMBOLOS_NO_TERMINALES "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+#define SIMBOLOS_TERMINALES "abcdefghijklmnopqrstuvwxyz"
+
+// --- Utils ---
+
+// Mensajes de error
+
+#define LONGITUD_DIAGNOSTICOS 1024
+
+// Mensajes de printerr de un hilo guardados en lugar de escribirse en stderr (se trunca lo que no entra).
+typedef struct {
+    char texto[LONGITUD_DIAGNOSTICOS];
+    size_t longitud;
+} Diagnosticos;
+
+void capturarDiagnosticos(Diagnosticos* destino);
+
+typedef enum {
+    MEMORIA_PARSEO,
+    MEMORIA_VALIDACION,
+    MEMORIA_COMPILACION,
+    MEMORIA_DERIVACION,
+    MEMORIA_GENERACION,
+    MEMORIA_AUTOMATA,
+    MEMORIA_MUESTREO,
+    MEMORIA_ENUMERACION,
+    MEMORIA_CONTEO,
+    MEMORIA_EQUIVALENCIA,
+    MEMORIA_BUSQUEDA,
+    MEMORIA_SERIALIZACION,
+    MEMORIA_CACHE,
+    MEMORIA_SERVIDOR,
+    CANTIDAD_SUBSISTEMAS
+} SubsistemaMemoria;
+
+typedef struct {
+    atomic_size_t actual;
+    atomic_size_t pico;
+    atomic_size_t asignaciones;
+    atomic_size_t bytesAsignados;
+} ContadoresMemoria;
+
+// El último elemento acumula el total de todos los subsistemas.
+extern ContadoresMemoria heapUsado[CANTIDAD_SUBSISTEMAS + 1];
+
+void* tmalloc(size_t size, SubsistemaMemoria subsistema);
+
+void* tcalloc(size_t cantidad, size_t size, SubsistemaMemoria subsistema);
+
+void* trealloc(void* ptr, size_t size, SubsistemaMemoria subsistema);
+
+void tfree(void* ptr);
+
+void volcarContadoresMemoria();
+
+void reiniciarPicoMemoria();
+
+void reportarMemoria();
+
+#ifdef INSTRUMENTACION
+    #define INSTRUMENTAR(...) __VA_ARGS__
+#else
+    #define INSTRUMENTAR(...)
+#endif
+
+#ifdef INSTRUMENTACION
+void volcarInstrumentacion();
+#endif
+
+// Operaciones de buffers
+
+// Arena contigua de caracteres que crece a medida que se necesita y se reutiliza vaciándola.
+typedef struct {
+    char *datos;
+    size_t longitud;
+    size_t capacidad;
+    SubsistemaMemoria subsistema;
+} BufferPalabras;
+
+void inicializarBufferPalabras(BufferPalabras* buffer, SubsistemaMemoria subsistema);
+
+bool reservarBufferPalabras(BufferPalabras* buffer, size_t capacidadMinima);
+
+void liberarBufferPalabras(BufferPalabras* buffer);
+
+bool leerLinea(FILE* entrada, BufferPalabras* linea);
+
+// Operaciones de entrada (stdin)
+
+char* obtenerCadenaEntrada();
+
+char obtenerCaracterEntrada();
+
+typedef struct {
+    uint64_t bits[2];
+} ConjuntoCaracteres;
+
+ConjuntoCaracteres crearConjuntoCaracteres(const char *cadena);
+
+bool contieneCaracter(char caracter, const char *cadena);
+
+bool soloTieneSimbolosConjunto(const char *cadena, const char *conjunto);
+
+int contarCaracter(char caracter, const char *cadena);
+
+// Operaciones de cantidades grandes
+
+void mostrarCantidadAproximada(double mantisa, int exponente, FILE* salida);
+
+// Operaciones de conjuntos de bits
+
+#define BITS_POR_PALABRA 64
+
+int palabrasConjunto(int cantidadElementos);
+
+static inline void agregarElemento(uint64_t *conjunto, const int elemento) {
+    conjunto[elemento / BITS_POR_PALABRA] |= (uint64_t)1 << (elemento % BITS_POR_PALABRA);
+}
+
+typedef struct {
+    uint64_t estado[4];
+} GeneradorAleatorio;
+
+void sembrarGenerador(GeneradorAleatorio* generador, uint64_t semilla);
+
+uint64_t siguienteAleatorio(GeneradorAleatorio* generador);
+
+uint32_t aleatorioEnRango(GeneradorAleatorio* generador, uint32_t limite);
+
+double aleatorioUnitario(GeneradorAleatorio* generador);
+
+// --- Estructuras de datos ---
+
+// Un terminal (su byte), EPSILON o un no terminal (SIMBOLO_NO_TERMINAL + su índice).
+typedef int32_t Simbolo;
+
+typedef struct {
+    Simbolo ladoIzquierdo;
+    Simbolo ladoDerecho[LADO_DERECHO_MAX];
+    int32_t longitudLadoDerecho;
+    double peso;    // Peso relativo frente a las otras producciones del mismo no terminal (PESO_POR_DEFECTO si no se indica).
+} Produccion;
+
+typedef struct {
+    BufferPalabras nombres;     // Nombres separados por '\0': el del índice i empieza en nombres.datos + inicioNombre[i].
+    int *inicioNombre;
+    int cantidad;
+    int capacidad;
+    int cantidadDeclarados;     // Los no terminales declarados ocupan los índices [0, cantidadDeclarados).
+    int32_t *tabla;             // Hash abierto de índice + 1 por nombre (0 es una posición libre).
+    size_t capacidadTabla;      // Potencia de 2, el doble de "capacidad".
+} TablaNoTerminales;
+
+typedef struct {
+    // Elementos de una gramática
+    char *simbolosNoTerminales;
+    char *simbolosTerminales;
+    Produccion *producciones;
+    Simbolo axioma;
+    // Información administrativa
+    int cantidadProducciones;
+    // Clases de símbolos, calculadas una vez al cargar la gramática (ver inicializarClasesSimbolos).
+    ConjuntoCaracteres claseTerminales;
+    ConjuntoCaracteres claseEpsilon;
+    TablaNoTerminales noTerminales;
+} Gramatica;
+
+Gramatica* crearGramatica();
+
+bool esGramaticaRegular(const Gramatica* gramatica);
+
+void mostrarGramatica(const Gramatica* gramatica);
+
+void destruirGramatica(Gramatica* gramatica);
+
+void inicializarTablaNoTerminales(TablaNoTerminales* tabla);
+
+int internarNoTerminal(TablaNoTerminales* tabla, const char* nombre, size_t longitud);
+
+void liberarTablaNoTerminales(TablaNoTerminales* tabla);
+
+size_t longitudSimbolo(const char* cadena);
+
+bool esNombreNoTerminal(const char* simbolo, size_t longitud);
+
+// Textos de los símbolos de una producción, para mostrarla como "%s->%s%s".
+typedef struct {
+    char caracteres[LADO_DERECHO_MAX + 1][2];
+    const char *ladoIzquierdo;
+    const char *ladoDerecho[LADO_DERECHO_MAX];  // "" donde la producción no tiene símbolo.
+} TextoProduccion;
+
+void describirProduccionGramatica(const Gramatica* gramatica, const Produccion* produccion, TextoProduccion* texto);
+
+// Gramática tal como se leyó de un archivo o de los argumentos, antes de parsearla.
+typedef struct {
+    const char *simbolosNoTerminales;
+    const char *simbolosTerminales;
+    const char *producciones;
+    const char *axioma;
+} DescripcionGramatica;
+
+Gramatica* crearGramaticaDesdeCadenas(const char* simbolosNoTerminales, const char* simbolosTerminales, const char* producciones, const char* axioma);
+
+Produccion* parsearProducciones(char* cadenaProducciones, TablaNoTerminales* noTerminales, int* resultadoCantidadProducciones);
+
+bool cumpleValidaciones(const Gramatica* gramatica);
+
+// --- Archivos de gramaticas ---
+
+typedef struct {
+    FILE *archivo;
+    BufferPalabras linea;
+    int numeroLinea;
+    // Campos de la gramática que se está leyendo.
+    BufferPalabras simbolosNoTerminales;
+    BufferPalabras simbolosTerminales;
+    BufferPalabras producciones;
+    BufferPalabras axioma;
+} LectorGramaticas;
+
+void inicializarLectorGramaticas(LectorGramaticas* lector, FILE* archivo);
+
+bool leerSiguienteGramatica(LectorGramaticas* lector, DescripcionGramatica* descripcion, bool* hayErrores);
+
+void liberarLectorGramaticas(LectorGramaticas* lector);
+
+// --- Gramatica compilada ---
+
+#define SIN_NO_TERMINAL (-1)
+
+typedef struct {
+    char terminal;  // EPSILON si la producción no emite ningún terminal.
+    int siguiente;  // Fila del no terminal que queda luego de aplicar la producción (o SIN_NO_TERMINAL).
+} Transicion;
+
+typedef struct {
+    int cantidadNoTerminales;   // Filas de la tabla: los no terminales declarados y, si se normalizó, la fila inicial.
+    int *inicioFila;            // La fila i ocupa las posiciones [inicioFila[i], inicioFila[i + 1]).
+    Produccion *producciones;   // Producciones ordenadas por fila.
+    Transicion *transiciones;   // En paralelo con "producciones".
+    int cantidadProducciones;
+    int axioma;
+    bool esLinealAIzquierda;    // Si es true, la tabla es la versión normalizada (lineal a derecha) de una lineal a izquierda.
+    // Nombres de los no terminales declarados: el de la fila i empieza en nombres + inicioNombre[i].
+    char *nombres;
+    int *inicioNombre;
+    int cantidadNombres;
+    size_t longitudNombres;     // Incluye el '\0' de cada nombre.
+    // Análisis de símbolos útiles (solo quedan en la tabla las producciones útiles). Cada conjunto tiene un
+    // bit por fila en "palabrasPorConjunto" palabras; los tres ocupan una sola reserva que empieza en "usados".
+    int palabrasPorConjunto;
+    uint64_t *usados;
+    uint64_t *productivos;
+    uint64_t *alcanzables;
+    int produccionesDescartadas;
+    // Producciones con peso: tabla de alias (Walker/Vose) en paralelo con "transiciones".
+    bool esPonderada;           // Si es true, la gramática ingresada indica pesos.
+    double *probabilidadAlias;  // Probabilidad de quedarse con la producción sorteada en lugar de su alias.
+    int *alias;                 // NULL si las producciones de cada fila se eligen de manera uniforme.
+} GramaticaCompilada;
+
+GramaticaCompilada* compilarGramatica(const Gramatica* gramatica);
+
+char* generarPalabraAleatoria(const GramaticaCompilada* compilada, GeneradorAleatorio* generador, bool mostrarDerivacion);
+
+bool esLenguajeVacio(const GramaticaCompilada* compilada);
+
+void mostrarAnalisisGramatica(const GramaticaCompilada* compilada, FILE* salida);
+
+void destruirGramaticaCompilada(GramaticaCompilada* compilada);
+
+int indiceNoTerminal(Simbolo simbolo);
+
+const char* nombreNoTerminal(const GramaticaCompilada* compilada, int fila);
+
+// --- Derivacion ---
+
+bool derivarPalabra(const GramaticaCompilada* compilada, GeneradorAleatorio* generador, BufferPalabras* destino);
+
+// --- Generacion masiva ---
+
+// Cantidad de palabras que se generan antes de volcar el buffer a la salida.
+#define BLOQUE_PALABRAS 65536
+
+// Generador de palabras de una fuente cualquiera (gramática compilada, muestreador, ...), con el mismo contrato que generarPalabras.
+typedef size_t (*FuncionGeneracion)(const void* fuente, GeneradorAleatorio* generador, size_t cantidadPalabras, BufferPalabras* destino);
+
+size_t generarPalabras(const GramaticaCompilada* compilada, GeneradorAleatorio* generador, size_t cantidadPalabras, BufferPalabras* destino);
+
+size_t generarPalabrasGramatica(const void* compilada, GeneradorAleatorio* generador, size_t cantidadPalabras, BufferPalabras* destino);
+
+bool generarPalabrasEnSalida(FuncionGeneracion generar, const void* fuente, size_t cantidadPalabras, uint64_t semilla, int cantidadHilos, FILE* salida);
+
+#define MAX_HILOS 256
+
+bool generarPalabrasEnFlujo(const GramaticaCompilada* compilada, size_t cantidadPalabras, uint64_t semilla, FILE* salida);
+
+// --- Automata ---
+
+#define ESTADO_SUMIDERO 0
+
+typedef struct {
+    int columna;
+    int destino;
+} AristaAFN;
+
+typedef struct {
+    int cantidadEstados;
+    int palabrasPorConjunto;
+    int *inicioAristas;         // Las aristas del estado q ocupan [inicioAristas[q], inicioAristas[q + 1]).
+    AristaAFN *aristas;
+    uint64_t *iniciales;
+    uint64_t *finales;
+} AFN;
+
+typedef struct {
+    int cantidadEstados;
+    int cantidadColumnas;       // Terminales del alfabeto más una última columna para los bytes que no pertenecen a él.
+    uint16_t clase[256];        // Columna correspondiente a cada byte.
+    char *simbolos;             // Terminal de cada columna (sin contar la última).
+    int32_t *transiciones;      // cantidadEstados * cantidadColumnas.
+    bool *esFinal;
+    int32_t estadoInicial;
+    // Estadísticas de la construcción.
+    int estadosAFN;
+    int estadosSinMinimizar;
+} Automata;
+
+Automata* construirAutomata(const GramaticaCompilada* compilada);
+
+bool aceptaPalabra(const Automata* automata, const char* palabra, size_t longitud);
+
+bool reconocerEntrada(const Automata* automata, FILE* entrada, FILE* salida);
+
+bool minimizarAutomata(Automata* automata);
+
+size_t bytesTablaAutomata(const Automata* automata);
+
+void mostrarEstadisticasAutomata(const Automata* automata, FILE* salida);
+
+void destruirAutomata(Automata* automata);
+
+void destruirAFN(AFN* afn);
+
+bool determinizar(const AFN* afn, Automata* automata);
+
+// --- Muestreo por longitud ---
+
+typedef struct {
+    const Automata *automata;
+    size_t longitud;
+    double *completaciones;     // (longitud + 1) * cantidadEstados; la fila r es C[r] escalada.
+    int *escalas;               // C[r][q] = completaciones[r][q] * ESCALA_MUESTREO ^ escalas[r].
+} MuestreadorLongitud;
+
+MuestreadorLongitud* crearMuestreadorLongitud(const Automata* automata, size_t longitud);
+
+bool muestrearPalabra(const MuestreadorLongitud* muestreador, GeneradorAleatorio* generador, BufferPalabras* destino);
+
+size_t muestrearPalabras(const void* muestreador, GeneradorAleatorio* generador, size_t cantidadPalabras, BufferPalabras* destino);
+
+bool hayPalabrasDeLongitud(const MuestreadorLongitud* muestreador);
+
+void mostrarCantidadPalabrasLongitud(const MuestreadorLongitud* muestreador, FILE* salida);
+
+void destruirMuestreadorLongitud(MuestreadorLongitud* muestreador);
+
+// --- Enumeracion ---
+
+typedef struct {
+    const Automata *automata;
+    size_t longitudMaxima;
+    bool *alcanzaFinal;         // (longitudMaxima + 1) * cantidadEstados.
+} Enumerador;
+
+Enumerador* crearEnumerador(const Automata* automata, size_t longitudMaxima);
+
+bool enumerarPalabrasEnSalida(const Enumerador* enumerador, int cantidadHilos, FILE* salida);
+
+void destruirEnumerador(Enumerador* enumerador);
+
+// --- Conteo ---
+
+typedef struct {
+    uint64_t residuo;
+    double mantisa;
+    int exponente;          // Cantidad aproximada: mantisa * 2^exponente.
+} CantidadPalabras;
+
+bool contarPalabrasLongitud(const Automata* automata, size_t longitud, uint64_t modulo, CantidadPalabras* cantidad);
+
+bool contarPalabrasHasta(const Automata* automata, size_t longitudMaxima, uint64_t modulo, FILE* salida);
+
+void mostrarCantidadPalabras(const CantidadPalabras* cantidad, uint64_t modulo, FILE* salida);
+
+// --- Equivalencia ---
+
+typedef enum {
+    RELACION_EQUIVALENCIA,      // L(primera) = L(segunda).
+    RELACION_INCLUSION          // L(primera) ⊆ L(segunda).
+} RelacionLenguajes;
+
+typedef enum {
+    COMPARACION_ERROR,          // No se pudo terminar la comparación (falta de memoria).
+    COMPARACION_SE_CUMPLE,
+    COMPARACION_NO_SE_CUMPLE    // El resultado tiene el contraejemplo.
+} EstadoComparacion;
+
+typedef struct {
+    char *contraejemplo;        // Palabra más corta que pertenece a un solo lenguaje (NULL si la relación se cumple).
+    size_t longitudContraejemplo;
+    bool perteneceAPrimera;     // Si el contraejemplo pertenece al lenguaje de la primera gramática o al de la segunda.
+    int paresExplorados;
+    int estadosConstruidos[2];  // Estados de cada AFD perezoso (en la inclusión, el primero es el de la unión).
+} ResultadoComparacion;
+
+EstadoComparacion compararLenguajes(const GramaticaCompilada* primera, const GramaticaCompilada* segunda, RelacionLenguajes relacion, ResultadoComparacion* resultado);
+
+void liberarResultadoComparacion(ResultadoComparacion* resultado);
+
+// --- Linea de comandos ---
+
+bool parsearNumero(const char* cadena, size_t* resultado);
+
+#endif
@@ -1,14 +1,16 @@
-﻿#include <stdio.h>
-#include <stdbool.h>
-#include <stdlib.h>
-#include <string.h>
-#include <time.h>
+﻿#include "gramatica.h"
+#include "benchmark.h"
+#include "busqueda.h"
+#include "cache.h"
+#include "codigo.h"
+#include "serializacion.h"
+#include "servidor.h"
 
 // WINUTIL
 
-#ifdef _WIN32
-    #include <windows.h>
-#endif
+// Compilacion: make (sin make: gcc -O2 main.c benchmark.c busqueda.c cache.c codigo.c serializacion.c servidor.c -o gramatica.exe,
+// en Linux agregando -pthread -lm)
+// Con -DINSTRUMENTACION, la generacion informa que producciones aplica y cuanto tardan las derivaciones.
 
 void habilitarColoresConsola() {
 #ifdef _WIN32
@@ -27,79 +29,554 @@ void habilitarColoresConsola() {
 #endif
 }
 
-// --- Macros ---
+double obtenerTiempoSegundos() {
+#ifdef _WIN32
+    LARGE_INTEGER frecuencia, contador;
+    QueryPerformanceFrequency(&frecuencia);
+    QueryPerformanceCounter(&contador);
+    return (double)contador.QuadPart / (double)frecuencia.QuadPart;
+#else
+    struct timespec tiempo;
+    clock_gettime(CLOCK_MONOTONIC, &tiempo);
+    return (double)tiempo.tv_sec + (double)tiempo.tv_nsec / 1e9;
+#endif
+}
+
+int obtenerCantidadNucleos() {
+#ifdef _WIN32
+    SYSTEM_INFO informacionSistema;
+    GetSystemInfo(&informacionSistema);
+    return (int)informacionSistema.dwNumberOfProcessors;
+#else
+    const long cantidadNucleos = sysconf(_SC_NPROCESSORS_ONLN);
+    return cantidadNucleos > 0 ? (int)cantidadNucleos : 1;
+#endif
+}
+
+// Hilos: las funciones de los hilos se declaran como "RETORNO_HILO funcion(void* argumento)" y devuelven 0.
+
+bool crearHilo(Hilo *hilo, const FuncionHilo funcion, void *argumento) {
+#ifdef _WIN32
+    *hilo = CreateThread(NULL, 0, funcion, argumento, 0, NULL);
+    return *hilo != NULL;
+#else
+    return pthread_create(hilo, NULL, funcion, argumento) == 0;
+#endif
+}
+
+void esperarHilo(const Hilo hilo) {
+#ifdef _WIN32
+    WaitForSingleObject(hilo, INFINITE);
+    CloseHandle(hilo);
+#else
+    pthread_join(hilo, NULL);
+#endif
+}
+
+// Ejecuta "funcion" sobre cada uno de los "cantidad" trabajos (de "tamanio" bytes cada uno) y espera a que terminen.
+// El primer trabajo lo ejecuta el hilo llamador; si no se puede crear algún hilo, ese trabajo también se ejecuta en él.
+// "hilos" debe tener lugar para "cantidad" elementos.
+void ejecutarEnParalelo(const FuncionHilo funcion, void *trabajos, const size_t tamanio, const int cantidad, Hilo *hilos) {
+    char *base = trabajos;
+    int hilosCreados = 1;
+    while (hilosCreados < cantidad && crearHilo(&hilos[hilosCreados], funcion, base + hilosCreados * tamanio)) {
+        hilosCreados++;
+    }
+    if (cantidad > 0) {
+        funcion(base);
+    }
+    for (int i = 1; i < hilosCreados; i++) {
+        esperarHilo(hilos[i]);
+    }
+    for (int i = hilosCreados; i < cantidad; i++) {
+        funcion(base + i * tamanio);
+    }
+}
+
+// Exclusión mutua y variables de condición (SRWLOCK/CONDITION_VARIABLE en Windows).
+
+void inicializarMutex(Mutex *mutex) {
+#ifdef _WIN32
+    InitializeSRWLock(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void destruirMutex(Mutex *mutex) {
+#ifdef _WIN32
+    (void)mutex;
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
 
-#define ANSI_COLOR_RED      "\x1b[31m"
-#define ANSI_COLOR_BLUE     "\x1b[34m"
-#define ANSI_COLOR_RESET    "\x1b[0m"
+void bloquearMutex(Mutex *mutex) {
+#ifdef _WIN32
+    AcquireSRWLockExclusive(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
 
-#define printmsg(format,...) \
-    printf(ANSI_COLOR_BLUE format ANSI_COLOR_RESET, ##__VA_ARGS__)
-#define printerr(format,...) \
-    fprintf(stderr, ANSI_COLOR_RED "[ERROR] " format ANSI_COLOR_RESET, ##__VA_ARGS__)
+void desbloquearMutex(Mutex *mutex) {
+#ifdef _WIN32
+    ReleaseSRWLockExclusive(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
 
-// Para mensajes internos.
-#define DESARROLLO true
+void inicializarCondicion(Condicion *condicion) {
+#ifdef _WIN32
+    InitializeConditionVariable(condicion);
+#else
+    pthread_cond_init(condicion, NULL);
+#endif
+}
 
-#define memprinterr() \
-    if(DESARROLLO) printerr("La funcion malloc() fallo cuando se ejecuto en: %s()\n",__func__)
+void destruirCondicion(Condicion *condicion) {
+#ifdef _WIN32
+    (void)condicion;
+#else
+    pthread_cond_destroy(condicion);
+#endif
+}
 
-// Una gramática regular tiene como máximo 2 símbolos en su lado derecho.
-#define LADO_DERECHO_MAX 2
+// Libera "mutex" mientras espera y lo vuelve a tomar antes de volver.
+void esperarCondicion(Condicion *condicion, Mutex *mutex) {
+#ifdef _WIN32
+    SleepConditionVariableSRW(condicion, mutex, INFINITE, 0);
+#else
+    pthread_cond_wait(condicion, mutex);
+#endif
+}
 
-#define PRODUCCION_MIN 4
+void despertarUno(Condicion *condicion) {
+#ifdef _WIN32
+    WakeConditionVariable(condicion);
+#else
+    pthread_cond_signal(condicion);
+#endif
+}
 
-#define STDIN_BUFFER_SIZE 1024
+void despertarTodos(Condicion *condicion) {
+#ifdef _WIN32
+    WakeAllConditionVariable(condicion);
+#else
+    pthread_cond_broadcast(condicion);
+#endif
+}
 
-#define EPSILON '@'
+bool mapearArchivo(const char *ruta, ArchivoMapeado *mapeado) {
+#ifdef _WIN32
+    mapeado->archivo = CreateFileA(ruta, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mapeado->archivo == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER tamanio;
+    if (!GetFileSizeEx(mapeado->archivo, &tamanio) || tamanio.QuadPart == 0) {
+        CloseHandle(mapeado->archivo);
+        return false;
+    }
+    mapeado->mapeo = CreateFileMappingA(mapeado->archivo, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapeado->mapeo == NULL) {
+        CloseHandle(mapeado->archivo);
+        return false;
+    }
+    mapeado->datos = MapViewOfFile(mapeado->mapeo, FILE_MAP_READ, 0, 0, 0);
+    if (mapeado->datos == NULL) {
+        CloseHandle(mapeado->mapeo);
+        CloseHandle(mapeado->archivo);
+        return false;
+    }
+    mapeado->tamanio = (size_t)tamanio.QuadPart;
+    return true;
+#else
+    const int descriptor = open(ruta, O_RDONLY);
+    if (descriptor < 0) {
+        return false;
+    }
+    struct stat informacion;
+    if (fstat(descriptor, &informacion) != 0 || informacion.st_size == 0) {
+        close(descriptor);
+        return false;
+    }
+    void *datos = mmap(NULL, (size_t)informacion.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (datos == MAP_FAILED) {
+        return false;
+    }
+    mapeado->datos = datos;
+    mapeado->tamanio = (size_t)informacion.st_size;
+    return true;
+#endif
+}
 
-#define SIMBOLOS_NO_TERMINALES "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-#define SIMBOLOS_TERMINALES "abcdefghijklmnopqrstuvwxyz"
+void desmapearArchivo(ArchivoMapeado *mapeado) {
+#ifdef _WIN32
+    UnmapViewOfFile(mapeado->datos);
+    CloseHandle(mapeado->mapeo);
+    CloseHandle(mapeado->archivo);
+#else
+    munmap((void *)mapeado->datos, mapeado->tamanio);
+#endif
+}
 
 // --- Utils ---
 
+// Mensajes de error
+
+static _Thread_local Diagnosticos *diagnosticosHilo = NULL;
+
+// Desde esta llamada y hasta capturarDiagnosticos(NULL), printerr agrega los mensajes del hilo a "destino" (sin colores).
+void capturarDiagnosticos(Diagnosticos *destino) {
+    if (destino != NULL) {
+        destino->texto[0] = '\0';
+        destino->longitud = 0;
+    }
+    diagnosticosHilo = destino;
+}
+
+void reportarError(const char *formato, ...) {
+    va_list argumentos;
+    va_start(argumentos, formato);
+    Diagnosticos *destino = diagnosticosHilo;
+    if (destino != NULL) {
+        const size_t disponible = sizeof(destino->texto) - destino->longitud;
+        const int escritos = vsnprintf(destino->texto + destino->longitud, disponible, formato, argumentos);
+        if (escritos > 0) {
+            destino->longitud += (size_t)escritos < disponible ? (size_t)escritos : disponible - 1;
+        }
+    } else {
+        fprintf(stderr, ANSI_COLOR_RED "[ERROR] ");
+        vfprintf(stderr, formato, argumentos);
+        fprintf(stderr, ANSI_COLOR_RESET);
+    }
+    va_end(argumentos);
+}
+
 // Operaciones de manejo de memoria
 
-// Considerar que si utilizamos hilos esto puede tener race-conditions.
+/*
+        Todas las reservas de memoria pasan por tmalloc/tcalloc/trealloc/tfree.
+        Cada bloque lleva un encabezado con su tamaño y su subsistema, así tfree
+        no necesita que le indiquen el tamaño. La memoria en uso y el pico son
+        atómicos; la cantidad de asignaciones y de bytes se acumulan por hilo y
+        se vuelcan a los contadores globales con volcarContadoresMemoria().
+ */
+
+ContadoresMemoria heapUsado[CANTIDAD_SUBSISTEMAS + 1];
+
+static const char *NOMBRES_SUBSISTEMAS[CANTIDAD_SUBSISTEMAS + 1] = {
+    "parseo", "validacion", "compilacion", "derivacion", "generacion", "automata", "muestreo", "enumeracion", "conteo", "equivalencia", "busqueda", "serializacion", "cache", "servidor", "total"
+};
 
-extern size_t heapUsado;
+typedef union {
+    struct {
+        size_t size;
+        SubsistemaMemoria subsistema;
+    } datos;
+    max_align_t alineacion; // Para que el bloque devuelto quede alineado como el de malloc().
+} EncabezadoMemoria;
 
-void* tmalloc(size_t size);
+static void actualizarPico(atomic_size_t *pico, const size_t valor) {
+    size_t picoActual = atomic_load_explicit(pico, memory_order_relaxed);
+    while (valor > picoActual && !atomic_compare_exchange_weak_explicit(pico, &picoActual, valor, memory_order_relaxed, memory_order_relaxed));
+}
 
-void tfree(void* ptr, size_t size);
+static _Thread_local size_t asignacionesHilo[CANTIDAD_SUBSISTEMAS];
 
-size_t heapUsado = 0;
+static _Thread_local size_t bytesAsignadosHilo[CANTIDAD_SUBSISTEMAS];
 
-void* tmalloc(const size_t size) {
-    heapUsado += size;
-    return malloc(size);
+static void registrarAsignacion(const SubsistemaMemoria subsistema, const size_t size) {
+    const int indices[2] = {subsistema, CANTIDAD_SUBSISTEMAS};
+    for (int i = 0; i < 2; i++) {
+        ContadoresMemoria *contadores = &heapUsado[indices[i]];
+        const size_t actual = atomic_fetch_add_explicit(&contadores->actual, size, memory_order_relaxed) + size;
+        actualizarPico(&contadores->pico, actual);
+    }
+    asignacionesHilo[subsistema]++;
+    bytesAsignadosHilo[subsistema] += size;
 }
 
-void tfree(void* ptr, const size_t size) {
-    heapUsado -= size;
-    free(ptr);
+static void registrarLiberacion(const SubsistemaMemoria subsistema, const size_t size) {
+    atomic_fetch_sub_explicit(&heapUsado[subsistema].actual, size, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&heapUsado[CANTIDAD_SUBSISTEMAS].actual, size, memory_order_relaxed);
 }
 
-// Operaciones de entrada (stdin)
+void* tmalloc(const size_t size, const SubsistemaMemoria subsistema) {
+    EncabezadoMemoria *encabezado = malloc(sizeof(EncabezadoMemoria) + size);
+    if (encabezado == NULL) {
+        return NULL;
+    }
+    encabezado->datos.size = size;
+    encabezado->datos.subsistema = subsistema;
+    registrarAsignacion(subsistema, size);
+    return encabezado + 1;
+}
+
+void* tcalloc(const size_t cantidad, const size_t size, const SubsistemaMemoria subsistema) {
+    if (size != 0 && cantidad > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *ptr = tmalloc(cantidad * size, subsistema);
+    if (ptr != NULL) {
+        memset(ptr, 0, cantidad * size);
+    }
+    return ptr;
+}
+
+void* trealloc(void* ptr, const size_t size, const SubsistemaMemoria subsistema) {
+    if (ptr == NULL) {
+        return tmalloc(size, subsistema);
+    }
+    EncabezadoMemoria *encabezado = (EncabezadoMemoria*)ptr - 1;
+    const size_t sizeAnterior = encabezado->datos.size;
+    const SubsistemaMemoria subsistemaAnterior = encabezado->datos.subsistema;
+    EncabezadoMemoria *nuevoEncabezado = realloc(encabezado, sizeof(EncabezadoMemoria) + size);
+    if (nuevoEncabezado == NULL) {
+        return NULL;
+    }
+    registrarLiberacion(subsistemaAnterior, sizeAnterior);
+    registrarAsignacion(subsistema, size);
+    nuevoEncabezado->datos.size = size;
+    nuevoEncabezado->datos.subsistema = subsistema;
+    return nuevoEncabezado + 1;
+}
+
+void tfree(void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    EncabezadoMemoria *encabezado = (EncabezadoMemoria*)ptr - 1;
+    registrarLiberacion(encabezado->datos.subsistema, encabezado->datos.size);
+    free(encabezado);
+}
+
+// Cada hilo debe llamarla antes de terminar para que sus asignaciones aparezcan en el reporte.
+void volcarContadoresMemoria() {
+    for (int i = 0; i < CANTIDAD_SUBSISTEMAS; i++) {
+        const int indices[2] = {i, CANTIDAD_SUBSISTEMAS};
+        for (int j = 0; j < 2; j++) {
+            atomic_fetch_add_explicit(&heapUsado[indices[j]].asignaciones, asignacionesHilo[i], memory_order_relaxed);
+            atomic_fetch_add_explicit(&heapUsado[indices[j]].bytesAsignados, bytesAsignadosHilo[i], memory_order_relaxed);
+        }
+        asignacionesHilo[i] = 0;
+        bytesAsignadosHilo[i] = 0;
+    }
+}
+
+// Hace que el pico de cada subsistema pase a ser su uso actual, para medir el pico de una etapa en particular.
+void reiniciarPicoMemoria() {
+    for (int i = 0; i <= CANTIDAD_SUBSISTEMAS; i++) {
+        atomic_store(&heapUsado[i].pico, atomic_load(&heapUsado[i].actual));
+    }
+}
+
+void reportarMemoria() {
+    volcarContadoresMemoria();
+    fprintf(stderr, "\n%-13s %13s %14s %14s %16s\n", "Subsistema", "Actual (B)", "Pico (B)", "Asignaciones", "Bytes asignados");
+    for (int i = 0; i <= CANTIDAD_SUBSISTEMAS; i++) {
+        const ContadoresMemoria *contadores = &heapUsado[i];
+        fprintf(stderr, "%-13s %13zu %14zu %14zu %16zu\n", NOMBRES_SUBSISTEMAS[i],
+                atomic_load(&contadores->actual), atomic_load(&contadores->pico),
+                atomic_load(&contadores->asignaciones), atomic_load(&contadores->bytesAsignados));
+    }
+}
+
+// Instrumentación del generador
+
+/*
+        Solo existe si se compila con -DINSTRUMENTACION: sin esa macro,
+        INSTRUMENTAR(...) no genera código y el generador queda igual que
+        siempre. Cada hilo cuenta en variables propias cuántas veces se
+        aplica cada producción, cuántos pasos lleva cada derivación (en un
+        histograma por potencias de 2), cuántos números pide al generador
+        aleatorio y cuánto tiempo pasa en cada fase; al terminar, el hilo
+        los suma a los totales con volcarInstrumentacion().
+ */
+
+#ifdef INSTRUMENTACION
+
+typedef enum {
+    FASE_GENERACION,    // Derivación de las palabras (sumando el tiempo de todos los hilos).
+    FASE_ESCRITURA,     // Escritura de los buffers en la salida.
+    CANTIDAD_FASES
+} FaseInstrumentada;
+
+static const char *NOMBRES_FASES[CANTIDAD_FASES] = {"generacion", "escritura"};
+
+// La cubeta 0 cuenta las derivaciones de 0 pasos y la cubeta k > 0, las de [2^(k-1), 2^k) pasos.
+#define CUBETAS_HISTOGRAMA 65
 
-char* obtenerCadenaEntrada();
+typedef struct {
+    uint64_t *disparos;             // Veces que se aplicó cada producción de la tabla compilada.
+    int cantidadProducciones;
+    uint64_t derivaciones;
+    uint64_t pasos;
+    uint64_t pasosMaximo;
+    uint64_t histograma[CUBETAS_HISTOGRAMA];
+    uint64_t llamadasAleatorio;
+    double segundosFase[CANTIDAD_FASES];
+    bool disparosIncompletos;       // Si es true, faltó memoria para contar alguna aplicación.
+} Instrumentacion;
+
+static _Thread_local Instrumentacion instrumentacionHilo;
+
+static Instrumentacion instrumentacionTotal;
+
+static Mutex mutexInstrumentacion = MUTEX_INICIALIZADO;
+
+static void registrarDisparo(const int produccion, const int cantidadProducciones) {
+    Instrumentacion *instrumentacion = &instrumentacionHilo;
+    if (produccion >= instrumentacion->cantidadProducciones) {
+        uint64_t *disparos = trealloc(instrumentacion->disparos, cantidadProducciones * sizeof(uint64_t), MEMORIA_GENERACION);
+        if (disparos == NULL) {
+            instrumentacion->disparosIncompletos = true;
+            return;
+        }
+        memset(disparos + instrumentacion->cantidadProducciones, 0,
+               (cantidadProducciones - instrumentacion->cantidadProducciones) * sizeof(uint64_t));
+        instrumentacion->disparos = disparos;
+        instrumentacion->cantidadProducciones = cantidadProducciones;
+    }
+    instrumentacion->disparos[produccion]++;
+}
+
+static void registrarDerivacion(const uint64_t pasos) {
+    Instrumentacion *instrumentacion = &instrumentacionHilo;
+    int cubeta = 0;
+    while (cubeta < CUBETAS_HISTOGRAMA - 1 && pasos >> cubeta != 0) {
+        cubeta++;
+    }
+    instrumentacion->histograma[cubeta]++;
+    instrumentacion->derivaciones++;
+    instrumentacion->pasos += pasos;
+    if (pasos > instrumentacion->pasosMaximo) {
+        instrumentacion->pasosMaximo = pasos;
+    }
+}
+
+static void registrarTiempoFase(const FaseInstrumentada fase, const double inicio) {
+    instrumentacionHilo.segundosFase[fase] += obtenerTiempoSegundos() - inicio;
+}
+
+// Cada hilo que genera palabras debe llamarla antes de terminar, igual que volcarContadoresMemoria().
+void volcarInstrumentacion() {
+    Instrumentacion *hilo = &instrumentacionHilo;
+    Instrumentacion *total = &instrumentacionTotal;
+    bloquearMutex(&mutexInstrumentacion);
+    if (hilo->cantidadProducciones > total->cantidadProducciones) {
+        uint64_t *disparos = trealloc(total->disparos, hilo->cantidadProducciones * sizeof(uint64_t), MEMORIA_GENERACION);
+        if (disparos != NULL) {
+            memset(disparos + total->cantidadProducciones, 0, (hilo->cantidadProducciones - total->cantidadProducciones) * sizeof(uint64_t));
+            total->disparos = disparos;
+            total->cantidadProducciones = hilo->cantidadProducciones;
+        } else {
+            total->disparosIncompletos = true;
+        }
+    }
+    total->disparosIncompletos |= hilo->disparosIncompletos;
+    for (int i = 0; i < hilo->cantidadProducciones && i < total->cantidadProducciones; i++) {
+        total->disparos[i] += hilo->disparos[i];
+    }
+    total->derivaciones += hilo->derivaciones;
+    total->pasos += hilo->pasos;
+    if (hilo->pasosMaximo > total->pasosMaximo) {
+        total->pasosMaximo = hilo->pasosMaximo;
+    }
+    for (int i = 0; i < CUBETAS_HISTOGRAMA; i++) {
+        total->histograma[i] += hilo->histograma[i];
+    }
+    total->llamadasAleatorio += hilo->llamadasAleatorio;
+    for (int i = 0; i < CANTIDAD_FASES; i++) {
+        total->segundosFase[i] += hilo->segundosFase[i];
+    }
+    desbloquearMutex(&mutexInstrumentacion);
+    tfree(hilo->disparos);
+    memset(hilo, 0, sizeof(Instrumentacion));
+}
+
+#endif
+
+// Operaciones de buffers
+
+#define CAPACIDAD_INICIAL_BUFFER 4096
+
+void inicializarBufferPalabras(BufferPalabras *buffer, const SubsistemaMemoria subsistema) {
+    buffer->datos = NULL;
+    buffer->longitud = 0;
+    buffer->capacidad = 0;
+    buffer->subsistema = subsistema;
+}
+
+bool reservarBufferPalabras(BufferPalabras *buffer, const size_t capacidadMinima) {
+    if (capacidadMinima <= buffer->capacidad) {
+        return true;
+    }
+    size_t nuevaCapacidad = buffer->capacidad > 0 ? buffer->capacidad : CAPACIDAD_INICIAL_BUFFER;
+    while (nuevaCapacidad < capacidadMinima) {
+        nuevaCapacidad *= 2;
+    }
+    char *nuevosDatos = trealloc(buffer->datos, nuevaCapacidad, buffer->subsistema);
+    if (nuevosDatos == NULL) {
+        memprinterr();
+        return false;
+    }
+    buffer->datos = nuevosDatos;
+    buffer->capacidad = nuevaCapacidad;
+    return true;
+}
+
+void liberarBufferPalabras(BufferPalabras *buffer) {
+    tfree(buffer->datos);
+    inicializarBufferPalabras(buffer, buffer->subsistema);
+}
+
+// Lee una línea de cualquier longitud (sin el '\n' ni el '\r' final) y la deja como C String en "linea".
+// Devuelve false si no quedaban datos por leer o si no hay memoria.
+bool leerLinea(FILE *entrada, BufferPalabras *linea) {
+    linea->longitud = 0;
+    int caracter;
+    while ((caracter = getc(entrada)) != EOF && caracter != '\n') {
+        if (linea->longitud + 1 >= linea->capacidad && !reservarBufferPalabras(linea, linea->longitud + 2)) {
+            return false;
+        }
+        linea->datos[linea->longitud++] = (char)caracter;
+    }
+    if (caracter == EOF && linea->longitud == 0) {
+        return false;
+    }
+    if (!reservarBufferPalabras(linea, linea->longitud + 1)) {
+        return false;
+    }
+    if (linea->longitud > 0 && linea->datos[linea->longitud - 1] == '\r') {
+        linea->longitud--;
+    }
+    linea->datos[linea->longitud] = '\0';
+    return true;
+}
 
-char obtenerCaracterEntrada();
+// Operaciones de entrada (stdin)
 
 char *obtenerCadenaEntrada() {
 
-    char bufferEntrada[STDIN_BUFFER_SIZE];
-    if (fgets(bufferEntrada,sizeof(bufferEntrada),stdin) == NULL) {
+    BufferPalabras bufferEntrada;
+    inicializarBufferPalabras(&bufferEntrada, MEMORIA_PARSEO);
+    if (!leerLinea(stdin, &bufferEntrada)) {
         printerr("No se pudo leer la cadena desde stdin.");
+        liberarBufferPalabras(&bufferEntrada);
+        return NULL;
     }
-    const size_t longitudCadena = strcspn(bufferEntrada, "\n");
-    bufferEntrada[longitudCadena] = '\0'; // Lo hacemos C String.
-    char* cadenaEntrada = malloc((longitudCadena + 1) * sizeof(char));
+    char* cadenaEntrada = tmalloc((bufferEntrada.longitud + 1) * sizeof(char), MEMORIA_PARSEO);
     if (cadenaEntrada == NULL) {
         memprinterr();
+        liberarBufferPalabras(&bufferEntrada);
         return NULL;
     }
-    strcpy(cadenaEntrada, bufferEntrada);
+    memcpy(cadenaEntrada, bufferEntrada.datos, bufferEntrada.longitud + 1);
+    liberarBufferPalabras(&bufferEntrada);
     return cadenaEntrada;
 }
 
@@ -117,11 +594,28 @@ char obtenerCaracterEntrada() {
 
 // Operaciones de cadenas
 
-bool contieneCaracter(char caracter, const char *cadena);
+/*
+        Conjuntos de caracteres ASCII como máscaras de 128 bits: saber si un
+        caracter pertenece a un conjunto es un solo test de bit, en lugar de
+        recorrer la cadena del conjunto con strchr. Los bytes fuera de ASCII
+        nunca pertenecen a un conjunto.
+ */
 
-bool soloTieneSimbolosConjunto(const char *cadena, const char *conjunto);
+static inline bool perteneceConjunto(const ConjuntoCaracteres *conjunto, const char caracter) {
+    const unsigned char c = (unsigned char)caracter;
+    return c < 128 && (conjunto->bits[c >> 6] >> (c & 63) & 1);
+}
 
-int contarCaracter(char caracter, const char *cadena);
+ConjuntoCaracteres crearConjuntoCaracteres(const char *cadena) {
+    ConjuntoCaracteres conjunto = {{0, 0}};
+    for (int i = 0; cadena != NULL && cadena[i] != '\0'; i++) {
+        const unsigned char c = (unsigned char)cadena[i];
+        if (c < 128) {
+            conjunto.bits[c >> 6] |= (uint64_t)1 << (c & 63);
+        }
+    }
+    return conjunto;
+}
 
 bool contieneCaracter(const char caracter, const char *cadena) {
     if (cadena == NULL) {
@@ -134,8 +628,9 @@ bool soloTieneSimbolosConjunto(const char *cadena, const char *conjunto) {
     if (cadena == NULL || conjunto == NULL) {
         return false;
     }
+    const ConjuntoCaracteres caracteres = crearConjuntoCaracteres(conjunto);
     for (int i = 0; cadena[i] != '\0'; i++) {
-        if (!contieneCaracter(cadena[i],conjunto)) {
+        if (!perteneceConjunto(&caracteres, cadena[i])) {
             return false;
         }
     }
@@ -150,152 +645,451 @@ int contarCaracter(const char caracter, const char *cadena) {
     return ocurrenciasCaracter;
 }
 
-// --- Estructuras de datos ---
+// Operaciones de cantidades grandes
 
-typedef struct {
-    char ladoIzquierdo;
-    char ladoDerecho[LADO_DERECHO_MAX + 1];
-} Produccion;
+// Muestra mantisa * 2^exponente en notación científica decimal ("~5.90296e+20"), aunque no entre en un double.
+void mostrarCantidadAproximada(const double mantisa, const int exponente, FILE *salida) {
+    const double logaritmo = log10(mantisa) + exponente * log10(2.0);
+    double potencia = floor(logaritmo);
+    double cifras = pow(10.0, logaritmo - potencia);
+    // Así el redondeo a 6 cifras nunca muestra "10.00000".
+    if (cifras >= 9.999995) {
+        cifras /= 10;
+        potencia++;
+    }
+    fprintf(salida, "~%.5fe+%.0f", cifras, potencia);
+}
 
-typedef struct {
-    // Elementos de una gramática
-    char *simbolosNoTerminales;
-    char *simbolosTerminales;
-    Produccion *producciones;
-    char axioma;
-    // Información administrativa
-    int cantidadProducciones;
-} Gramatica;
+// Operaciones de conjuntos de bits
 
-Gramatica* crearGramatica();
+int palabrasConjunto(const int cantidadElementos) {
+    return (cantidadElementos + BITS_POR_PALABRA - 1) / BITS_POR_PALABRA;
+}
 
-bool esGramaticaRegular(const Gramatica* gramatica);
+static inline bool contieneElemento(const uint64_t *conjunto, const int elemento) {
+    return (conjunto[elemento / BITS_POR_PALABRA] >> (elemento % BITS_POR_PALABRA)) & 1;
+}
 
-void mostrarGramatica(const Gramatica* gramatica);
+// Operaciones de números aleatorios
 
-char* generarPalabraAleatoria(const Gramatica* gramatica);
+/*
+        Usamos xoshiro256** en lugar de rand(): cada hilo tiene su propio
+        estado (no hay estado global compartido) y la secuencia queda
+        determinada por la semilla, que se expande con splitmix64.
+ */
 
-void destruirGramatica(Gramatica* gramatica);
+static uint64_t splitmix64(uint64_t *semilla) {
+    uint64_t z = (*semilla += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
 
-void destruirGramatica(Gramatica *gramatica) {
-    if (gramatica != NULL) {
-        if (gramatica->simbolosNoTerminales != NULL) {
-            free(gramatica->simbolosNoTerminales);
-        }
-        if (gramatica->simbolosTerminales != NULL) {
-            free(gramatica->simbolosTerminales);
-        }
-        if (gramatica->producciones != NULL) {
-            free(gramatica->producciones);
-        }
-        free(gramatica);
-    }
+static uint64_t rotarIzquierda(const uint64_t valor, const int bits) {
+    return (valor << bits) | (valor >> (64 - bits));
 }
 
-char *obtenerSimbolosNoTerminales() {
-    printmsg("Ingrese los simbolos no terminales (sin espacios, ni comas): ");
-    char *simbolosNoTerminales = obtenerCadenaEntrada();
-    if (!soloTieneSimbolosConjunto(simbolosNoTerminales,SIMBOLOS_NO_TERMINALES)) {
-        printerr("Ha ingresado simbolos no terminales incorrectos (por ej. ',' o una minuscula)");
-        free(simbolosNoTerminales);
-        return NULL;
+void sembrarGenerador(GeneradorAleatorio *generador, uint64_t semilla) {
+    for (int i = 0; i < 4; i++) {
+        generador->estado[i] = splitmix64(&semilla);
     }
-    return simbolosNoTerminales;
 }
 
-char *obtenerSimbolosTerminales() {
-    printmsg("Ingrese los simbolos terminales (sin espacios, ni comas): ");
-    char *simbolosTerminales = obtenerCadenaEntrada();
-    if (!soloTieneSimbolosConjunto(simbolosTerminales,SIMBOLOS_TERMINALES)) {
-        printerr("Ha ingresado simbolos terminales incorrectos (por ej. ',' o una mayuscula)");
-        free(simbolosTerminales);
-        return NULL;
+uint64_t siguienteAleatorio(GeneradorAleatorio *generador) {
+    INSTRUMENTAR(instrumentacionHilo.llamadasAleatorio++;)
+    uint64_t *s = generador->estado;
+    const uint64_t resultado = rotarIzquierda(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotarIzquierda(s[3], 45);
+    return resultado;
+}
+
+// Número uniforme en [0, limite) sin sesgo (método de Lemire, sin divisiones en el caso común).
+uint32_t aleatorioEnRango(GeneradorAleatorio *generador, const uint32_t limite) {
+    uint64_t producto = (uint64_t)(uint32_t)(siguienteAleatorio(generador) >> 32) * limite;
+    uint32_t parteBaja = (uint32_t)producto;
+    if (parteBaja < limite) {
+        const uint32_t umbral = -limite % limite;
+        while (parteBaja < umbral) {
+            producto = (uint64_t)(uint32_t)(siguienteAleatorio(generador) >> 32) * limite;
+            parteBaja = (uint32_t)producto;
+        }
     }
-    return simbolosTerminales;
+    return (uint32_t)(producto >> 32);
+}
+
+// Número uniforme en [0, 1) con 53 bits de precisión.
+double aleatorioUnitario(GeneradorAleatorio *generador) {
+    return (double)(siguienteAleatorio(generador) >> 11) * 0x1.0p-53;
 }
 
-char obtenerAxioma() {
-    printmsg("Ingrese el axioma (en mayuscula): ");
-    const char axioma = obtenerCaracterEntrada();
-    if (!contieneCaracter(axioma,SIMBOLOS_NO_TERMINALES)) {
-        printerr("Ha ingresado un caracter que no puede ser axioma.");
-        return '\0';
+// --- Estructuras de datos ---
+
+/*
+        Los terminales son caracteres y se representan con su byte. Los no
+        terminales se escriben con una mayúscula ("S") o con un nombre entre
+        ángulos ("<Estado_12>") y se internan en una TablaNoTerminales, que
+        les asigna índices densos: primero los declarados, en el orden de la
+        declaración, y después los que solo aparecen en las producciones (que
+        la validación rechaza). En las producciones el no terminal i se guarda
+        como SIMBOLO_NO_TERMINAL + i, así que todas las tablas se dimensionan
+        según la cantidad de no terminales de la gramática, sin límite fijo.
+ */
+
+#define SIMBOLO_NO_TERMINAL 256
+
+#define SIN_SIMBOLO (-1)
+
+#define INICIO_NOMBRE '<'
+#define FIN_NOMBRE '>'
+
+void inicializarTablaNoTerminales(TablaNoTerminales *tabla) {
+    inicializarBufferPalabras(&tabla->nombres, MEMORIA_PARSEO);
+    tabla->inicioNombre = NULL;
+    tabla->cantidad = 0;
+    tabla->capacidad = 0;
+    tabla->cantidadDeclarados = 0;
+    tabla->tabla = NULL;
+    tabla->capacidadTabla = 0;
+}
+
+void liberarTablaNoTerminales(TablaNoTerminales *tabla) {
+    liberarBufferPalabras(&tabla->nombres);
+    tfree(tabla->inicioNombre);
+    tfree(tabla->tabla);
+    inicializarTablaNoTerminales(tabla);
+}
+
+// FNV-1a del nombre.
+static uint64_t hashNombre(const char *nombre, const size_t longitud) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < longitud; i++) {
+        hash = (hash ^ (unsigned char)nombre[i]) * 0x100000001B3ULL;
     }
-    return axioma;
+    return hash ^ hash >> 32;
 }
 
-bool esFormatoProduccionValido(const char *produccion) {
-    if (produccion == NULL) {
+// Duplica la capacidad de la tabla y vuelve a ubicar los nombres que ya tenía.
+static bool crecerTablaNoTerminales(TablaNoTerminales *tabla) {
+    const int nuevaCapacidad = tabla->capacidad > 0 ? tabla->capacidad * 2 : 32;
+    const size_t capacidadTabla = 2 * (size_t)nuevaCapacidad;
+    int *inicioNombre = trealloc(tabla->inicioNombre, nuevaCapacidad * sizeof(int), MEMORIA_PARSEO);
+    if (inicioNombre == NULL) {
         return false;
     }
-    const size_t longitudCadena = strlen(produccion);
-    // Validamos que la cadena ingresada tenga como mínimo 4 ("PRODUCCION_MIN") caracteres. Por ejemplo: "S->x"
-    if (longitudCadena < PRODUCCION_MIN) {
+    tabla->inicioNombre = inicioNombre;
+    int32_t *nuevaTabla = tcalloc(capacidadTabla, sizeof(int32_t), MEMORIA_PARSEO);
+    if (nuevaTabla == NULL) {
         return false;
     }
-    // Validamos que la cadena ingresada tenga una flecha "->"
-    const char *flecha = strstr(produccion, "->");
-    if (flecha == NULL) {
-        return false;
+    for (int i = 0; i < tabla->cantidad; i++) {
+        const char *nombre = tabla->nombres.datos + inicioNombre[i];
+        size_t posicion = hashNombre(nombre, strlen(nombre)) & (capacidadTabla - 1);
+        while (nuevaTabla[posicion] != 0) {
+            posicion = (posicion + 1) & (capacidadTabla - 1);
+        }
+        nuevaTabla[posicion] = i + 1;
     }
-    // Validamos que el lado izquierdo de la cadena, tenga un único caracter.
-    const size_t longitudLadoIzquierdo = flecha - produccion;
-    if (longitudLadoIzquierdo != 1) {
-        return false;
+    tfree(tabla->tabla);
+    tabla->tabla = nuevaTabla;
+    tabla->capacidadTabla = capacidadTabla;
+    tabla->capacidad = nuevaCapacidad;
+    return true;
+}
+
+// Devuelve el índice del no terminal, agregándolo si no estaba (o -1 si no hay memoria).
+int internarNoTerminal(TablaNoTerminales *tabla, const char *nombre, const size_t longitud) {
+    if (tabla->cantidad == tabla->capacidad && !crecerTablaNoTerminales(tabla)) {
+        memprinterr();
+        return -1;
     }
-    // Validamos que el lado derecho no contenga más flechas.
-    const char *ladoDerecho = flecha + 2; // strlen("->") = 2
-    if (strstr(ladoDerecho, "->") != NULL) {
+    size_t posicion = hashNombre(nombre, longitud) & (tabla->capacidadTabla - 1);
+    while (tabla->tabla[posicion] != 0) {
+        const int indice = tabla->tabla[posicion] - 1;
+        const char *existente = tabla->nombres.datos + tabla->inicioNombre[indice];
+        if (strncmp(existente, nombre, longitud) == 0 && existente[longitud] == '\0') {
+            return indice;
+        }
+        posicion = (posicion + 1) & (tabla->capacidadTabla - 1);
+    }
+    BufferPalabras *nombres = &tabla->nombres;
+    if (!reservarBufferPalabras(nombres, nombres->longitud + longitud + 1)) {
+        return -1;
+    }
+    tabla->inicioNombre[tabla->cantidad] = (int)nombres->longitud;
+    memcpy(nombres->datos + nombres->longitud, nombre, longitud);
+    nombres->longitud += longitud;
+    nombres->datos[nombres->longitud++] = '\0';
+    tabla->tabla[posicion] = tabla->cantidad + 1;
+    return tabla->cantidad++;
+}
+
+// Longitud del símbolo que empieza en "cadena": un nombre "<...>" completo o un solo caracter (0 si la cadena terminó).
+size_t longitudSimbolo(const char *cadena) {
+    if (*cadena == INICIO_NOMBRE) {
+        const char *fin = strchr(cadena, FIN_NOMBRE);
+        if (fin != NULL) {
+            return fin - cadena + 1;
+        }
+    }
+    return *cadena != '\0' ? 1 : 0;
+}
+
+// Un no terminal es una mayúscula o un nombre de letras, dígitos, '_' o '.' entre ángulos (por ej. "<Estado_12>").
+bool esNombreNoTerminal(const char *simbolo, const size_t longitud) {
+    if (longitud == 1) {
+        return contieneCaracter(simbolo[0], SIMBOLOS_NO_TERMINALES);
+    }
+    if (longitud < 3 || simbolo[0] != INICIO_NOMBRE || simbolo[longitud - 1] != FIN_NOMBRE) {
+        return false;
+    }
+    for (size_t i = 1; i + 1 < longitud; i++) {
+        const char c = simbolo[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Texto de un símbolo para mostrarlo: el nombre del no terminal o el caracter, que se escribe en "caracter" (2 bytes).
+static const char *textoSimbolo(const char *nombres, const int *inicioNombre, const Simbolo simbolo, char *caracter) {
+    if (simbolo >= SIMBOLO_NO_TERMINAL) {
+        return nombres + inicioNombre[simbolo - SIMBOLO_NO_TERMINAL];
+    }
+    caracter[0] = (char)simbolo;
+    caracter[1] = '\0';
+    return caracter;
+}
+
+static void describirProduccion(const char *nombres, const int *inicioNombre, const Produccion *produccion, TextoProduccion *texto) {
+    texto->ladoIzquierdo = textoSimbolo(nombres, inicioNombre, produccion->ladoIzquierdo, texto->caracteres[LADO_DERECHO_MAX]);
+    for (int i = 0; i < LADO_DERECHO_MAX; i++) {
+        texto->ladoDerecho[i] = i < produccion->longitudLadoDerecho
+                                    ? textoSimbolo(nombres, inicioNombre, produccion->ladoDerecho[i], texto->caracteres[i])
+                                    : "";
+    }
+}
+
+void describirProduccionGramatica(const Gramatica *gramatica, const Produccion *produccion, TextoProduccion *texto) {
+    describirProduccion(gramatica->noTerminales.nombres.datos, gramatica->noTerminales.inicioNombre, produccion, texto);
+}
+
+void destruirGramatica(Gramatica *gramatica) {
+    if (gramatica != NULL) {
+        if (gramatica->simbolosNoTerminales != NULL) {
+            tfree(gramatica->simbolosNoTerminales);
+        }
+        if (gramatica->simbolosTerminales != NULL) {
+            tfree(gramatica->simbolosTerminales);
+        }
+        if (gramatica->producciones != NULL) {
+            tfree(gramatica->producciones);
+        }
+        liberarTablaNoTerminales(&gramatica->noTerminales);
+        tfree(gramatica);
+    }
+}
+
+bool sonSimbolosNoTerminalesValidos(const char *simbolosNoTerminales) {
+    bool sonValidos = simbolosNoTerminales != NULL;
+    for (const char *c = simbolosNoTerminales; sonValidos && *c != '\0';) {
+        const size_t longitud = longitudSimbolo(c);
+        sonValidos = esNombreNoTerminal(c, longitud);
+        c += longitud;
+    }
+    if (!sonValidos) {
+        printerr("Ha ingresado simbolos no terminales incorrectos (por ej. ',' o una minuscula)");
+        return false;
+    }
+    return true;
+}
+
+bool sonSimbolosTerminalesValidos(const char *simbolosTerminales) {
+    if (!soloTieneSimbolosConjunto(simbolosTerminales,SIMBOLOS_TERMINALES)) {
+        printerr("Ha ingresado simbolos terminales incorrectos (por ej. ',' o una mayuscula)");
         return false;
     }
-    // Validamos que el lado derecho tenga como máximo 2 ("LADO_DERECHO_MAX") símbolos. Por ejemplo: aT
-    if (strlen(ladoDerecho) > LADO_DERECHO_MAX) {
+    return true;
+}
+
+bool esAxiomaValido(const char *axioma) {
+    if (axioma == NULL || *axioma == '\0' || longitudSimbolo(axioma) != strlen(axioma) || !esNombreNoTerminal(axioma, strlen(axioma))) {
+        printerr("Ha ingresado un simbolo que no puede ser axioma.");
         return false;
     }
     return true;
 }
 
-Produccion parsearProduccion(const char* cadenaProduccion) {
-    Produccion nuevaProduccion;
+char *obtenerSimbolosNoTerminales() {
+    printmsg("Ingrese los simbolos no terminales (mayusculas o nombres como <Estado_1>, sin espacios, ni comas): ");
+    char *simbolosNoTerminales = obtenerCadenaEntrada();
+    if (!sonSimbolosNoTerminalesValidos(simbolosNoTerminales)) {
+        tfree(simbolosNoTerminales);
+        return NULL;
+    }
+    return simbolosNoTerminales;
+}
+
+char *obtenerSimbolosTerminales() {
+    printmsg("Ingrese los simbolos terminales (sin espacios, ni comas): ");
+    char *simbolosTerminales = obtenerCadenaEntrada();
+    if (!sonSimbolosTerminalesValidos(simbolosTerminales)) {
+        tfree(simbolosTerminales);
+        return NULL;
+    }
+    return simbolosTerminales;
+}
+
+char *obtenerAxioma() {
+    printmsg("Ingrese el axioma (un simbolo no terminal): ");
+    char *axioma = obtenerCadenaEntrada();
+    if (!esAxiomaValido(axioma)) {
+        tfree(axioma);
+        return NULL;
+    }
+    return axioma;
+}
+
+bool esFormatoProduccionValido(const char *produccion) {
+    if (produccion == NULL) {
+        return false;
+    }
+    const size_t longitudCadena = strlen(produccion);
+    // Validamos que la cadena ingresada tenga como mínimo 4 ("PRODUCCION_MIN") caracteres. Por ejemplo: "S->x"
+    if (longitudCadena < PRODUCCION_MIN) {
+        return false;
+    }
+    // Validamos que la cadena ingresada tenga una flecha "->"
+    const char *flecha = strstr(produccion, "->");
+    if (flecha == NULL) {
+        return false;
+    }
+    // Validamos que el lado izquierdo de la cadena sea un único símbolo (una mayúscula o un nombre "<...>").
+    const size_t longitudLadoIzquierdo = flecha - produccion;
+    if (longitudLadoIzquierdo == 0 || longitudSimbolo(produccion) != longitudLadoIzquierdo ||
+        (longitudLadoIzquierdo > 1 && !esNombreNoTerminal(produccion, longitudLadoIzquierdo))) {
+        return false;
+    }
+    // Validamos que el lado derecho no contenga más flechas.
+    const char *ladoDerecho = flecha + 2; // strlen("->") = 2
+    if (strstr(ladoDerecho, "->") != NULL) {
+        return false;
+    }
+    // Validamos que el lado derecho tenga entre 1 y 2 ("LADO_DERECHO_MAX") símbolos. Por ejemplo: aT o a<Estado_1>
+    int cantidadSimbolos = 0;
+    for (const char *c = ladoDerecho; *c != '\0'; cantidadSimbolos++) {
+        const size_t longitud = longitudSimbolo(c);
+        if (longitud > 1 && !esNombreNoTerminal(c, longitud)) {
+            return false;
+        }
+        c += longitud;
+    }
+    return cantidadSimbolos >= 1 && cantidadSimbolos <= LADO_DERECHO_MAX;
+}
+
+// Los nombres y las mayúsculas son no terminales (se internan en la tabla); el resto de los caracteres se guarda tal cual.
+static Simbolo parsearSimbolo(const char *simbolo, const size_t longitud, TablaNoTerminales *noTerminales) {
+    if (longitud == 1 && !esNombreNoTerminal(simbolo, longitud)) {
+        return (unsigned char)simbolo[0];
+    }
+    const int indice = internarNoTerminal(noTerminales, simbolo, longitud);
+    return indice < 0 ? SIN_SIMBOLO : SIMBOLO_NO_TERMINAL + indice;
+}
+
+// Traduce una producción de formato válido, internando sus no terminales. Devuelve false si no hay memoria.
+bool parsearProduccion(const char *cadenaProduccion, TablaNoTerminales *noTerminales, Produccion *produccion) {
+    memset(produccion, 0, sizeof(Produccion));
     // Le asigno su lado izquierdo.
-    nuevaProduccion.ladoIzquierdo = cadenaProduccion[0];
+    const char *flecha = strstr(cadenaProduccion, "->");
+    produccion->ladoIzquierdo = parsearSimbolo(cadenaProduccion, flecha - cadenaProduccion, noTerminales);
+    bool exito = produccion->ladoIzquierdo != SIN_SIMBOLO;
     // Le asigno su lado derecho.
-    const char *ladoDerecho = cadenaProduccion + 3;
-    strncpy(nuevaProduccion.ladoDerecho, ladoDerecho, LADO_DERECHO_MAX);
-    nuevaProduccion.ladoDerecho[LADO_DERECHO_MAX] = '\0'; // Lo convertimos a C String.
-    return nuevaProduccion;
+    for (const char *c = flecha + 2; *c != '\0';) {
+        const size_t longitud = longitudSimbolo(c);
+        const Simbolo simbolo = parsearSimbolo(c, longitud, noTerminales);
+        produccion->ladoDerecho[produccion->longitudLadoDerecho++] = simbolo;
+        exito &= simbolo != SIN_SIMBOLO;
+        c += longitud;
+    }
+    produccion->peso = PESO_POR_DEFECTO;
+    return exito;
+}
+
+// El peso tiene que ser un número positivo y finito, por ejemplo "0.9" o "3".
+bool parsearPeso(const char *cadenaPeso, double *peso) {
+    char *fin;
+    const double valor = strtod(cadenaPeso, &fin);
+    if (fin == cadenaPeso || *fin != '\0' || !(valor > 0 && valor <= DBL_MAX)) {
+        return false;
+    }
+    *peso = valor;
+    return true;
 }
 
-Produccion *parsearProducciones(char *cadenaProducciones, int *resultadoCantidadProducciones) {
+Produccion *parsearProducciones(char *cadenaProducciones, TablaNoTerminales *noTerminales, int *resultadoCantidadProducciones) {
     // Se puede saber la cantidad de producciones a través de la cantidad de comas en el String más uno.
     const int cantidadProducciones = contarCaracter(',', cadenaProducciones) + 1;
-    Produccion *producciones = malloc((cantidadProducciones + 1) * sizeof(Produccion));
+    Produccion *producciones = tmalloc((cantidadProducciones + 1) * sizeof(Produccion), MEMORIA_PARSEO);
     if (producciones == NULL) {
         memprinterr();
         return NULL;
     }
-    const char *token = strtok(cadenaProducciones, ",");
-    for (int i = 0; (token != NULL && i < cantidadProducciones); i++) {
-        if (!esFormatoProduccionValido(token)) {
-            printerr("Formato invalido para una produccion ingresada: %s", token);
-            free(producciones);
-            return NULL;
+    // Separamos las producciones reemplazando cada coma por un fin de cadena (se omiten las vacías).
+    int cantidadParseadas = 0;
+    char *token = cadenaProducciones;
+    while (token != NULL) {
+        char *coma = strchr(token, ',');
+        if (coma != NULL) {
+            *coma = '\0';
+        }
+        if (*token != '\0') {
+            // Si la producción tiene peso ("S->aS:0.9"), se separa antes de validar el formato.
+            char *separadorPeso = strchr(token, SEPARADOR_PESO);
+            double peso = PESO_POR_DEFECTO;
+            if (separadorPeso != NULL) {
+                *separadorPeso = '\0';
+                if (!parsearPeso(separadorPeso + 1, &peso)) {
+                    printerr("Peso invalido para la produccion %s: %s", token, separadorPeso + 1);
+                    tfree(producciones);
+                    return NULL;
+                }
+            }
+            if (!esFormatoProduccionValido(token)) {
+                printerr("Formato invalido para una produccion ingresada: %s", token);
+                tfree(producciones);
+                return NULL;
+            }
+            if (!parsearProduccion(token, noTerminales, &producciones[cantidadParseadas])) {
+                tfree(producciones);
+                return NULL;
+            }
+            producciones[cantidadParseadas++].peso = peso;
         }
-        producciones[i] = parsearProduccion(token);
-        token = strtok(NULL, ",");
+        token = coma != NULL ? coma + 1 : NULL;
     }
-    *resultadoCantidadProducciones = cantidadProducciones;
+    if (cantidadParseadas == 0) {
+        printerr("No se ingreso ninguna produccion.");
+        tfree(producciones);
+        return NULL;
+    }
+    *resultadoCantidadProducciones = cantidadParseadas;
     return producciones;
 }
 
-Produccion *obtenerProducciones(int *resultadoCantidadProducciones) {
-    printmsg("Ingrese las producciones separadas por comas (ej: S->aT,S->a): ");
+Produccion *obtenerProducciones(TablaNoTerminales *noTerminales, int *resultadoCantidadProducciones) {
+    printmsg("Ingrese las producciones separadas por comas, con peso opcional (ej: S->aT:3,S->a): ");
     char *cadenaProducciones = obtenerCadenaEntrada();
     if (cadenaProducciones == NULL) {
         return NULL;
     }
-    Produccion *producciones = parsearProducciones(cadenaProducciones, resultadoCantidadProducciones);
-    free(cadenaProducciones);
+    Produccion *producciones = parsearProducciones(cadenaProducciones, noTerminales, resultadoCantidadProducciones);
+    tfree(cadenaProducciones);
     return producciones;
 }
 
@@ -303,12 +1097,49 @@ void inicializarGramatica(Gramatica* gramatica) {
     gramatica->simbolosNoTerminales = NULL;
     gramatica->simbolosTerminales = NULL;
     gramatica->producciones = NULL;
-    gramatica->axioma = '\0';
+    gramatica->axioma = SIN_SIMBOLO;
     gramatica->cantidadProducciones = 0;
+    gramatica->claseTerminales = crearConjuntoCaracteres(NULL);
+    gramatica->claseEpsilon = crearConjuntoCaracteres(NULL);
+    inicializarTablaNoTerminales(&gramatica->noTerminales);
+}
+
+// Además de las clases de terminales, interna los no terminales declarados para que reciban los primeros índices.
+bool inicializarClasesSimbolos(Gramatica *gramatica) {
+    const char epsilon[2] = {EPSILON, '\0'};
+    gramatica->claseTerminales = crearConjuntoCaracteres(gramatica->simbolosTerminales);
+    gramatica->claseEpsilon = crearConjuntoCaracteres(epsilon);
+    for (const char *c = gramatica->simbolosNoTerminales; *c != '\0';) {
+        const size_t longitud = longitudSimbolo(c);
+        if (internarNoTerminal(&gramatica->noTerminales, c, longitud) < 0) {
+            return false;
+        }
+        c += longitud;
+    }
+    gramatica->noTerminales.cantidadDeclarados = gramatica->noTerminales.cantidad;
+    return true;
+}
+
+static inline bool esTerminal(const Gramatica *gramatica, const Simbolo simbolo) {
+    return simbolo < SIMBOLO_NO_TERMINAL && perteneceConjunto(&gramatica->claseTerminales, (char)simbolo);
+}
+
+static inline bool esNoTerminal(const Gramatica *gramatica, const Simbolo simbolo) {
+    return simbolo >= SIMBOLO_NO_TERMINAL && simbolo - SIMBOLO_NO_TERMINAL < gramatica->noTerminales.cantidadDeclarados;
+}
+
+static inline bool esEpsilon(const Gramatica *gramatica, const Simbolo simbolo) {
+    return simbolo < SIMBOLO_NO_TERMINAL && perteneceConjunto(&gramatica->claseEpsilon, (char)simbolo);
+}
+
+// Interna el axioma (ya validado) al final, para que un axioma no declarado quede fuera de los declarados.
+static bool asignarAxioma(Gramatica *gramatica, const char *axioma) {
+    gramatica->axioma = parsearSimbolo(axioma, strlen(axioma), &gramatica->noTerminales);
+    return gramatica->axioma != SIN_SIMBOLO;
 }
 
 Gramatica *crearGramatica() {
-    Gramatica *nuevaGramatica = malloc(sizeof(Gramatica));
+    Gramatica *nuevaGramatica = tmalloc(sizeof(Gramatica), MEMORIA_PARSEO);
     if (nuevaGramatica == NULL) {
         memprinterr();
         return NULL;
@@ -324,52 +1155,245 @@ Gramatica *crearGramatica() {
         destruirGramatica(nuevaGramatica);
         return NULL;
     }
-    nuevaGramatica->producciones = obtenerProducciones(&nuevaGramatica->cantidadProducciones);
+    if (!inicializarClasesSimbolos(nuevaGramatica)) {
+        destruirGramatica(nuevaGramatica);
+        return NULL;
+    }
+    nuevaGramatica->producciones = obtenerProducciones(&nuevaGramatica->noTerminales, &nuevaGramatica->cantidadProducciones);
     if (nuevaGramatica->producciones == NULL) {
         destruirGramatica(nuevaGramatica);
         return NULL;
     }
-    nuevaGramatica->axioma = obtenerAxioma();
-    if (nuevaGramatica->axioma == '\0') {
+    char *axioma = obtenerAxioma();
+    const bool hayAxioma = axioma != NULL && asignarAxioma(nuevaGramatica, axioma);
+    tfree(axioma);
+    if (!hayAxioma) {
+        destruirGramatica(nuevaGramatica);
+        return NULL;
+    }
+    return nuevaGramatica;
+}
+
+static char *duplicarCadena(const char *cadena, const SubsistemaMemoria subsistema) {
+    const size_t longitud = strlen(cadena);
+    char *copia = tmalloc(longitud + 1, subsistema);
+    if (copia == NULL) {
+        memprinterr();
+        return NULL;
+    }
+    memcpy(copia, cadena, longitud + 1);
+    return copia;
+}
+
+// Igual que crearGramatica() pero a partir de cadenas ya leídas (archivos o argumentos), sin pedir nada por stdin.
+Gramatica *crearGramaticaDesdeCadenas(const char *simbolosNoTerminales, const char *simbolosTerminales,
+                                      const char *producciones, const char *axioma) {
+    if (!sonSimbolosNoTerminalesValidos(simbolosNoTerminales) || !sonSimbolosTerminalesValidos(simbolosTerminales) ||
+        !esAxiomaValido(axioma) || producciones == NULL) {
+        return NULL;
+    }
+    Gramatica *nuevaGramatica = tmalloc(sizeof(Gramatica), MEMORIA_PARSEO);
+    if (nuevaGramatica == NULL) {
+        memprinterr();
+        return NULL;
+    }
+    inicializarGramatica(nuevaGramatica);
+    nuevaGramatica->simbolosNoTerminales = duplicarCadena(simbolosNoTerminales, MEMORIA_PARSEO);
+    nuevaGramatica->simbolosTerminales = duplicarCadena(simbolosTerminales, MEMORIA_PARSEO);
+    char *cadenaProducciones = duplicarCadena(producciones, MEMORIA_PARSEO);
+    if (nuevaGramatica->simbolosNoTerminales == NULL || nuevaGramatica->simbolosTerminales == NULL || cadenaProducciones == NULL) {
+        tfree(cadenaProducciones);
+        destruirGramatica(nuevaGramatica);
+        return NULL;
+    }
+    nuevaGramatica->producciones = inicializarClasesSimbolos(nuevaGramatica)
+                                       ? parsearProducciones(cadenaProducciones, &nuevaGramatica->noTerminales, &nuevaGramatica->cantidadProducciones)
+                                       : NULL;
+    tfree(cadenaProducciones);
+    if (nuevaGramatica->producciones == NULL || !asignarAxioma(nuevaGramatica, axioma)) {
         destruirGramatica(nuevaGramatica);
         return NULL;
     }
     return nuevaGramatica;
 }
 
+// --- Archivos de gramaticas ---
+
+/*
+        Un archivo puede contener varias gramáticas separadas por una línea
+        "---". Cada gramática se describe con líneas "clave: valor":
+
+            # Comentario
+            no-terminales: STQ
+            terminales: abc
+            producciones: S->aS, S->aT, S->bT
+            producciones: S->bQ, S->c
+            axioma: S
+            ---
+            no-terminales: <Inicio><Par>
+            terminales: ab
+            producciones: <Inicio>->a<Par>, <Par>->b<Inicio>, <Par>->b
+            axioma: <Inicio>
+
+        Las líneas "producciones" se acumulan. Los espacios se ignoran y las
+        líneas pueden tener cualquier longitud: el archivo se lee de a una
+        línea con un buffer que crece, sin pedir nada al usuario.
+ */
+
+#define SEPARADOR_GRAMATICAS "---"
+
+void inicializarLectorGramaticas(LectorGramaticas *lector, FILE *archivo) {
+    lector->archivo = archivo;
+    lector->numeroLinea = 0;
+    inicializarBufferPalabras(&lector->linea, MEMORIA_PARSEO);
+    inicializarBufferPalabras(&lector->simbolosNoTerminales, MEMORIA_PARSEO);
+    inicializarBufferPalabras(&lector->simbolosTerminales, MEMORIA_PARSEO);
+    inicializarBufferPalabras(&lector->producciones, MEMORIA_PARSEO);
+    inicializarBufferPalabras(&lector->axioma, MEMORIA_PARSEO);
+}
+
+void liberarLectorGramaticas(LectorGramaticas *lector) {
+    liberarBufferPalabras(&lector->linea);
+    liberarBufferPalabras(&lector->simbolosNoTerminales);
+    liberarBufferPalabras(&lector->simbolosTerminales);
+    liberarBufferPalabras(&lector->producciones);
+    liberarBufferPalabras(&lector->axioma);
+}
+
+// Agrega "valor" sin espacios al final de "campo" (y una coma antes si se pide y el campo no estaba vacío).
+static bool agregarValorCampo(BufferPalabras *campo, const char *valor, const bool separarConComa) {
+    if (!reservarBufferPalabras(campo, campo->longitud + strlen(valor) + 2)) {
+        return false;
+    }
+    if (separarConComa && campo->longitud > 0) {
+        campo->datos[campo->longitud++] = ',';
+    }
+    for (const char *c = valor; *c != '\0'; c++) {
+        if (*c != ' ' && *c != '\t') {
+            campo->datos[campo->longitud++] = *c;
+        }
+    }
+    campo->datos[campo->longitud] = '\0';
+    return true;
+}
+
+// Procesa una línea "clave: valor". Devuelve false si la clave no existe o no hay memoria.
+static bool procesarLineaGramatica(LectorGramaticas *lector, char *linea) {
+    char *separador = strchr(linea, ':');
+    if (separador == NULL) {
+        printerr("Linea %d: se esperaba \"clave: valor\".\n", lector->numeroLinea);
+        return false;
+    }
+    *separador = '\0';
+    const char *valor = separador + 1;
+    if (strcmp(linea, "no-terminales") == 0) {
+        return agregarValorCampo(&lector->simbolosNoTerminales, valor, false);
+    }
+    if (strcmp(linea, "terminales") == 0) {
+        return agregarValorCampo(&lector->simbolosTerminales, valor, false);
+    }
+    if (strcmp(linea, "producciones") == 0) {
+        return agregarValorCampo(&lector->producciones, valor, true);
+    }
+    if (strcmp(linea, "axioma") == 0) {
+        return agregarValorCampo(&lector->axioma, valor, false);
+    }
+    printerr("Linea %d: clave desconocida \"%s\".\n", lector->numeroLinea, linea);
+    return false;
+}
+
+static char *campoComoCadena(const BufferPalabras *campo) {
+    return campo->longitud > 0 ? campo->datos : "";
+}
+
+/*
+        Lee los campos de la siguiente gramática del archivo (sin parsearlos).
+        Devuelve false si ya no quedan gramáticas. Si alguna línea tiene
+        errores, se informan, se saltea hasta el próximo separador y
+        "hayErrores" queda en true. Los campos de "descripcion" apuntan al
+        lector y valen hasta la próxima lectura.
+ */
+bool leerSiguienteGramatica(LectorGramaticas *lector, DescripcionGramatica *descripcion, bool *hayErrores) {
+    lector->simbolosNoTerminales.longitud = 0;
+    lector->simbolosTerminales.longitud = 0;
+    lector->producciones.longitud = 0;
+    lector->axioma.longitud = 0;
+    bool hayDatos = false;
+    *hayErrores = false;
+    while (leerLinea(lector->archivo, &lector->linea)) {
+        lector->numeroLinea++;
+        char *linea = lector->linea.datos;
+        // Salteamos los espacios iniciales, las líneas vacías y los comentarios.
+        while (*linea == ' ' || *linea == '\t') {
+            linea++;
+        }
+        if (*linea == '\0' || *linea == '#') {
+            continue;
+        }
+        if (strncmp(linea, SEPARADOR_GRAMATICAS, strlen(SEPARADOR_GRAMATICAS)) == 0) {
+            if (hayDatos) {
+                break;
+            }
+            continue;
+        }
+        hayDatos = true;
+        if (!*hayErrores && !procesarLineaGramatica(lector, linea)) {
+            *hayErrores = true;
+        }
+    }
+    if (!hayDatos) {
+        return false;
+    }
+    descripcion->simbolosNoTerminales = campoComoCadena(&lector->simbolosNoTerminales);
+    descripcion->simbolosTerminales = campoComoCadena(&lector->simbolosTerminales);
+    descripcion->producciones = campoComoCadena(&lector->producciones);
+    descripcion->axioma = campoComoCadena(&lector->axioma);
+    return true;
+}
+
 void mostrarGramatica(const Gramatica *gramatica) {
     printmsg("\nGramatica regular ingresada:\n");
     printmsg("GR = ({%s},{%s},{", gramatica->simbolosNoTerminales, gramatica->simbolosTerminales);
     for (int i = 0; i < gramatica->cantidadProducciones; i++) {
-        printmsg("%c->%s", gramatica->producciones[i].ladoIzquierdo, gramatica->producciones[i].ladoDerecho);
+        TextoProduccion texto;
+        describirProduccionGramatica(gramatica, &gramatica->producciones[i], &texto);
+        printmsg("%s->%s%s", texto.ladoIzquierdo, texto.ladoDerecho[0], texto.ladoDerecho[1]);
+        if (gramatica->producciones[i].peso != PESO_POR_DEFECTO) {
+            printmsg("%c%g", SEPARADOR_PESO, gramatica->producciones[i].peso);
+        }
         if (i + 1 < gramatica->cantidadProducciones) {
             printmsg(",");
         }
     }
-    printmsg("},%c)\n", gramatica->axioma);
+    char caracter[2];
+    printmsg("},%s)\n", textoSimbolo(gramatica->noTerminales.nombres.datos, gramatica->noTerminales.inicioNombre, gramatica->axioma, caracter));
 }
 
 bool esAxiomaSimboloNoTerminal(const Gramatica *gramatica) {
-    return contieneCaracter(gramatica->axioma,gramatica->simbolosNoTerminales);
+    return esNoTerminal(gramatica, gramatica->axioma);
 }
 
 bool sonLadosIzquierdosSimbolosNoTerminales(const Gramatica *gramatica) {
     for (int i = 0; i < gramatica->cantidadProducciones; i++) {
-        const char ladoIzquierdoProduccion = gramatica->producciones[i].ladoIzquierdo;
-        if (!contieneCaracter(ladoIzquierdoProduccion, SIMBOLOS_NO_TERMINALES)) {
-            printerr("El lado izquierdo de la produccion %d no es un simbolo no terminal: %c.", i++, ladoIzquierdoProduccion);
+        const Produccion *produccion = &gramatica->producciones[i];
+        if (!esNoTerminal(gramatica, produccion->ladoIzquierdo)) {
+            TextoProduccion texto;
+            describirProduccionGramatica(gramatica, produccion, &texto);
+            printerr("El lado izquierdo de la produccion %d no es un simbolo no terminal: %s.", i++, texto.ladoIzquierdo);
             return false;
         }
     }
     return true;
 }
 
-bool esLinealAIzquierda(const char* ladoDerecho, const Gramatica *gramatica) {
-    return (contieneCaracter(ladoDerecho[0],gramatica->simbolosTerminales) && contieneCaracter(ladoDerecho[1],gramatica->simbolosNoTerminales));
+// Lineal a izquierda: el no terminal queda al frente (por ej. Ta).
+bool esLinealAIzquierda(const Simbolo* ladoDerecho, const Gramatica *gramatica) {
+    return esNoTerminal(gramatica, ladoDerecho[0]) && esTerminal(gramatica, ladoDerecho[1]);
 }
 
-bool esLinealADerecha(const char* ladoDerecho, const Gramatica *gramatica) {
-    return (contieneCaracter(ladoDerecho[0],gramatica->simbolosNoTerminales) && contieneCaracter(ladoDerecho[1],gramatica->simbolosTerminales));
+// Lineal a derecha: el no terminal queda al final (por ej. aT).
+bool esLinealADerecha(const Simbolo* ladoDerecho, const Gramatica *gramatica) {
+    return esTerminal(gramatica, ladoDerecho[0]) && esNoTerminal(gramatica, ladoDerecho[1]);
 }
 
 /*
@@ -378,17 +1402,16 @@ bool esLinealADerecha(const char* ladoDerecho, const Gramatica *gramatica) {
 
         - Un símbolo terminal (o EPSILON).
         - Un símbolo terminal seguido de un símbolo no terminal (Lineal a derecha)
-        - Un símbolo no terminal seguido de un símbolo no terminal (Lineal a izquierda)
+        - Un símbolo no terminal seguido de un símbolo terminal (Lineal a izquierda)
  */
-bool cumpleRestriccionesGramaticaRegular(const char *ladoDerecho, const Gramatica *gramatica) {
-    const char* simbolosTerminales = gramatica->simbolosTerminales;
-    const size_t longitudLadoDerecho = strlen(ladoDerecho);
+bool cumpleRestriccionesGramaticaRegular(const Produccion *produccion, const Gramatica *gramatica) {
+    const Simbolo *ladoDerecho = produccion->ladoDerecho;
     // Primer caso: Si se trata de un solo símbolo, este debe ser terminal o ser Epsilon.
-    if (longitudLadoDerecho == 1) {
-        return contieneCaracter(ladoDerecho[0],simbolosTerminales) || ladoDerecho[0] == EPSILON;
+    if (produccion->longitudLadoDerecho == 1) {
+        return esTerminal(gramatica, ladoDerecho[0]) || esEpsilon(gramatica, ladoDerecho[0]);
     }
     // Segundo caso: Si se trata de dos símbolos, debe ser alguna de las combinaciones mencionadas anteriormente.
-    if (longitudLadoDerecho == 2) {
+    if (produccion->longitudLadoDerecho == 2) {
         return esLinealADerecha(ladoDerecho,gramatica) || esLinealAIzquierda(ladoDerecho,gramatica);
     }
     // Si el lado derecho no contiene una cantidad diferente de símbolos entonces no cumple. (No debería evaluarse).
@@ -397,9 +1420,12 @@ bool cumpleRestriccionesGramaticaRegular(const char *ladoDerecho, const Gramatic
 
 bool sonLadosDerechosValidos(const Gramatica *gramatica) {
     for (int i = 0; i < gramatica->cantidadProducciones; i++) {
-        const char *ladoDerechoProduccion = gramatica->producciones[i].ladoDerecho;
-        if (!cumpleRestriccionesGramaticaRegular(ladoDerechoProduccion, gramatica)) {
-            printerr("El lado derecho de la produccion %d no cumple con las restricciones de las gramaticas regulares: %s.",i++, ladoDerechoProduccion);
+        const Produccion *produccion = &gramatica->producciones[i];
+        if (!cumpleRestriccionesGramaticaRegular(produccion, gramatica)) {
+            TextoProduccion texto;
+            describirProduccionGramatica(gramatica, produccion, &texto);
+            printerr("El lado derecho de la produccion %d no cumple con las restricciones de las gramaticas regulares: %s%s.",i++,
+                     texto.ladoDerecho[0], texto.ladoDerecho[1]);
             return false;
         }
     }
@@ -410,12 +1436,11 @@ bool tieneLinealidadUnica(const Gramatica *gramatica) {
     bool tieneLinealidadADerecha = false;
     bool tieneLinealidadAIzquierda = false;
     for (int i = 0; i < gramatica->cantidadProducciones; i++) {
-        const char *ladoDerecho = gramatica->producciones[i].ladoDerecho;
-        const size_t longitudLadoDerecho = strlen(ladoDerecho);
+        const Simbolo *ladoDerecho = gramatica->producciones[i].ladoDerecho;
         // Solo verificamos producciones de 2 símbolos (las de 1 símbolo no afectan la linealidad)
-        if (longitudLadoDerecho == 2) {
-            tieneLinealidadADerecha = esLinealADerecha(ladoDerecho,gramatica);
-            tieneLinealidadAIzquierda = esLinealAIzquierda(ladoDerecho,gramatica);
+        if (gramatica->producciones[i].longitudLadoDerecho == 2) {
+            tieneLinealidadADerecha |= esLinealADerecha(ladoDerecho,gramatica);
+            tieneLinealidadAIzquierda |= esLinealAIzquierda(ladoDerecho,gramatica);
             // Si tiene linealidad a izquierda y a derecha simultáneamente, no es regular.
             if (tieneLinealidadADerecha && tieneLinealidadAIzquierda) {
                 printerr("La gramatica contiene producciones lineales a derecha e izquierda simultaneamente.");
@@ -427,31 +1452,36 @@ bool tieneLinealidadUnica(const Gramatica *gramatica) {
     return true;
 }
 
-#define CANTIDAD_LETRAS 52
-
 bool seUsaEpsilonCorrectamente(const Gramatica *gramatica) {
-    bool simbolosConEpsilon[CANTIDAD_LETRAS] = {false};
+    // Un lugar por cada caracter y por cada no terminal de la tabla.
+    bool *simbolosConEpsilon = tcalloc(SIMBOLO_NO_TERMINAL + gramatica->noTerminales.cantidad, sizeof(bool), MEMORIA_VALIDACION);
+    if (simbolosConEpsilon == NULL) {
+        memprinterr();
+        return false;
+    }
     // Marcamos los simbolos no terminales que producen epsilon.
     for (int i = 0; i < gramatica->cantidadProducciones; i++) {
-        const char* ladoDerecho = gramatica->producciones[i].ladoDerecho;
-        if (strlen(ladoDerecho) == 1 && ladoDerecho[0] == EPSILON) {
-            const char ladoIzquierdo = gramatica->producciones[i].ladoIzquierdo;
-            simbolosConEpsilon[(int)ladoIzquierdo] = true;
+        const Produccion *produccion = &gramatica->producciones[i];
+        if (produccion->longitudLadoDerecho == 1 && produccion->ladoDerecho[0] == EPSILON) {
+            simbolosConEpsilon[produccion->ladoIzquierdo] = true;
         }
     }
     // Verificamos que no vuelvan a aparecer en el lado derecho de otras producciones.
-    for (int i = 0; i < gramatica->cantidadProducciones; i++) {
-        const char* ladoDerecho = gramatica->producciones[i].ladoDerecho;
-        const size_t longitudLadoDerecho = strlen(ladoDerecho);
-        for (int j = 0; j < longitudLadoDerecho; j++) {
-            const char simboloActual = ladoDerecho[j];
-            if (simbolosConEpsilon[(int)simboloActual]) {
-                printerr("El simbolo '%c' produce epsilon pero aparece en el lado derecho de otra produccion.\n",ladoDerecho[j]);
-                return false;
+    bool esCorrecto = true;
+    for (int i = 0; esCorrecto && i < gramatica->cantidadProducciones; i++) {
+        const Produccion *produccion = &gramatica->producciones[i];
+        for (int j = 0; j < produccion->longitudLadoDerecho; j++) {
+            if (simbolosConEpsilon[produccion->ladoDerecho[j]]) {
+                TextoProduccion texto;
+                describirProduccionGramatica(gramatica, produccion, &texto);
+                printerr("El simbolo '%s' produce epsilon pero aparece en el lado derecho de otra produccion.\n", texto.ladoDerecho[j]);
+                esCorrecto = false;
+                break;
             }
         }
     }
-    return true;
+    tfree(simbolosConEpsilon);
+    return esCorrecto;
 }
 
 bool cumpleValidaciones(const Gramatica *gramatica) {
@@ -487,125 +1517,3470 @@ bool esGramaticaRegular(const Gramatica *gramatica) {
     return cumpleValidaciones(gramatica);
 }
 
-// -----------
+// --- Gramatica compilada ---
 
-char buscarNoTerminal(const char* cadenaDerivacion, const char* simbolosNoTerminales) {
-    if (cadenaDerivacion == NULL) {
-        return '\0';
-    }
-    for (int i = 0; cadenaDerivacion[i] != '\0'; i++) {
-        if (contieneCaracter(cadenaDerivacion[i],simbolosNoTerminales)) {
-            return cadenaDerivacion[i];
-        }
-    }
-    return '\0';
+/*
+        Una vez validada, la gramática se compila a una tabla con una fila por
+        no terminal declarado (en el orden de la declaración). Las producciones
+        de cada fila quedan contiguas, por lo que elegir una producción es O(1)
+        y no reserva memoria. Dentro de cada fila siguen un orden canónico que
+        no depende del orden en que se ingresaron (ver
+        ordenarProduccionesCanonicas), así que con la misma semilla se generan
+        las mismas palabras sin importar ese orden ni si se usa la caché. Las
+        gramáticas lineales a izquierda se normalizan a lineales a derecha (ver
+        normalizarLinealAIzquierda), con una fila inicial extra al final de la
+        tabla.
+ */
+
+int indiceNoTerminal(const Simbolo simbolo) {
+    return simbolo - SIMBOLO_NO_TERMINAL;
 }
 
-Produccion* obtenerProduccionesDeNoTerminal(const Gramatica* gramatica, const char noTerminalActual, int* cantidadProduccionesEncontradas) {
+Simbolo simboloNoTerminal(const int indice) {
+    return SIMBOLO_NO_TERMINAL + indice;
+}
 
-    int cantidadEncontradas = 0;
+// Nombre del no terminal de la fila ("" para la fila inicial de una gramática normalizada).
+const char *nombreNoTerminal(const GramaticaCompilada *compilada, const int fila) {
+    return fila < compilada->cantidadNombres ? compilada->nombres + compilada->inicioNombre[fila] : "";
+}
 
-    for (int i = 0; i < gramatica->cantidadProducciones; i++) {
-        if (gramatica->producciones[i].ladoIzquierdo == noTerminalActual) {
-            cantidadEncontradas++;
-        }
-    }
+typedef struct {
+    const char *nombre;
+    int fila;
+} NombreOrdenado;
 
-    Produccion* produccionesNoTerminal = malloc(cantidadEncontradas * sizeof(Produccion));
-    if (produccionesNoTerminal == NULL) {
-        memprinterr();
-        return NULL;
-    }
+static int compararNombresOrdenados(const void *a, const void *b) {
+    return strcmp(((const NombreOrdenado *)a)->nombre, ((const NombreOrdenado *)b)->nombre);
+}
 
-    int j = 0;
-    for (int i = 0; i < gramatica->cantidadProducciones; i++) {
-        if (gramatica->producciones[i].ladoIzquierdo == noTerminalActual) {
-            produccionesNoTerminal[j++] = gramatica->producciones[i];
-        }
+// Deja en "filas" las filas de los no terminales declarados ordenadas por nombre, un orden que no depende de la declaración.
+static bool ordenarFilasPorNombre(const GramaticaCompilada *compilada, int *filas) {
+    const int n = compilada->cantidadNombres;
+    NombreOrdenado *nombres = tmalloc((n + 1) * sizeof(NombreOrdenado), MEMORIA_COMPILACION);
+    if (nombres == NULL) {
+        return false;
     }
-
-    *cantidadProduccionesEncontradas = cantidadEncontradas;
-    return produccionesNoTerminal;
+    for (int fila = 0; fila < n; fila++) {
+        nombres[fila].nombre = nombreNoTerminal(compilada, fila);
+        nombres[fila].fila = fila;
+    }
+    qsort(nombres, n, sizeof(NombreOrdenado), compararNombresOrdenados);
+    for (int i = 0; i < n; i++) {
+        filas[i] = nombres[i].fila;
+    }
+    tfree(nombres);
+    return true;
 }
 
-char* aplicarDerivacion(const char* cadena, char noTerminal, const char* reemplazo) {
-    size_t lenCadena = strlen(cadena);
-    size_t lenReemplazo = strlen(reemplazo);
-
-    char* nuevaCadena = malloc(lenCadena + lenReemplazo + 1);
-
-    bool reemplazoHecho = false;
-    int pos = 0;
-
-    for (int i = 0; cadena[i] != '\0'; i++) {
-        if (!reemplazoHecho && cadena[i] == noTerminal) {
-            strcpy(&nuevaCadena[pos], reemplazo);
-            pos += lenReemplazo;
-            reemplazoHecho = true;
-        } else {
-            nuevaCadena[pos++] = cadena[i];
-        }
+Transicion obtenerTransicion(const Produccion *produccion, const Gramatica *gramatica) {
+    Transicion transicion;
+    const Simbolo *ladoDerecho = produccion->ladoDerecho;
+    if (produccion->longitudLadoDerecho == 1) {
+        transicion.terminal = (char)ladoDerecho[0];
+        transicion.siguiente = SIN_NO_TERMINAL;
+    } else if (esLinealADerecha(ladoDerecho,gramatica)) {
+        transicion.terminal = (char)ladoDerecho[0];
+        transicion.siguiente = indiceNoTerminal(ladoDerecho[1]);
+    } else {
+        transicion.terminal = (char)ladoDerecho[1];
+        transicion.siguiente = indiceNoTerminal(ladoDerecho[0]);
     }
-
-    nuevaCadena[pos] = '\0';
-    return nuevaCadena;
+    return transicion;
 }
 
-char* generarPalabraAleatoria(const Gramatica* gramatica) {
-
-    srand(time(NULL));
-
-    char* cadenaDerivacion = malloc(2*sizeof(char));
-    if (cadenaDerivacion == NULL) {
-        memprinterr();
-        return;
+void destruirGramaticaCompilada(GramaticaCompilada *compilada) {
+    if (compilada != NULL) {
+        tfree(compilada->inicioFila);
+        tfree(compilada->producciones);
+        tfree(compilada->transiciones);
+        tfree(compilada->probabilidadAlias);
+        tfree(compilada->alias);
+        tfree(compilada->nombres);
+        tfree(compilada->inicioNombre);
+        tfree(compilada->usados);
+        tfree(compilada);
     }
+}
 
-    cadenaDerivacion[0] = gramatica->axioma;
-    cadenaDerivacion[1] = '\0';
-
-    printf("\nDerivacion: %s", cadenaDerivacion);
-
-    char noTerminalActual;
-
-    while ((noTerminalActual = buscarNoTerminal(cadenaDerivacion,gramatica->simbolosNoTerminales))) {
-        int cantidadProducciones;
-        Produccion* produccionesDeNoTerminal = obtenerProduccionesDeNoTerminal(gramatica,noTerminalActual,&cantidadProducciones);
-
-        const int indiceAleatorio = rand() % cantidadProducciones;
-        const Produccion produccionElegida = produccionesDeNoTerminal[indiceAleatorio];
-
-        char* nuevaCadena = aplicarDerivacion(cadenaDerivacion, noTerminalActual, produccionElegida.ladoDerecho);
-        free(cadenaDerivacion);
-        cadenaDerivacion = nuevaCadena;
-
-        printf(" -> %s", cadenaDerivacion);
-
-        free(produccionesDeNoTerminal);
+// Copia los nombres de los no terminales declarados, para mostrarlos sin depender de la gramática.
+static bool copiarNombresNoTerminales(GramaticaCompilada *compilada, const TablaNoTerminales *noTerminales) {
+    const int cantidad = noTerminales->cantidadDeclarados;
+    const size_t longitud = cantidad < noTerminales->cantidad ? (size_t)noTerminales->inicioNombre[cantidad] : noTerminales->nombres.longitud;
+    compilada->nombres = tmalloc(longitud, MEMORIA_COMPILACION);
+    compilada->inicioNombre = tmalloc(cantidad * sizeof(int), MEMORIA_COMPILACION);
+    if (compilada->nombres == NULL || compilada->inicioNombre == NULL) {
+        return false;
     }
+    memcpy(compilada->nombres, noTerminales->nombres.datos, longitud);
+    memcpy(compilada->inicioNombre, noTerminales->inicioNombre, cantidad * sizeof(int));
+    compilada->cantidadNombres = cantidad;
+    compilada->longitudNombres = longitud;
+    return true;
+}
 
-    printf("\n\n");
-    free(cadenaDerivacion);
+/*
+        Análisis de símbolos útiles: un no terminal es productivo si deriva
+        alguna cadena de terminales y alcanzable si aparece en alguna forma
+        sentencial que parte del axioma. Ambos conjuntos se calculan en tiempo
+        lineal con una lista de pendientes: un no terminal se vuelve productivo
+        cuando tiene una producción terminal o una que lleva a uno productivo
+        (para encontrarlas, las producciones se agrupan por el no terminal de
+        su lado derecho), y los alcanzables se recorren desde el axioma por las
+        producciones agrupadas por su lado izquierdo. En la tabla compilada
+        solo quedan las producciones útiles: las de no terminales alcanzables
+        cuyo lado derecho no lleva a un no terminal improductivo. Así toda fila
+        alcanzable tiene al menos una producción y desde cualquier fila se
+        puede terminar, por lo que la derivación termina con probabilidad 1 y
+        su longitud esperada es finita. Si el axioma es improductivo el
+        lenguaje es vacío: la tabla queda sin producciones y el generador se
+        niega a derivar (el reconocedor sigue funcionando y rechaza todo).
+ */
 
-    return NULL;
+// Agrupa las producciones por fila: las de la fila f quedan en lista[inicio[f] .. inicio[f + 1]). Se omiten las SIN_NO_TERMINAL.
+static void agruparPorFila(const int *filaDeProduccion, const int cantidadProducciones, const int cantidadFilas, int *inicio, int *lista) {
+    memset(inicio, 0, (cantidadFilas + 1) * sizeof(int));
+    for (int i = 0; i < cantidadProducciones; i++) {
+        if (filaDeProduccion[i] != SIN_NO_TERMINAL) {
+            inicio[filaDeProduccion[i]]++;
+        }
+    }
+    for (int fila = 0; fila < cantidadFilas; fila++) {
+        inicio[fila + 1] += inicio[fila];
+    }
+    // Se ubican de atrás hacia adelante, así inicio[f] termina apuntando al principio de la fila f.
+    for (int i = cantidadProducciones; i-- > 0;) {
+        if (filaDeProduccion[i] != SIN_NO_TERMINAL) {
+            lista[--inicio[filaDeProduccion[i]]] = i;
+        }
+    }
 }
 
-int main(void) {
+static bool analizarSimbolosUtiles(GramaticaCompilada *compilada, const int cantidadProducciones) {
+    const int n = compilada->cantidadNoTerminales;
+    int *filas = tmalloc((cantidadProducciones + 1) * sizeof(int), MEMORIA_COMPILACION);
+    int *inicio = tmalloc((n + 1) * sizeof(int), MEMORIA_COMPILACION);
+    int *lista = tmalloc((cantidadProducciones + 1) * sizeof(int), MEMORIA_COMPILACION);
+    int *pendientes = tmalloc(n * sizeof(int), MEMORIA_COMPILACION);
+    if (filas == NULL || inicio == NULL || lista == NULL || pendientes == NULL) {
+        tfree(filas);
+        tfree(inicio);
+        tfree(lista);
+        tfree(pendientes);
+        return false;
+    }
+    const Produccion *producciones = compilada->producciones;
+    const Transicion *transiciones = compilada->transiciones;
+    // Productivos: se propagan hacia atrás, desde las producciones terminales.
+    int cantidadPendientes = 0;
+    for (int i = 0; i < cantidadProducciones; i++) {
+        const int origen = indiceNoTerminal(producciones[i].ladoIzquierdo);
+        filas[i] = transiciones[i].siguiente;
+        if (transiciones[i].siguiente == SIN_NO_TERMINAL && !contieneElemento(compilada->productivos, origen)) {
+            agregarElemento(compilada->productivos, origen);
+            pendientes[cantidadPendientes++] = origen;
+        }
+    }
+    agruparPorFila(filas, cantidadProducciones, n, inicio, lista);
+    while (cantidadPendientes > 0) {
+        const int fila = pendientes[--cantidadPendientes];
+        for (int j = inicio[fila]; j < inicio[fila + 1]; j++) {
+            const int origen = indiceNoTerminal(producciones[lista[j]].ladoIzquierdo);
+            if (!contieneElemento(compilada->productivos, origen)) {
+                agregarElemento(compilada->productivos, origen);
+                pendientes[cantidadPendientes++] = origen;
+            }
+        }
+    }
+    // Alcanzables: se recorren desde el axioma, sin pasar por los improductivos.
+    for (int i = 0; i < cantidadProducciones; i++) {
+        filas[i] = indiceNoTerminal(producciones[i].ladoIzquierdo);
+    }
+    agruparPorFila(filas, cantidadProducciones, n, inicio, lista);
+    if (contieneElemento(compilada->productivos, compilada->axioma)) {
+        agregarElemento(compilada->alcanzables, compilada->axioma);
+        pendientes[cantidadPendientes++] = compilada->axioma;
+    }
+    while (cantidadPendientes > 0) {
+        const int fila = pendientes[--cantidadPendientes];
+        for (int j = inicio[fila]; j < inicio[fila + 1]; j++) {
+            const int siguiente = transiciones[lista[j]].siguiente;
+            if (siguiente != SIN_NO_TERMINAL && contieneElemento(compilada->productivos, siguiente) &&
+                !contieneElemento(compilada->alcanzables, siguiente)) {
+                agregarElemento(compilada->alcanzables, siguiente);
+                pendientes[cantidadPendientes++] = siguiente;
+            }
+        }
+    }
+    tfree(filas);
+    tfree(inicio);
+    tfree(lista);
+    tfree(pendientes);
+    return true;
+}
+
+static bool esProduccionUtil(const Produccion *produccion, const Transicion *transicion, const GramaticaCompilada *compilada) {
+    const int siguiente = transicion->siguiente;
+    return contieneElemento(compilada->alcanzables, indiceNoTerminal(produccion->ladoIzquierdo)) &&
+           (siguiente == SIN_NO_TERMINAL || contieneElemento(compilada->productivos, siguiente));
+}
+
+// Muestra los no terminales usados que no están en "excluidos" y sí en "incluidos" (si no es NULL). Devuelve cuántos son.
+static int mostrarNoTerminales(const GramaticaCompilada *compilada, const uint64_t *incluidos, const uint64_t *excluidos, FILE *salida) {
+    int cantidad = 0;
+    for (int fila = 0; fila < compilada->cantidadNombres; fila++) {
+        if (contieneElemento(compilada->usados, fila) && !contieneElemento(excluidos, fila) &&
+            (incluidos == NULL || contieneElemento(incluidos, fila))) {
+            if (salida != NULL) {
+                fputs(nombreNoTerminal(compilada, fila), salida);
+            }
+            cantidad++;
+        }
+    }
+    return cantidad;
+}
+
+bool esLenguajeVacio(const GramaticaCompilada *compilada) {
+    return !contieneElemento(compilada->productivos, compilada->axioma);
+}
+
+// Informa por "salida" las producciones que se descartaron al compilar y por qué (si no se descartó ninguna, no muestra nada).
+void mostrarAnalisisGramatica(const GramaticaCompilada *compilada, FILE *salida) {
+    if (compilada->produccionesDescartadas == 0) {
+        return;
+    }
+    fprintf(salida, "Aviso: se descartaron %d producciones inutiles.", compilada->produccionesDescartadas);
+    if (mostrarNoTerminales(compilada, NULL, compilada->productivos, NULL) > 0) {
+        fprintf(salida, " Improductivos: ");
+        mostrarNoTerminales(compilada, NULL, compilada->productivos, salida);
+        fprintf(salida, ".");
+    }
+    if (mostrarNoTerminales(compilada, compilada->productivos, compilada->alcanzables, NULL) > 0) {
+        fprintf(salida, " Inalcanzables: ");
+        mostrarNoTerminales(compilada, compilada->productivos, compilada->alcanzables, salida);
+        fprintf(salida, ".");
+    }
+    fprintf(salida, "\n");
+}
+
+/*
+        Producciones con peso: para cada fila se arma una tabla de alias
+        (método de Vose). Cada producción i de la fila guarda una probabilidad
+        p[i] y un alias a[i]; para elegir se sortea i uniformemente y se
+        devuelve i con probabilidad p[i] o a[i] en otro caso. Así cada paso de
+        la derivación es O(1) sin importar la cantidad de alternativas.
+ */
+static bool construirTablasAlias(GramaticaCompilada *compilada) {
+    const int cantidadProducciones = compilada->cantidadProducciones;
+    // Las gramáticas normalizadas siempre llevan pesos (los de la derivación invertida).
+    if (!compilada->esPonderada && !compilada->esLinealAIzquierda) {
+        return true;
+    }
+    compilada->probabilidadAlias = tmalloc((cantidadProducciones + 1) * sizeof(double), MEMORIA_COMPILACION);
+    compilada->alias = tmalloc((cantidadProducciones + 1) * sizeof(int), MEMORIA_COMPILACION);
+    // Las producciones con probabilidad menor a 1 se apilan desde el principio y las demás desde el final.
+    int *pendientes = tmalloc((cantidadProducciones + 1) * sizeof(int), MEMORIA_COMPILACION);
+    if (compilada->probabilidadAlias == NULL || compilada->alias == NULL || pendientes == NULL) {
+        tfree(pendientes);
+        return false;
+    }
+    double *probabilidad = compilada->probabilidadAlias;
+    int *alias = compilada->alias;
+    for (int fila = 0; fila < compilada->cantidadNoTerminales; fila++) {
+        const int inicio = compilada->inicioFila[fila];
+        const int cantidad = compilada->inicioFila[fila + 1] - inicio;
+        double pesoTotal = 0;
+        for (int i = inicio; i < inicio + cantidad; i++) {
+            pesoTotal += compilada->producciones[i].peso;
+        }
+        int cantidadChicas = 0, inicioGrandes = cantidad;
+        for (int i = inicio; i < inicio + cantidad; i++) {
+            probabilidad[i] = compilada->producciones[i].peso * cantidad / pesoTotal;
+            alias[i] = i;
+            if (probabilidad[i] < 1.0) {
+                pendientes[cantidadChicas++] = i;
+            } else {
+                pendientes[--inicioGrandes] = i;
+            }
+        }
+        while (cantidadChicas > 0 && inicioGrandes < cantidad) {
+            const int chica = pendientes[--cantidadChicas];
+            const int grande = pendientes[inicioGrandes++];
+            alias[chica] = grande;
+            probabilidad[grande] += probabilidad[chica] - 1.0;
+            if (probabilidad[grande] < 1.0) {
+                pendientes[cantidadChicas++] = grande;
+            } else {
+                pendientes[--inicioGrandes] = grande;
+            }
+        }
+        // Lo que queda pendiente tiene probabilidad 1 salvo por errores de redondeo.
+        while (cantidadChicas > 0) {
+            probabilidad[pendientes[--cantidadChicas]] = 1.0;
+        }
+        while (inicioGrandes < cantidad) {
+            probabilidad[pendientes[inicioGrandes++]] = 1.0;
+        }
+    }
+    tfree(pendientes);
+    return true;
+}
+
+/*
+        Sistemas x = b + M x, con un término de M por producción que pasa de
+        una fila a otra (la longitud esperada y las visitas de la
+        normalización). Como las producciones inútiles ya se descartaron, toda
+        derivación termina con probabilidad 1 y el sistema tiene solución
+        única. Con pocas incógnitas se resuelve por eliminación gaussiana. Con
+        muchas, la matriz densa sería cuadrática en memoria y cúbica en
+        tiempo, así que se itera Gauss-Seidel sobre los términos (lineal por
+        iteración), despejando los lazos X->aX en cada paso, hasta que ningún
+        valor cambie más que TOLERANCIA_SISTEMA o se llegue a
+        MAX_ITERACIONES_SISTEMA.
+ */
+
+#define MAX_INCOGNITAS_DENSAS 512
+#define MAX_ITERACIONES_SISTEMA 100000
+#define TOLERANCIA_SISTEMA 1e-13
+
+// El término "coeficiente * x[columna]" de la ecuación de x[fila].
+typedef struct {
+    int fila;
+    int columna;
+    double coeficiente;
+} TerminoSistema;
+
+static double valorAbsoluto(const double valor) {
+    return valor < 0 ? -valor : valor;
+}
+
+static bool resolverSistemaDenso(const TerminoSistema *terminos, const int cantidadTerminos, double *x, const int n) {
+    const size_t ancho = (size_t)n + 1;
+    double *sistema = tcalloc((size_t)n * ancho, sizeof(double), MEMORIA_COMPILACION);
+    if (sistema == NULL) {
+        return false;
+    }
+    for (int fila = 0; fila < n; fila++) {
+        sistema[fila * ancho + fila] = 1.0;
+        sistema[fila * ancho + n] = x[fila];
+    }
+    for (int i = 0; i < cantidadTerminos; i++) {
+        sistema[terminos[i].fila * ancho + terminos[i].columna] -= terminos[i].coeficiente;
+    }
+    for (int columna = 0; columna < n; columna++) {
+        int pivote = columna;
+        for (int fila = columna + 1; fila < n; fila++) {
+            if (valorAbsoluto(sistema[fila * ancho + columna]) > valorAbsoluto(sistema[pivote * ancho + columna])) {
+                pivote = fila;
+            }
+        }
+        double *filaPivote = sistema + columna * ancho;
+        if (pivote != columna) {
+            double *otra = sistema + pivote * ancho;
+            for (int k = 0; k <= n; k++) {
+                const double auxiliar = filaPivote[k];
+                filaPivote[k] = otra[k];
+                otra[k] = auxiliar;
+            }
+        }
+        for (int fila = 0; fila < n; fila++) {
+            double *actual = sistema + fila * ancho;
+            if (fila != columna && actual[columna] != 0) {
+                const double factor = actual[columna] / filaPivote[columna];
+                for (int k = columna; k <= n; k++) {
+                    actual[k] -= factor * filaPivote[k];
+                }
+            }
+        }
+    }
+    for (int fila = 0; fila < n; fila++) {
+        x[fila] = sistema[fila * ancho + n] / sistema[fila * ancho + fila];
+    }
+    tfree(sistema);
+    return true;
+}
+
+static bool resolverSistemaIterativo(const TerminoSistema *terminos, const int cantidadTerminos, double *x, const int n) {
+    double *independiente = tmalloc(n * sizeof(double), MEMORIA_COMPILACION);
+    double *lazo = tcalloc(n, sizeof(double), MEMORIA_COMPILACION);
+    int *filas = tmalloc((cantidadTerminos + 1) * sizeof(int), MEMORIA_COMPILACION);
+    int *inicio = tmalloc((n + 1) * sizeof(int), MEMORIA_COMPILACION);
+    int *lista = tmalloc((cantidadTerminos + 1) * sizeof(int), MEMORIA_COMPILACION);
+    const bool hayMemoria = independiente != NULL && lazo != NULL && filas != NULL && inicio != NULL && lista != NULL;
+    if (hayMemoria) {
+        memcpy(independiente, x, n * sizeof(double));
+        for (int i = 0; i < cantidadTerminos; i++) {
+            if (terminos[i].fila == terminos[i].columna) {
+                lazo[terminos[i].fila] += terminos[i].coeficiente;
+                filas[i] = SIN_NO_TERMINAL;
+            } else {
+                filas[i] = terminos[i].fila;
+            }
+        }
+        agruparPorFila(filas, cantidadTerminos, n, inicio, lista);
+        double cambioMaximo = 1;
+        for (int iteracion = 0; iteracion < MAX_ITERACIONES_SISTEMA && cambioMaximo > TOLERANCIA_SISTEMA; iteracion++) {
+            cambioMaximo = 0;
+            for (int fila = 0; fila < n; fila++) {
+                double valor = independiente[fila];
+                for (int j = inicio[fila]; j < inicio[fila + 1]; j++) {
+                    valor += terminos[lista[j]].coeficiente * x[terminos[lista[j]].columna];
+                }
+                valor /= 1.0 - lazo[fila];
+                const double cambio = valorAbsoluto(valor - x[fila]) / (valorAbsoluto(valor) > 1 ? valorAbsoluto(valor) : 1);
+                cambioMaximo = cambio > cambioMaximo ? cambio : cambioMaximo;
+                x[fila] = valor;
+            }
+        }
+    }
+    tfree(independiente);
+    tfree(lazo);
+    tfree(filas);
+    tfree(inicio);
+    tfree(lista);
+    return hayMemoria;
+}
+
+// Resuelve x = b + M x, donde "x" trae b y termina con la solución. Devuelve false si no hay memoria.
+static bool resolverSistemaLineal(const TerminoSistema *terminos, const int cantidadTerminos, double *x, const int n) {
+    if (n <= MAX_INCOGNITAS_DENSAS) {
+        return resolverSistemaDenso(terminos, cantidadTerminos, x, n);
+    }
+    return resolverSistemaIterativo(terminos, cantidadTerminos, x, n);
+}
+
+/*
+        Longitud esperada E[X] de la palabra derivada desde cada no terminal
+        alcanzable X, con P(p) = peso(p) / (suma de pesos de la fila de X):
+            E[X] = suma sobre p de X de P(p) * (emite(p) + E[siguiente(p)])
+        Solo se calcula cuando se muestra (-n con pesos o --estadisticas). Es
+        un dato informativo, así que siempre se itera hasta la tolerancia en
+        lugar de resolver el sistema exacto. Devuelve false si no hay memoria.
+ */
+bool calcularLongitudEsperada(const GramaticaCompilada *compilada, double *longitudEsperada) {
+    *longitudEsperada = 0;
+    if (esLenguajeVacio(compilada)) {
+        return true;
+    }
+    const int n = compilada->cantidadNoTerminales;
+    double *longitud = tcalloc(n, sizeof(double), MEMORIA_COMPILACION);
+    TerminoSistema *terminos = tmalloc((compilada->cantidadProducciones + 1) * sizeof(TerminoSistema), MEMORIA_COMPILACION);
+    if (longitud == NULL || terminos == NULL) {
+        tfree(longitud);
+        tfree(terminos);
+        return false;
+    }
+    int cantidadTerminos = 0;
+    for (int fila = 0; fila < n; fila++) {
+        const int inicio = compilada->inicioFila[fila];
+        const int fin = compilada->inicioFila[fila + 1];
+        double pesoTotal = 0;
+        for (int i = inicio; i < fin; i++) {
+            pesoTotal += compilada->producciones[i].peso;
+        }
+        for (int i = inicio; i < fin; i++) {
+            const double probabilidad = compilada->producciones[i].peso / pesoTotal;
+            const Transicion transicion = compilada->transiciones[i];
+            if (transicion.terminal != EPSILON) {
+                longitud[fila] += probabilidad;
+            }
+            if (transicion.siguiente != SIN_NO_TERMINAL) {
+                terminos[cantidadTerminos++] = (TerminoSistema){fila, transicion.siguiente, probabilidad};
+            }
+        }
+    }
+    const bool exito = resolverSistemaIterativo(terminos, cantidadTerminos, longitud, n);
+    if (exito) {
+        *longitudEsperada = longitud[compilada->axioma];
+    }
+    tfree(longitud);
+    tfree(terminos);
+    return exito;
+}
+
+/*
+        Normalización de las gramáticas lineales a izquierda. En S -> Aa -> Bba
+        la palabra crece hacia la izquierda, así que la derivación se invierte
+        en el tiempo: cada no terminal X pasa a significar "ya se emitió lo que
+        deriva X" y, con una fila inicial nueva Z,
+            - B->Xa se convierte en X->aB,
+            - X->a se convierte en Z->aX,
+            - X->@ se combina con la fila invertida de X: Z->aB por cada B->Xa
+              (y Z->@ si X es el axioma),
+            - el axioma S recibe S->@, que es donde empezaba la derivación.
+        Para que cada palabra salga con la misma probabilidad que antes, los
+        pesos son los de la derivación invertida: si v(X) es la cantidad
+        esperada de veces que la derivación original pasa por X, la inversa de
+        B->Xa pesa v(B) * P(B->Xa) y la de X->a pesa v(X) * P(X->a), donde
+            v(X) = [X == S] + suma sobre B->Xa de v(B) * P(B->Xa)
+        En la fila Z cada producción conserva la producción original con la que
+        terminaba la derivación, para poder mostrarla.
+ */
+static void ubicarProduccion(Produccion *producciones, Transicion *transiciones, int *posicionFila, const int fila,
+                             const Produccion *produccion, const Transicion transicion, const double peso) {
+    const int posicion = posicionFila[fila]++;
+    producciones[posicion] = *produccion;
+    producciones[posicion].peso = peso;
+    transiciones[posicion] = transicion;
+}
+
+static bool normalizarLinealAIzquierda(GramaticaCompilada *compilada) {
+    const int n = compilada->cantidadNoTerminales;
+    const int filaInicial = n;
+    const int axioma = compilada->axioma;
+    double *probabilidad = tmalloc((compilada->cantidadProducciones + 1) * sizeof(double), MEMORIA_COMPILACION);
+    double *visitas = tcalloc(n, sizeof(double), MEMORIA_COMPILACION);
+    TerminoSistema *terminos = tmalloc((compilada->cantidadProducciones + 1) * sizeof(TerminoSistema), MEMORIA_COMPILACION);
+    int *inicioFila = tcalloc(n + 2, sizeof(int), MEMORIA_COMPILACION);
+    int *posicionFila = tmalloc((n + 1) * sizeof(int), MEMORIA_COMPILACION);
+    int *filas = tmalloc((n + 1) * sizeof(int), MEMORIA_COMPILACION);
+    Produccion *producciones = NULL;
+    Transicion *transiciones = NULL;
+    bool exito = probabilidad != NULL && visitas != NULL && terminos != NULL && inicioFila != NULL && posicionFila != NULL &&
+                 filas != NULL && ordenarFilasPorNombre(compilada, filas);
+    if (exito) {
+        visitas[axioma] = 1.0;
+        inicioFila[axioma + 1]++;
+        int cantidadTerminos = 0;
+        // Las filas se recorren por nombre para que las filas invertidas no dependan del orden de la declaración.
+        for (int k = 0; k < n; k++) {
+            const int fila = filas[k];
+            const int inicio = compilada->inicioFila[fila];
+            const int fin = compilada->inicioFila[fila + 1];
+            double pesoTotal = 0;
+            for (int i = inicio; i < fin; i++) {
+                pesoTotal += compilada->producciones[i].peso;
+            }
+            for (int i = inicio; i < fin; i++) {
+                probabilidad[i] = compilada->producciones[i].peso / pesoTotal;
+                const Transicion transicion = compilada->transiciones[i];
+                if (transicion.siguiente != SIN_NO_TERMINAL) {
+                    terminos[cantidadTerminos++] = (TerminoSistema){transicion.siguiente, fila, probabilidad[i]};
+                    inicioFila[transicion.siguiente + 1]++;
+                } else if (transicion.terminal != EPSILON) {
+                    inicioFila[filaInicial + 1]++;
+                }
+            }
+        }
+        // Cada X->@ copia en Z la fila invertida de X, que ya está contada.
+        for (int fila = 0; fila < n; fila++) {
+            for (int i = compilada->inicioFila[fila]; i < compilada->inicioFila[fila + 1]; i++) {
+                if (compilada->transiciones[i].siguiente == SIN_NO_TERMINAL && compilada->transiciones[i].terminal == EPSILON) {
+                    inicioFila[filaInicial + 1] += inicioFila[fila + 1];
+                }
+            }
+        }
+        for (int fila = 0; fila <= filaInicial; fila++) {
+            inicioFila[fila + 1] += inicioFila[fila];
+        }
+        const int cantidadProducciones = inicioFila[filaInicial + 1];
+        producciones = tmalloc((cantidadProducciones + 1) * sizeof(Produccion), MEMORIA_COMPILACION);
+        transiciones = tmalloc((cantidadProducciones + 1) * sizeof(Transicion), MEMORIA_COMPILACION);
+        exito = producciones != NULL && transiciones != NULL && resolverSistemaLineal(terminos, cantidadTerminos, visitas, n);
+        compilada->cantidadProducciones = exito ? cantidadProducciones : compilada->cantidadProducciones;
+    }
+    if (exito) {
+        memcpy(posicionFila, inicioFila, (n + 1) * sizeof(int));
+        const Produccion produccionFinal = {simboloNoTerminal(axioma), {EPSILON}, 1, PESO_POR_DEFECTO};
+        ubicarProduccion(producciones, transiciones, posicionFila, axioma, &produccionFinal, (Transicion){EPSILON, SIN_NO_TERMINAL}, 1.0);
+        for (int k = 0; k < n; k++) {
+            const int fila = filas[k];
+            for (int i = compilada->inicioFila[fila]; i < compilada->inicioFila[fila + 1]; i++) {
+                const Transicion transicion = compilada->transiciones[i];
+                if (transicion.siguiente != SIN_NO_TERMINAL) {
+                    const Produccion invertida = {simboloNoTerminal(transicion.siguiente),
+                                                  {(unsigned char)transicion.terminal, simboloNoTerminal(fila)}, 2, PESO_POR_DEFECTO};
+                    ubicarProduccion(producciones, transiciones, posicionFila, transicion.siguiente, &invertida,
+                                     (Transicion){transicion.terminal, fila}, visitas[fila] * probabilidad[i]);
+                } else if (transicion.terminal != EPSILON) {
+                    ubicarProduccion(producciones, transiciones, posicionFila, filaInicial, &compilada->producciones[i],
+                                     (Transicion){transicion.terminal, fila}, visitas[fila] * probabilidad[i]);
+                }
+            }
+        }
+        for (int k = 0; k < n; k++) {
+            const int fila = filas[k];
+            for (int i = compilada->inicioFila[fila]; i < compilada->inicioFila[fila + 1]; i++) {
+                if (compilada->transiciones[i].siguiente != SIN_NO_TERMINAL || compilada->transiciones[i].terminal != EPSILON) {
+                    continue;
+                }
+                for (int j = inicioFila[fila]; j < inicioFila[fila + 1]; j++) {
+                    ubicarProduccion(producciones, transiciones, posicionFila, filaInicial, &compilada->producciones[i],
+                                     transiciones[j], probabilidad[i] * producciones[j].peso);
+                }
+            }
+        }
+        tfree(compilada->producciones);
+        tfree(compilada->transiciones);
+        tfree(compilada->inicioFila);
+        compilada->producciones = producciones;
+        compilada->transiciones = transiciones;
+        compilada->inicioFila = inicioFila;
+        compilada->cantidadNoTerminales = n + 1;
+        compilada->axioma = filaInicial;
+        agregarElemento(compilada->productivos, filaInicial);
+        agregarElemento(compilada->alcanzables, filaInicial);
+    } else {
+        tfree(producciones);
+        tfree(transiciones);
+        tfree(inicioFila);
+    }
+    tfree(probabilidad);
+    tfree(visitas);
+    tfree(terminos);
+    tfree(posicionFila);
+    tfree(filas);
+    return exito;
+}
+
+// Clave de una producción útil para ordenarlas: su fila, los símbolos del lado derecho y su peso.
+typedef struct {
+    int32_t clave[LADO_DERECHO_MAX + 1];
+    double peso;
+    int indice;
+} ClaveProduccion;
+
+static int compararClavesProduccion(const void *a, const void *b) {
+    const ClaveProduccion *primera = a, *segunda = b;
+    for (int i = 0; i <= LADO_DERECHO_MAX; i++) {
+        if (primera->clave[i] != segunda->clave[i]) {
+            return primera->clave[i] < segunda->clave[i] ? -1 : 1;
+        }
+    }
+    if (primera->peso != segunda->peso) {
+        return primera->peso < segunda->peso ? -1 : 1;
+    }
+    return (primera->indice > segunda->indice) - (primera->indice < segunda->indice);
+}
+
+/*
+        Deja en "orden" los índices de las producciones útiles, agrupadas por
+        fila y dentro de cada fila ordenadas por el lado derecho (un lado
+        derecho más corto va antes; los terminales se comparan por su byte y
+        van antes que los no terminales, que se comparan por nombre) y por
+        último por el peso. Así el orden solo depende de la gramática y no de
+        cómo se escribió; las producciones que empatan son idénticas.
+ */
+static bool ordenarProduccionesCanonicas(const GramaticaCompilada *compilada, const int cantidadProducciones, int *orden) {
+    const int n = compilada->cantidadNombres;
+    ClaveProduccion *claves = tmalloc((compilada->cantidadProducciones + 1) * sizeof(ClaveProduccion), MEMORIA_COMPILACION);
+    int *filas = tmalloc((n + 1) * sizeof(int), MEMORIA_COMPILACION);
+    int *rango = tmalloc((n + 1) * sizeof(int), MEMORIA_COMPILACION);
+    if (claves == NULL || filas == NULL || rango == NULL || !ordenarFilasPorNombre(compilada, filas)) {
+        tfree(claves);
+        tfree(filas);
+        tfree(rango);
+        return false;
+    }
+    for (int i = 0; i < n; i++) {
+        rango[filas[i]] = i;
+    }
+    int cantidad = 0;
+    for (int i = 0; i < cantidadProducciones; i++) {
+        const Produccion *produccion = &compilada->producciones[i];
+        if (!esProduccionUtil(produccion, &compilada->transiciones[i], compilada)) {
+            continue;
+        }
+        ClaveProduccion *clave = &claves[cantidad++];
+        clave->clave[0] = indiceNoTerminal(produccion->ladoIzquierdo);
+        for (int j = 0; j < LADO_DERECHO_MAX; j++) {
+            const Simbolo simbolo = j < produccion->longitudLadoDerecho ? produccion->ladoDerecho[j] : -1;
+            clave->clave[j + 1] = simbolo >= SIMBOLO_NO_TERMINAL ? simboloNoTerminal(rango[indiceNoTerminal(simbolo)]) : simbolo;
+        }
+        clave->peso = produccion->peso;
+        clave->indice = i;
+    }
+    qsort(claves, cantidad, sizeof(ClaveProduccion), compararClavesProduccion);
+    for (int i = 0; i < cantidad; i++) {
+        orden[i] = claves[i].indice;
+    }
+    tfree(claves);
+    tfree(filas);
+    tfree(rango);
+    return true;
+}
+
+GramaticaCompilada *compilarGramatica(const Gramatica *gramatica) {
+    GramaticaCompilada *compilada = tcalloc(1, sizeof(GramaticaCompilada), MEMORIA_COMPILACION);
+    if (compilada == NULL) {
+        memprinterr();
+        return NULL;
+    }
+    const int cantidadProducciones = gramatica->cantidadProducciones;
+    const int n = gramatica->noTerminales.cantidadDeclarados;
+    compilada->cantidadNoTerminales = n;
+    compilada->axioma = indiceNoTerminal(gramatica->axioma);
+    // La fila extra (y el bit extra de los conjuntos) es para la fila inicial de la normalización.
+    compilada->inicioFila = tcalloc(n + 1, sizeof(int), MEMORIA_COMPILACION);
+    compilada->producciones = tmalloc((cantidadProducciones + 1) * sizeof(Produccion), MEMORIA_COMPILACION);
+    compilada->transiciones = tmalloc((cantidadProducciones + 1) * sizeof(Transicion), MEMORIA_COMPILACION);
+    compilada->palabrasPorConjunto = palabrasConjunto(n + 1);
+    compilada->usados = tcalloc(3 * (size_t)compilada->palabrasPorConjunto, sizeof(uint64_t), MEMORIA_COMPILACION);
+    if (compilada->inicioFila == NULL || compilada->producciones == NULL || compilada->transiciones == NULL ||
+        compilada->usados == NULL || !copiarNombresNoTerminales(compilada, &gramatica->noTerminales)) {
+        memprinterr();
+        destruirGramaticaCompilada(compilada);
+        return NULL;
+    }
+    compilada->productivos = compilada->usados + compilada->palabrasPorConjunto;
+    compilada->alcanzables = compilada->productivos + compilada->palabrasPorConjunto;
+    // Primero se traducen todas las producciones (en el orden ingresado) para poder analizarlas.
+    for (int i = 0; i < cantidadProducciones; i++) {
+        const Produccion *produccion = &gramatica->producciones[i];
+        const Transicion transicion = obtenerTransicion(produccion, gramatica);
+        compilada->producciones[i] = *produccion;
+        compilada->transiciones[i] = transicion;
+        agregarElemento(compilada->usados, indiceNoTerminal(produccion->ladoIzquierdo));
+        if (transicion.siguiente != SIN_NO_TERMINAL) {
+            agregarElemento(compilada->usados, transicion.siguiente);
+        }
+        if (produccion->longitudLadoDerecho == 2 && esLinealAIzquierda(produccion->ladoDerecho, gramatica)) {
+            compilada->esLinealAIzquierda = true;
+        }
+        compilada->esPonderada |= produccion->peso != PESO_POR_DEFECTO;
+    }
+    if (!analizarSimbolosUtiles(compilada, cantidadProducciones)) {
+        memprinterr();
+        destruirGramaticaCompilada(compilada);
+        return NULL;
+    }
+    // Contamos las producciones útiles de cada fila y acumulamos para obtener el inicio de cada una.
+    for (int i = 0; i < cantidadProducciones; i++) {
+        if (esProduccionUtil(&compilada->producciones[i], &compilada->transiciones[i], compilada)) {
+            compilada->inicioFila[indiceNoTerminal(compilada->producciones[i].ladoIzquierdo) + 1]++;
+        }
+    }
+    for (int fila = 0; fila < n; fila++) {
+        compilada->inicioFila[fila + 1] += compilada->inicioFila[fila];
+    }
+    compilada->cantidadProducciones = compilada->inicioFila[n];
+    compilada->produccionesDescartadas = cantidadProducciones - compilada->cantidadProducciones;
+    // Ubicamos cada producción útil en su fila, en el orden canónico.
+    Produccion *producciones = tmalloc((compilada->cantidadProducciones + 1) * sizeof(Produccion), MEMORIA_COMPILACION);
+    Transicion *transiciones = tmalloc((compilada->cantidadProducciones + 1) * sizeof(Transicion), MEMORIA_COMPILACION);
+    int *orden = tmalloc((compilada->cantidadProducciones + 1) * sizeof(int), MEMORIA_COMPILACION);
+    if (producciones == NULL || transiciones == NULL || orden == NULL ||
+        !ordenarProduccionesCanonicas(compilada, cantidadProducciones, orden)) {
+        memprinterr();
+        tfree(producciones);
+        tfree(transiciones);
+        tfree(orden);
+        destruirGramaticaCompilada(compilada);
+        return NULL;
+    }
+    for (int posicion = 0; posicion < compilada->cantidadProducciones; posicion++) {
+        producciones[posicion] = compilada->producciones[orden[posicion]];
+        transiciones[posicion] = compilada->transiciones[orden[posicion]];
+    }
+    tfree(orden);
+    tfree(compilada->producciones);
+    tfree(compilada->transiciones);
+    compilada->producciones = producciones;
+    compilada->transiciones = transiciones;
+    if ((compilada->esLinealAIzquierda && !esLenguajeVacio(compilada) && !normalizarLinealAIzquierda(compilada)) ||
+        !construirTablasAlias(compilada)) {
+        memprinterr();
+        destruirGramaticaCompilada(compilada);
+        return NULL;
+    }
+    return compilada;
+}
+
+// --- Derivacion ---
+
+/*
+        La forma sentencial de una gramática regular tiene a lo sumo un no
+        terminal, ubicado en uno de sus extremos. Por eso la derivación se hace
+        en el lugar: solo se guardan los terminales emitidos, al final de un
+        buffer que se reutiliza entre palabras, y no se reserva memoria en cada
+        paso. Como las gramáticas lineales a izquierda se normalizan al
+        compilar, los terminales siempre se emiten de izquierda a derecha.
+ */
+
+#define SIN_PRODUCCION (-1)
+
+// Filas por las que pasa una derivación y la primera producción elegida, para poder mostrarla al terminar.
+typedef struct {
+    int *filas;
+    size_t cantidadFilas;
+    size_t capacidadFilas;
+    int produccionInicial;
+} Recorrido;
+
+static bool registrarPaso(Recorrido *recorrido, const int elegida, const int fila) {
+    if (recorrido->produccionInicial == SIN_PRODUCCION) {
+        recorrido->produccionInicial = elegida;
+    }
+    if (fila == SIN_NO_TERMINAL) {
+        return true;
+    }
+    if (recorrido->cantidadFilas == recorrido->capacidadFilas) {
+        const size_t nuevaCapacidad = recorrido->capacidadFilas > 0 ? recorrido->capacidadFilas * 2 : CAPACIDAD_INICIAL_BUFFER;
+        int *filas = trealloc(recorrido->filas, nuevaCapacidad * sizeof(int), MEMORIA_DERIVACION);
+        if (filas == NULL) {
+            memprinterr();
+            return false;
+        }
+        recorrido->filas = filas;
+        recorrido->capacidadFilas = nuevaCapacidad;
+    }
+    recorrido->filas[recorrido->cantidadFilas++] = fila;
+    return true;
+}
+
+// Sortea una producción de la fila (con la tabla de alias si la gramática tiene pesos) y devuelve su índice.
+static inline int elegirProduccion(const GramaticaCompilada *compilada, GeneradorAleatorio *generador, const int fila) {
+    const int inicioFila = compilada->inicioFila[fila];
+    const int cantidadProducciones = compilada->inicioFila[fila + 1] - inicioFila;
+    int elegida = inicioFila + aleatorioEnRango(generador, cantidadProducciones);
+    if (compilada->alias != NULL && aleatorioUnitario(generador) >= compilada->probabilidadAlias[elegida]) {
+        elegida = compilada->alias[elegida];
+    }
+    return elegida;
+}
+
+static bool derivar(const GramaticaCompilada *compilada, GeneradorAleatorio *generador, BufferPalabras *destino, Recorrido *recorrido) {
+    int filaActual = compilada->axioma;
+    if (esLenguajeVacio(compilada)) {
+        return false;
+    }
+
+    INSTRUMENTAR(uint64_t pasos = 0;)
+    while (filaActual != SIN_NO_TERMINAL) {
+        const int elegida = elegirProduccion(compilada, generador, filaActual);
+        const Transicion transicion = compilada->transiciones[elegida];
+        INSTRUMENTAR(registrarDisparo(elegida, compilada->cantidadProducciones); pasos++;)
+
+        if (transicion.terminal != EPSILON) {
+            if (destino->longitud == destino->capacidad && !reservarBufferPalabras(destino, destino->longitud + 1)) {
+                return false;
+            }
+            destino->datos[destino->longitud++] = transicion.terminal;
+        }
+        filaActual = transicion.siguiente;
+
+        if (recorrido != NULL && !registrarPaso(recorrido, elegida, filaActual)) {
+            return false;
+        }
+    }
+    INSTRUMENTAR(registrarDerivacion(pasos);)
+    return true;
+}
+
+/*
+        Cada paso que no termina la derivación emite exactamente un terminal,
+        así que luego del paso j quedan los j primeros terminales seguidos de
+        filas[j - 1]. En una gramática normalizada esa misma fila corresponde a
+        la forma sentencial "filas[j - 1] palabra[j..]" de la gramática
+        ingresada, por lo que se la recorre al revés. Si la derivación original
+        terminaba con X->@, entre la primera forma y la palabra se agrega "X palabra".
+ */
+static void mostrarRecorrido(const GramaticaCompilada *compilada, const Recorrido *recorrido, const char *palabra, const size_t longitud) {
+    const int *filas = recorrido->filas;
+    const size_t cantidadFilas = recorrido->cantidadFilas;
+    if (compilada->esLinealAIzquierda) {
+        const Produccion *inicial = &compilada->producciones[recorrido->produccionInicial];
+        const int filaInicial = indiceNoTerminal(inicial->ladoIzquierdo);
+        printf("\nDerivacion: %s", nombreNoTerminal(compilada, cantidadFilas > 0 ? filas[cantidadFilas - 1] : filaInicial));
+        for (size_t j = cantidadFilas; j-- > 1;) {
+            printf(" -> %s", nombreNoTerminal(compilada, filas[j - 1]));
+            fwrite(palabra + j, 1, longitud - j, stdout);
+        }
+        if (inicial->ladoDerecho[0] == EPSILON && longitud > 0) {
+            printf(" -> %s", nombreNoTerminal(compilada, filaInicial));
+            fwrite(palabra, 1, longitud, stdout);
+        }
+    } else {
+        printf("\nDerivacion: %s", nombreNoTerminal(compilada, compilada->axioma));
+        for (size_t j = 1; j <= cantidadFilas; j++) {
+            printf(" -> ");
+            fwrite(palabra, 1, j, stdout);
+            fputs(nombreNoTerminal(compilada, filas[j - 1]), stdout);
+        }
+    }
+    printf(" -> ");
+    if (longitud == 0) {
+        putchar(EPSILON);
+    } else {
+        fwrite(palabra, 1, longitud, stdout);
+    }
+    printf("\n\n");
+}
+
+// Deriva una palabra y agrega sus terminales al final de "destino" (sin separador).
+bool derivarPalabra(const GramaticaCompilada *compilada, GeneradorAleatorio *generador, BufferPalabras *destino) {
+    return derivar(compilada, generador, destino, NULL);
+}
+
+// Devuelve la palabra generada como C String (liberar con tfree).
+char* generarPalabraAleatoria(const GramaticaCompilada* compilada, GeneradorAleatorio* generador, const bool mostrarDerivacion) {
+    BufferPalabras buffer;
+    inicializarBufferPalabras(&buffer, MEMORIA_DERIVACION);
+    Recorrido recorrido = {NULL, 0, 0, SIN_PRODUCCION};
+    if (!derivar(compilada, generador, &buffer, mostrarDerivacion ? &recorrido : NULL) || !reservarBufferPalabras(&buffer, buffer.longitud + 1)) {
+        tfree(recorrido.filas);
+        liberarBufferPalabras(&buffer);
+        return NULL;
+    }
+    buffer.datos[buffer.longitud] = '\0';
+    if (mostrarDerivacion) {
+        mostrarRecorrido(compilada, &recorrido, buffer.datos, buffer.longitud);
+    }
+    tfree(recorrido.filas);
+    return buffer.datos;
+}
+
+// --- Generacion masiva ---
+
+// Genera "cantidadPalabras" palabras sin trazar la derivación y las agrega al final de "destino", separadas por '\n'.
+// Devuelve la cantidad de palabras que se pudieron generar.
+size_t generarPalabras(const GramaticaCompilada *compilada, GeneradorAleatorio *generador, const size_t cantidadPalabras, BufferPalabras *destino) {
+    for (size_t i = 0; i < cantidadPalabras; i++) {
+        if (!derivarPalabra(compilada, generador, destino) || !reservarBufferPalabras(destino, destino->longitud + 1)) {
+            return i;
+        }
+        destino->datos[destino->longitud++] = '\n';
+    }
+    return cantidadPalabras;
+}
+
+size_t generarPalabrasGramatica(const void *compilada, GeneradorAleatorio *generador, const size_t cantidadPalabras, BufferPalabras *destino) {
+    return generarPalabras(compilada, generador, cantidadPalabras, destino);
+}
+
+/*
+        Generación en paralelo: la secuencia de palabras se divide en bloques
+        de BLOQUE_PALABRAS y el bloque b usa su propio generador sembrado con
+        (semilla + b). Así la salida depende solo de la semilla maestra y no
+        de la cantidad de hilos. En cada ronda, cada hilo genera
+        BLOQUES_POR_HILO bloques consecutivos en su propio buffer y luego los
+        buffers se escriben en orden.
+ */
+
+#define BLOQUES_POR_HILO 4
+
+typedef struct {
+    FuncionGeneracion generar;
+    const void *fuente;
+    uint64_t semilla;
+    size_t primeraPalabra;      // Índice global de la primera palabra del trabajo (múltiplo de BLOQUE_PALABRAS).
+    size_t cantidadPalabras;
+    size_t palabrasGeneradas;
+    BufferPalabras salida;
+} TrabajoGeneracion;
+
+static RETORNO_HILO ejecutarTrabajoGeneracion(void *argumento) {
+    TrabajoGeneracion *trabajo = argumento;
+    trabajo->salida.longitud = 0;
+    trabajo->palabrasGeneradas = 0;
+    INSTRUMENTAR(const double inicio = obtenerTiempoSegundos();)
+    while (trabajo->palabrasGeneradas < trabajo->cantidadPalabras) {
+        const size_t indicePalabra = trabajo->primeraPalabra + trabajo->palabrasGeneradas;
+        const size_t restantes = trabajo->cantidadPalabras - trabajo->palabrasGeneradas;
+        const size_t cantidadBloque = restantes < BLOQUE_PALABRAS ? restantes : BLOQUE_PALABRAS;
+        GeneradorAleatorio generador;
+        sembrarGenerador(&generador, trabajo->semilla + indicePalabra / BLOQUE_PALABRAS);
+        const size_t generadas = trabajo->generar(trabajo->fuente, &generador, cantidadBloque, &trabajo->salida);
+        trabajo->palabrasGeneradas += generadas;
+        if (generadas != cantidadBloque) {
+            break;
+        }
+    }
+    INSTRUMENTAR(registrarTiempoFase(FASE_GENERACION, inicio);)
+    INSTRUMENTAR(volcarInstrumentacion();)
+    volcarContadoresMemoria();
+    return 0;
+}
+
+// Genera las palabras en paralelo y las escribe en "salida" en el mismo orden que con un solo hilo.
+// Al finalizar informa por stderr el rendimiento del generador (sin contar la escritura).
+bool generarPalabrasEnSalida(const FuncionGeneracion generar, const void *fuente, const size_t cantidadPalabras, const uint64_t semilla, int cantidadHilos, FILE *salida) {
+    if (cantidadHilos < 1) {
+        cantidadHilos = 1;
+    }
+    if (cantidadHilos > MAX_HILOS) {
+        cantidadHilos = MAX_HILOS;
+    }
+    TrabajoGeneracion *trabajos = tcalloc(cantidadHilos, sizeof(TrabajoGeneracion), MEMORIA_GENERACION);
+    Hilo *hilos = tmalloc(cantidadHilos * sizeof(Hilo), MEMORIA_GENERACION);
+    if (trabajos == NULL || hilos == NULL) {
+        memprinterr();
+        tfree(trabajos);
+        tfree(hilos);
+        return false;
+    }
+    for (int i = 0; i < cantidadHilos; i++) {
+        inicializarBufferPalabras(&trabajos[i].salida, MEMORIA_GENERACION);
+    }
+    const size_t palabrasPorTrabajo = (size_t)BLOQUES_POR_HILO * BLOQUE_PALABRAS;
+    double tiempoGeneracion = 0;
+    size_t palabrasGeneradas = 0;
+    bool exito = true;
+    while (exito && palabrasGeneradas < cantidadPalabras) {
+        const double inicio = obtenerTiempoSegundos();
+        int trabajosRonda = 0;
+        for (size_t asignadas = palabrasGeneradas; trabajosRonda < cantidadHilos && asignadas < cantidadPalabras; trabajosRonda++) {
+            TrabajoGeneracion *trabajo = &trabajos[trabajosRonda];
+            const size_t restantes = cantidadPalabras - asignadas;
+            trabajo->generar = generar;
+            trabajo->fuente = fuente;
+            trabajo->semilla = semilla;
+            trabajo->primeraPalabra = asignadas;
+            trabajo->cantidadPalabras = restantes < palabrasPorTrabajo ? restantes : palabrasPorTrabajo;
+            asignadas += trabajo->cantidadPalabras;
+        }
+        ejecutarEnParalelo(ejecutarTrabajoGeneracion, trabajos, sizeof(TrabajoGeneracion), trabajosRonda, hilos);
+        tiempoGeneracion += obtenerTiempoSegundos() - inicio;
+        INSTRUMENTAR(const double inicioEscritura = obtenerTiempoSegundos();)
+        for (int i = 0; exito && i < trabajosRonda; i++) {
+            const TrabajoGeneracion *trabajo = &trabajos[i];
+            palabrasGeneradas += trabajo->palabrasGeneradas;
+            exito = trabajo->palabrasGeneradas == trabajo->cantidadPalabras &&
+                    fwrite(trabajo->salida.datos, 1, trabajo->salida.longitud, salida) == trabajo->salida.longitud;
+        }
+        INSTRUMENTAR(registrarTiempoFase(FASE_ESCRITURA, inicioEscritura);)
+    }
+    for (int i = 0; i < cantidadHilos; i++) {
+        liberarBufferPalabras(&trabajos[i].salida);
+    }
+    tfree(trabajos);
+    tfree(hilos);
+    fflush(salida);
+    fprintf(stderr, "Palabras generadas: %zu en %.3f s con %d hilo(s) (%.0f palabras/s)\n",
+            palabrasGeneradas, tiempoGeneracion, cantidadHilos, tiempoGeneracion > 0 ? palabrasGeneradas / tiempoGeneracion : 0.0);
+    if (!exito) {
+        printerr("No se pudieron generar todas las palabras solicitadas.\n");
+    }
+    return exito;
+}
+
+/*
+        Generación en flujo (--flujo): cada terminal se escribe en un buffer de
+        tamaño fijo apenas se emite, y el buffer se vuelca a la salida cuando
+        se llena. Como la tabla compilada es siempre lineal a derecha, lo ya
+        emitido no cambia, así que de la derivación solo se guarda la fila
+        actual: una palabra de varios gigabytes usa memoria constante y tiempo
+        proporcional a su longitud. Los generadores se siembran por bloques
+        igual que en generarPalabrasEnSalida, por lo que la salida es la misma
+        que con -n, pero se genera en un solo hilo.
+ */
+
+#define TAMANIO_SALIDA_FLUJO (1 << 16)
+
+typedef struct {
+    FILE *archivo;
+    size_t longitud;
+    bool error;
+    char datos[TAMANIO_SALIDA_FLUJO];
+} SalidaFlujo;
+
+static void vaciarSalidaFlujo(SalidaFlujo *salida) {
+    if (salida->longitud > 0 && fwrite(salida->datos, 1, salida->longitud, salida->archivo) != salida->longitud) {
+        salida->error = true;
+    }
+    salida->longitud = 0;
+}
+
+static inline void escribirEnFlujo(SalidaFlujo *salida, const char caracter) {
+    if (salida->longitud == TAMANIO_SALIDA_FLUJO) {
+        vaciarSalidaFlujo(salida);
+    }
+    salida->datos[salida->longitud++] = caracter;
+}
+
+static void derivarEnFlujo(const GramaticaCompilada *compilada, GeneradorAleatorio *generador, SalidaFlujo *salida) {
+    INSTRUMENTAR(uint64_t pasos = 0;)
+    int filaActual = compilada->axioma;
+    while (filaActual != SIN_NO_TERMINAL) {
+        const int elegida = elegirProduccion(compilada, generador, filaActual);
+        const Transicion transicion = compilada->transiciones[elegida];
+        INSTRUMENTAR(registrarDisparo(elegida, compilada->cantidadProducciones); pasos++;)
+        if (transicion.terminal != EPSILON) {
+            escribirEnFlujo(salida, transicion.terminal);
+        }
+        filaActual = transicion.siguiente;
+    }
+    INSTRUMENTAR(registrarDerivacion(pasos);)
+}
+
+// Genera las palabras escribiéndolas en "salida" a medida que se derivan, con memoria constante.
+bool generarPalabrasEnFlujo(const GramaticaCompilada *compilada, const size_t cantidadPalabras, const uint64_t semilla, FILE *salida) {
+    if (esLenguajeVacio(compilada)) {
+        return false;
+    }
+    SalidaFlujo *flujo = tmalloc(sizeof(SalidaFlujo), MEMORIA_GENERACION);
+    if (flujo == NULL) {
+        memprinterr();
+        return false;
+    }
+    flujo->archivo = salida;
+    flujo->longitud = 0;
+    flujo->error = false;
+    const double inicio = obtenerTiempoSegundos();
+    GeneradorAleatorio generador;
+    size_t palabrasGeneradas = 0;
+    for (; palabrasGeneradas < cantidadPalabras && !flujo->error; palabrasGeneradas++) {
+        if (palabrasGeneradas % BLOQUE_PALABRAS == 0) {
+            sembrarGenerador(&generador, semilla + palabrasGeneradas / BLOQUE_PALABRAS);
+        }
+        derivarEnFlujo(compilada, &generador, flujo);
+        escribirEnFlujo(flujo, '\n');
+    }
+    vaciarSalidaFlujo(flujo);
+    const bool exito = !flujo->error && fflush(salida) == 0;
+    tfree(flujo);
+    const double segundos = obtenerTiempoSegundos() - inicio;
+    INSTRUMENTAR(registrarTiempoFase(FASE_GENERACION, inicio);)
+    fprintf(stderr, "Palabras generadas: %zu en %.3f s en flujo (%.0f palabras/s)\n",
+            palabrasGeneradas, segundos, segundos > 0 ? palabrasGeneradas / segundos : 0.0);
+    if (!exito) {
+        printerr("No se pudieron escribir todas las palabras solicitadas.\n");
+    }
+    return exito;
+}
+
+#ifdef INSTRUMENTACION
+
+typedef struct {
+    int produccion;
+    uint64_t disparos;
+} DisparosProduccion;
+
+// Las producciones con nombres más largos se recortan en el reporte.
+#define LONGITUD_NOMBRE_REPORTE 64
+
+static int compararDisparos(const void *a, const void *b) {
+    const DisparosProduccion *x = a;
+    const DisparosProduccion *y = b;
+    if (x->disparos != y->disparos) {
+        return x->disparos < y->disparos ? 1 : -1;
+    }
+    return x->produccion - y->produccion;
+}
+
+// Muestra los totales acumulados desde el último reporte (con las producciones de "compilada") y los reinicia.
+void reportarInstrumentacion(const GramaticaCompilada *compilada, FILE *salida) {
+    volcarInstrumentacion();
+    Instrumentacion *total = &instrumentacionTotal;
+    fprintf(salida, "\nInstrumentacion: %llu derivaciones, %llu pasos (media %.3f, maximo %llu), %llu llamadas al generador aleatorio\n",
+            (unsigned long long)total->derivaciones, (unsigned long long)total->pasos,
+            total->derivaciones > 0 ? (double)total->pasos / total->derivaciones : 0.0,
+            (unsigned long long)total->pasosMaximo, (unsigned long long)total->llamadasAleatorio);
+    for (int i = 0; i < CANTIDAD_FASES; i++) {
+        fprintf(salida, "  Fase %-12s %10.3f s\n", NOMBRES_FASES[i], total->segundosFase[i]);
+    }
+    fprintf(salida, "%-20s %16s\n", "Pasos", "Derivaciones");
+    for (int i = 0; i < CUBETAS_HISTOGRAMA; i++) {
+        if (total->histograma[i] == 0) {
+            continue;
+        }
+        char rango[48];
+        if (i <= 1) {
+            snprintf(rango, sizeof(rango), "%d", i);
+        } else {
+            snprintf(rango, sizeof(rango), "%llu-%llu", 1ull << (i - 1), (1ull << (i - 1)) * 2 - 1);
+        }
+        fprintf(salida, "%-20s %16llu\n", rango, (unsigned long long)total->histograma[i]);
+    }
+    const int cantidad = total->cantidadProducciones < compilada->cantidadProducciones ? total->cantidadProducciones : compilada->cantidadProducciones;
+    DisparosProduccion *disparos = tmalloc((cantidad > 0 ? cantidad : 1) * sizeof(DisparosProduccion), MEMORIA_GENERACION);
+    if (disparos != NULL) {
+        for (int i = 0; i < cantidad; i++) {
+            disparos[i] = (DisparosProduccion){i, total->disparos[i]};
+        }
+        qsort(disparos, cantidad, sizeof(DisparosProduccion), compararDisparos);
+        fprintf(salida, "%-20s %16s %9s\n", "Produccion", "Aplicaciones", "% pasos");
+        for (int i = 0; i < cantidad && disparos[i].disparos > 0; i++) {
+            const Produccion *produccion = &compilada->producciones[disparos[i].produccion];
+            TextoProduccion texto;
+            describirProduccion(compilada->nombres, compilada->inicioNombre, produccion, &texto);
+            char nombre[LONGITUD_NOMBRE_REPORTE];
+            snprintf(nombre, sizeof(nombre), "%s->%s%s", texto.ladoIzquierdo, texto.ladoDerecho[0], texto.ladoDerecho[1]);
+            fprintf(salida, "%-20s %16llu %8.2f%%\n", nombre, (unsigned long long)disparos[i].disparos,
+                    total->pasos > 0 ? 100.0 * disparos[i].disparos / total->pasos : 0.0);
+        }
+        tfree(disparos);
+    } else {
+        memprinterr();
+    }
+    if (total->disparosIncompletos) {
+        printerr("Falto memoria para contar todas las aplicaciones de las producciones: los conteos anteriores estan incompletos.\n");
+    }
+    tfree(total->disparos);
+    memset(total, 0, sizeof(Instrumentacion));
+}
+
+#endif
+
+// --- Automata ---
+
+/*
+        Reconocedor: a partir de la gramática compilada se arma un AFN con un
+        estado por fila más un estado final extra (como las lineales a
+        izquierda ya se normalizaron a lineales a derecha, el AFN siempre se
+        arma igual) y se determiniza con la construcción de subconjuntos. Los
+        conjuntos de estados del AFN se representan como conjuntos de bits. El
+        AFD resultante es una tabla densa indexada por (estado, columna del
+        byte); el estado 0 es el sumidero.
+ */
+
+#define MAX_ESTADOS_AFD (1 << 22)
+
+#define TAMANIO_BLOQUE_ENTRADA (1 << 20)
+
+void destruirAFN(AFN *afn) {
+    tfree(afn->inicioAristas);
+    tfree(afn->aristas);
+    tfree(afn->iniciales);
+    tfree(afn->finales);
+    memset(afn, 0, sizeof(AFN));
+}
+
+static void marcarTerminales(const GramaticaCompilada *compilada, bool usado[256]) {
+    for (int i = 0; i < compilada->cantidadProducciones; i++) {
+        const unsigned char terminal = (unsigned char)compilada->transiciones[i].terminal;
+        if (terminal != EPSILON) {
+            usado[terminal] = true;
+        }
+    }
+}
+
+// Asigna una columna a cada byte marcado como usado. La última columna agrupa al resto de los bytes.
+static bool asignarAlfabeto(const bool usado[256], Automata *automata) {
+    int cantidadTerminales = 0;
+    for (int byte = 0; byte < 256; byte++) {
+        cantidadTerminales += usado[byte];
+    }
+    automata->cantidadColumnas = cantidadTerminales + 1;
+    automata->simbolos = tmalloc(cantidadTerminales + 1, MEMORIA_AUTOMATA);
+    if (automata->simbolos == NULL) {
+        return false;
+    }
+    int columna = 0;
+    for (int byte = 0; byte < 256; byte++) {
+        if (usado[byte]) {
+            automata->simbolos[columna] = (char)byte;
+            automata->clase[byte] = (uint16_t)columna++;
+        } else {
+            automata->clase[byte] = (uint16_t)cantidadTerminales;
+        }
+    }
+    return true;
+}
+
+// Asigna una columna a cada terminal usado por la gramática.
+static bool construirAlfabeto(const GramaticaCompilada *compilada, Automata *automata) {
+    bool usado[256] = {false};
+    marcarTerminales(compilada, usado);
+    return asignarAlfabeto(usado, automata);
+}
+
+static bool construirAFN(const GramaticaCompilada *compilada, const Automata *automata, AFN *afn) {
+    const int cantidadNoTerminales = compilada->cantidadNoTerminales;
+    const int estadoExtra = cantidadNoTerminales;
+    afn->cantidadEstados = cantidadNoTerminales + 1;
+    afn->palabrasPorConjunto = palabrasConjunto(afn->cantidadEstados);
+    afn->inicioAristas = tcalloc(afn->cantidadEstados + 1, sizeof(int), MEMORIA_AUTOMATA);
+    afn->aristas = tmalloc((compilada->cantidadProducciones + 1) * sizeof(AristaAFN), MEMORIA_AUTOMATA);
+    afn->iniciales = tcalloc(afn->palabrasPorConjunto, sizeof(uint64_t), MEMORIA_AUTOMATA);
+    afn->finales = tcalloc(afn->palabrasPorConjunto, sizeof(uint64_t), MEMORIA_AUTOMATA);
+    if (afn->inicioAristas == NULL || afn->aristas == NULL || afn->iniciales == NULL || afn->finales == NULL) {
+        destruirAFN(afn);
+        return false;
+    }
+    agregarElemento(afn->iniciales, compilada->axioma);
+    agregarElemento(afn->finales, estadoExtra);
+    // Cada producción X->aY (o X->a, hacia el estado extra) aporta una arista; las producciones X->@ solo marcan estados finales.
+    for (int fila = 0; fila < cantidadNoTerminales; fila++) {
+        for (int i = compilada->inicioFila[fila]; i < compilada->inicioFila[fila + 1]; i++) {
+            const Transicion transicion = compilada->transiciones[i];
+            if (transicion.terminal == EPSILON) {
+                agregarElemento(afn->finales, fila);
+            } else {
+                afn->inicioAristas[fila + 1]++;
+            }
+        }
+    }
+    for (int q = 0; q < afn->cantidadEstados; q++) {
+        afn->inicioAristas[q + 1] += afn->inicioAristas[q];
+    }
+    int *posicion = tmalloc(afn->cantidadEstados * sizeof(int), MEMORIA_AUTOMATA);
+    if (posicion == NULL) {
+        destruirAFN(afn);
+        return false;
+    }
+    memcpy(posicion, afn->inicioAristas, afn->cantidadEstados * sizeof(int));
+    for (int fila = 0; fila < cantidadNoTerminales; fila++) {
+        for (int i = compilada->inicioFila[fila]; i < compilada->inicioFila[fila + 1]; i++) {
+            const Transicion transicion = compilada->transiciones[i];
+            if (transicion.terminal == EPSILON) {
+                continue;
+            }
+            const int destino = transicion.siguiente != SIN_NO_TERMINAL ? transicion.siguiente : estadoExtra;
+            afn->aristas[posicion[fila]++] = (AristaAFN){automata->clase[(unsigned char)transicion.terminal], destino};
+        }
+    }
+    tfree(posicion);
+    return true;
+}
+
+// Tabla hash (direccionamiento abierto) de los conjuntos de estados del AFN ya convertidos en estados del AFD.
+typedef struct {
+    int palabrasPorConjunto;
+    uint64_t *conjuntos;        // El conjunto del estado e ocupa [e * palabrasPorConjunto, (e + 1) * palabrasPorConjunto).
+    int cantidadConjuntos;
+    int capacidadConjuntos;
+    int32_t *tabla;             // Índice del estado + 1 (0 significa posición libre).
+    size_t capacidadTabla;      // Potencia de 2.
+} TablaConjuntos;
+
+static uint64_t hashConjunto(const uint64_t *conjunto, const int palabras) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (int i = 0; i < palabras; i++) {
+        hash = (hash ^ conjunto[i]) * 0x100000001B3ULL;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+static bool redimensionarTablaConjuntos(TablaConjuntos *tabla, const size_t nuevaCapacidad) {
+    int32_t *nuevaTabla = tcalloc(nuevaCapacidad, sizeof(int32_t), MEMORIA_AUTOMATA);
+    if (nuevaTabla == NULL) {
+        return false;
+    }
+    for (int e = 0; e < tabla->cantidadConjuntos; e++) {
+        size_t posicion = hashConjunto(&tabla->conjuntos[(size_t)e * tabla->palabrasPorConjunto], tabla->palabrasPorConjunto) & (nuevaCapacidad - 1);
+        while (nuevaTabla[posicion] != 0) {
+            posicion = (posicion + 1) & (nuevaCapacidad - 1);
+        }
+        nuevaTabla[posicion] = e + 1;
+    }
+    tfree(tabla->tabla);
+    tabla->tabla = nuevaTabla;
+    tabla->capacidadTabla = nuevaCapacidad;
+    return true;
+}
+
+// Devuelve el estado asociado al conjunto, creándolo si no existía. Devuelve -1 si no hay memoria.
+static int buscarOAgregarConjunto(TablaConjuntos *tabla, const uint64_t *conjunto, bool *esNuevo) {
+    const int palabras = tabla->palabrasPorConjunto;
+    size_t posicion = hashConjunto(conjunto, palabras) & (tabla->capacidadTabla - 1);
+    while (tabla->tabla[posicion] != 0) {
+        const int estado = tabla->tabla[posicion] - 1;
+        if (memcmp(&tabla->conjuntos[(size_t)estado * palabras], conjunto, palabras * sizeof(uint64_t)) == 0) {
+            *esNuevo = false;
+            return estado;
+        }
+        posicion = (posicion + 1) & (tabla->capacidadTabla - 1);
+    }
+    if (tabla->cantidadConjuntos == tabla->capacidadConjuntos) {
+        const int nuevaCapacidad = tabla->capacidadConjuntos * 2;
+        uint64_t *nuevosConjuntos = trealloc(tabla->conjuntos, (size_t)nuevaCapacidad * palabras * sizeof(uint64_t), MEMORIA_AUTOMATA);
+        if (nuevosConjuntos == NULL) {
+            return -1;
+        }
+        tabla->conjuntos = nuevosConjuntos;
+        tabla->capacidadConjuntos = nuevaCapacidad;
+    }
+    const int estado = tabla->cantidadConjuntos++;
+    memcpy(&tabla->conjuntos[(size_t)estado * palabras], conjunto, palabras * sizeof(uint64_t));
+    tabla->tabla[posicion] = estado + 1;
+    // Mantenemos el factor de carga por debajo de 1/2.
+    if ((size_t)tabla->cantidadConjuntos * 2 > tabla->capacidadTabla && !redimensionarTablaConjuntos(tabla, tabla->capacidadTabla * 2)) {
+        return -1;
+    }
+    *esNuevo = true;
+    return estado;
+}
+
+static bool agregarFilaAutomata(Automata *automata, int *capacidadEstados) {
+    if (automata->cantidadEstados < *capacidadEstados) {
+        return true;
+    }
+    const int nuevaCapacidad = *capacidadEstados * 2;
+    int32_t *nuevasTransiciones = trealloc(automata->transiciones, (size_t)nuevaCapacidad * automata->cantidadColumnas * sizeof(int32_t), MEMORIA_AUTOMATA);
+    if (nuevasTransiciones == NULL) {
+        return false;
+    }
+    automata->transiciones = nuevasTransiciones;
+    bool *nuevosFinales = trealloc(automata->esFinal, nuevaCapacidad * sizeof(bool), MEMORIA_AUTOMATA);
+    if (nuevosFinales == NULL) {
+        return false;
+    }
+    automata->esFinal = nuevosFinales;
+    *capacidadEstados = nuevaCapacidad;
+    return true;
+}
+
+// Recorre los estados del AFD en el orden en que se descubren (BFS) y completa su fila de transiciones.
+static bool expandirEstados(const AFN *afn, Automata *automata, TablaConjuntos *tabla, uint64_t *siguientes) {
+    const int palabras = afn->palabrasPorConjunto;
+    const int columnas = automata->cantidadColumnas;
+    int capacidadEstados = 16;
+    automata->transiciones = tmalloc((size_t)capacidadEstados * columnas * sizeof(int32_t), MEMORIA_AUTOMATA);
+    automata->esFinal = tmalloc(capacidadEstados * sizeof(bool), MEMORIA_AUTOMATA);
+    if (automata->transiciones == NULL || automata->esFinal == NULL) {
+        return false;
+    }
+    for (int estado = 0; estado < tabla->cantidadConjuntos; estado++) {
+        automata->cantidadEstados = estado + 1;
+        if (!agregarFilaAutomata(automata, &capacidadEstados)) {
+            return false;
+        }
+        const uint64_t *conjunto = &tabla->conjuntos[(size_t)estado * palabras];
+        bool esFinal = false;
+        memset(siguientes, 0, (size_t)columnas * palabras * sizeof(uint64_t));
+        for (int q = 0; q < afn->cantidadEstados; q++) {
+            if (!contieneElemento(conjunto, q)) {
+                continue;
+            }
+            esFinal |= contieneElemento(afn->finales, q);
+            for (int a = afn->inicioAristas[q]; a < afn->inicioAristas[q + 1]; a++) {
+                agregarElemento(&siguientes[(size_t)afn->aristas[a].columna * palabras], afn->aristas[a].destino);
+            }
+        }
+        // A partir de acá "conjunto" puede quedar invalidado si la tabla crece.
+        automata->esFinal[estado] = esFinal;
+        for (int columna = 0; columna < columnas - 1; columna++) {
+            bool esNuevo;
+            const int destino = buscarOAgregarConjunto(tabla, &siguientes[(size_t)columna * palabras], &esNuevo);
+            if (destino < 0) {
+                return false;
+            }
+            automata->transiciones[(size_t)estado * columnas + columna] = destino;
+        }
+        automata->transiciones[(size_t)estado * columnas + columnas - 1] = ESTADO_SUMIDERO;
+        if (tabla->cantidadConjuntos > MAX_ESTADOS_AFD) {
+            printerr("El automata determinista supera los %d estados.\n", MAX_ESTADOS_AFD);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool determinizar(const AFN *afn, Automata *automata) {
+    const int palabras = afn->palabrasPorConjunto;
+    TablaConjuntos tabla = {palabras, NULL, 0, 16, NULL, 0};
+    uint64_t *siguientes = tcalloc((size_t)automata->cantidadColumnas * palabras, sizeof(uint64_t), MEMORIA_AUTOMATA);
+    uint64_t *vacio = tcalloc(palabras, sizeof(uint64_t), MEMORIA_AUTOMATA);
+    tabla.conjuntos = tmalloc((size_t)tabla.capacidadConjuntos * palabras * sizeof(uint64_t), MEMORIA_AUTOMATA);
+    bool exito = siguientes != NULL && vacio != NULL && tabla.conjuntos != NULL && redimensionarTablaConjuntos(&tabla, 64);
+    if (exito) {
+        // El conjunto vacío es el sumidero (estado 0).
+        bool esNuevo;
+        buscarOAgregarConjunto(&tabla, vacio, &esNuevo);
+        automata->estadoInicial = buscarOAgregarConjunto(&tabla, afn->iniciales, &esNuevo);
+        exito = automata->estadoInicial >= 0 && expandirEstados(afn, automata, &tabla, siguientes);
+        automata->estadosSinMinimizar = automata->cantidadEstados;
+    }
+    if (!exito) {
+        memprinterr();
+    }
+    tfree(siguientes);
+    tfree(vacio);
+    tfree(tabla.conjuntos);
+    tfree(tabla.tabla);
+    return exito;
+}
+
+/*
+        Minimización de Hopcroft. Se parte de la partición {finales, no finales}
+        y se refinan los bloques usando como divisores pares (bloque, símbolo)
+        de una lista de espera, agregando siempre la mitad más chica de cada
+        bloque dividido. Para recorrer las transiciones al revés se arma la
+        función inversa en formato comprimido (una lista por símbolo y estado).
+        La última columna (bytes fuera del alfabeto) siempre va al sumidero, por
+        lo que no distingue estados y no se usa como divisor.
+ */
+
+typedef struct {
+    int *elementos;         // Estados ordenados por bloque.
+    int *posicion;          // Posición de cada estado en "elementos".
+    int *bloque;            // Bloque de cada estado.
+    int *inicio;            // Cada bloque ocupa [inicio[b], fin[b]) en "elementos".
+    int *fin;
+    int *marcados;          // Cantidad de estados marcados al principio de cada bloque.
+    int cantidadBloques;
+} Particion;
+
+typedef struct {
+    int *inicio;            // Los predecesores de (símbolo c, estado e) ocupan [inicio[c * n + e], inicio[c * n + e + 1]).
+    int *origenes;
+} TransicionesInversas;
+
+typedef struct {
+    int *pares;             // Pares (bloque, símbolo) codificados como bloque * símbolos + símbolo.
+    int cantidad;
+    bool *enEspera;
+} ListaEspera;
+
+static void destruirParticion(Particion *particion) {
+    tfree(particion->elementos);
+    tfree(particion->posicion);
+    tfree(particion->bloque);
+    tfree(particion->inicio);
+    tfree(particion->fin);
+    tfree(particion->marcados);
+}
+
+static bool crearParticion(Particion *particion, const Automata *automata) {
+    const int n = automata->cantidadEstados;
+    particion->elementos = tmalloc(n * sizeof(int), MEMORIA_AUTOMATA);
+    particion->posicion = tmalloc(n * sizeof(int), MEMORIA_AUTOMATA);
+    particion->bloque = tmalloc(n * sizeof(int), MEMORIA_AUTOMATA);
+    particion->inicio = tmalloc(n * sizeof(int), MEMORIA_AUTOMATA);
+    particion->fin = tmalloc(n * sizeof(int), MEMORIA_AUTOMATA);
+    particion->marcados = tcalloc(n, sizeof(int), MEMORIA_AUTOMATA);
+    if (particion->elementos == NULL || particion->posicion == NULL || particion->bloque == NULL ||
+        particion->inicio == NULL || particion->fin == NULL || particion->marcados == NULL) {
+        destruirParticion(particion);
+        return false;
+    }
+    // Primero los estados no finales y después los finales.
+    int cantidad = 0;
+    for (int pasada = 0; pasada < 2; pasada++) {
+        const int inicioBloque = cantidad;
+        for (int e = 0; e < n; e++) {
+            if (automata->esFinal[e] == (pasada == 1)) {
+                particion->posicion[e] = cantidad;
+                particion->elementos[cantidad++] = e;
+            }
+        }
+        if (cantidad > inicioBloque) {
+            const int b = particion->cantidadBloques++;
+            particion->inicio[b] = inicioBloque;
+            particion->fin[b] = cantidad;
+            for (int i = inicioBloque; i < cantidad; i++) {
+                particion->bloque[particion->elementos[i]] = b;
+            }
+        }
+    }
+    return true;
+}
+
+static bool crearTransicionesInversas(TransicionesInversas *inversas, const Automata *automata, const int simbolos) {
+    const int n = automata->cantidadEstados;
+    const int columnas = automata->cantidadColumnas;
+    inversas->inicio = tcalloc((size_t)simbolos * n + 1, sizeof(int), MEMORIA_AUTOMATA);
+    inversas->origenes = tmalloc(((size_t)simbolos * n + 1) * sizeof(int), MEMORIA_AUTOMATA);
+    if (inversas->inicio == NULL || inversas->origenes == NULL) {
+        tfree(inversas->inicio);
+        tfree(inversas->origenes);
+        return false;
+    }
+    const size_t claves = (size_t)simbolos * n;
+    for (int e = 0; e < n; e++) {
+        for (int c = 0; c < simbolos; c++) {
+            inversas->inicio[(size_t)c * n + automata->transiciones[(size_t)e * columnas + c]]++;
+        }
+    }
+    // Acumulamos para que inicio[clave] sea el fin de su lista y la llenamos de atrás hacia adelante:
+    // al terminar, inicio[clave] queda apuntando al principio.
+    for (size_t i = 1; i < claves; i++) {
+        inversas->inicio[i] += inversas->inicio[i - 1];
+    }
+    inversas->inicio[claves] = claves > 0 ? inversas->inicio[claves - 1] : 0;
+    for (int e = n - 1; e >= 0; e--) {
+        for (int c = 0; c < simbolos; c++) {
+            const size_t clave = (size_t)c * n + automata->transiciones[(size_t)e * columnas + c];
+            inversas->origenes[--inversas->inicio[clave]] = e;
+        }
+    }
+    return true;
+}
+
+static void agregarEnEspera(ListaEspera *espera, const int bloque, const int simbolo, const int simbolos) {
+    const int par = bloque * simbolos + simbolo;
+    if (!espera->enEspera[par]) {
+        espera->enEspera[par] = true;
+        espera->pares[espera->cantidad++] = par;
+    }
+}
+
+static void marcarEstado(Particion *particion, const int estado) {
+    const int b = particion->bloque[estado];
+    const int destino = particion->inicio[b] + particion->marcados[b]++;
+    const int otro = particion->elementos[destino];
+    const int origen = particion->posicion[estado];
+    particion->elementos[destino] = estado;
+    particion->posicion[estado] = destino;
+    particion->elementos[origen] = otro;
+    particion->posicion[otro] = origen;
+}
+
+// Refina la partición hasta que sea estable. "tocados" y "divisor" son espacio de trabajo de n enteros.
+static void refinarParticion(Particion *particion, const TransicionesInversas *inversas, ListaEspera *espera,
+                             const int n, const int simbolos, int *tocados, int *divisor) {
+    while (espera->cantidad > 0) {
+        const int par = espera->pares[--espera->cantidad];
+        espera->enEspera[par] = false;
+        const int bloqueDivisor = par / simbolos;
+        const int simbolo = par % simbolos;
+        // Copiamos el divisor porque sus estados pueden moverse al marcar.
+        const int tamanioDivisor = particion->fin[bloqueDivisor] - particion->inicio[bloqueDivisor];
+        memcpy(divisor, &particion->elementos[particion->inicio[bloqueDivisor]], tamanioDivisor * sizeof(int));
+        int cantidadTocados = 0;
+        for (int i = 0; i < tamanioDivisor; i++) {
+            const size_t clave = (size_t)simbolo * n + divisor[i];
+            for (int j = inversas->inicio[clave]; j < inversas->inicio[clave + 1]; j++) {
+                const int predecesor = inversas->origenes[j];
+                const int b = particion->bloque[predecesor];
+                if (particion->posicion[predecesor] < particion->inicio[b] + particion->marcados[b]) {
+                    continue; // Ya estaba marcado.
+                }
+                if (particion->marcados[b] == 0) {
+                    tocados[cantidadTocados++] = b;
+                }
+                marcarEstado(particion, predecesor);
+            }
+        }
+        for (int i = 0; i < cantidadTocados; i++) {
+            const int b = tocados[i];
+            const int marcados = particion->marcados[b];
+            particion->marcados[b] = 0;
+            if (marcados == particion->fin[b] - particion->inicio[b]) {
+                continue; // Todo el bloque va al mismo lado: no se divide.
+            }
+            // Los estados marcados pasan a un bloque nuevo.
+            const int nuevo = particion->cantidadBloques++;
+            particion->inicio[nuevo] = particion->inicio[b];
+            particion->fin[nuevo] = particion->inicio[b] + marcados;
+            particion->inicio[b] += marcados;
+            for (int k = particion->inicio[nuevo]; k < particion->fin[nuevo]; k++) {
+                particion->bloque[particion->elementos[k]] = nuevo;
+            }
+            const int tamanioNuevo = particion->fin[nuevo] - particion->inicio[nuevo];
+            const int tamanioViejo = particion->fin[b] - particion->inicio[b];
+            for (int c = 0; c < simbolos; c++) {
+                if (espera->enEspera[b * simbolos + c]) {
+                    agregarEnEspera(espera, nuevo, c, simbolos);
+                } else {
+                    agregarEnEspera(espera, tamanioNuevo <= tamanioViejo ? nuevo : b, c, simbolos);
+                }
+            }
+        }
+    }
+}
+
+// Arma el autómata cociente. El bloque del sumidero pasa a ser el estado 0 y el resto se numera en orden BFS.
+static bool construirCociente(Automata *automata, const Particion *particion) {
+    const int columnas = automata->cantidadColumnas;
+    const int bloques = particion->cantidadBloques;
+    int *numero = tmalloc(bloques * sizeof(int), MEMORIA_AUTOMATA);
+    int *cola = tmalloc(bloques * sizeof(int), MEMORIA_AUTOMATA);
+    int32_t *transiciones = tmalloc((size_t)bloques * columnas * sizeof(int32_t), MEMORIA_AUTOMATA);
+    bool *esFinal = tmalloc(bloques * sizeof(bool), MEMORIA_AUTOMATA);
+    if (numero == NULL || cola == NULL || transiciones == NULL || esFinal == NULL) {
+        tfree(numero);
+        tfree(cola);
+        tfree(transiciones);
+        tfree(esFinal);
+        return false;
+    }
+    for (int b = 0; b < bloques; b++) {
+        numero[b] = -1;
+    }
+    int cantidad = 0;
+    cola[cantidad] = particion->bloque[ESTADO_SUMIDERO];
+    numero[cola[cantidad]] = cantidad;
+    cantidad++;
+    const int bloqueInicial = particion->bloque[automata->estadoInicial];
+    if (numero[bloqueInicial] < 0) {
+        cola[cantidad] = bloqueInicial;
+        numero[bloqueInicial] = cantidad++;
+    }
+    for (int i = 0; i < cantidad; i++) {
+        const int representante = particion->elementos[particion->inicio[cola[i]]];
+        esFinal[i] = automata->esFinal[representante];
+        for (int c = 0; c < columnas; c++) {
+            const int destino = particion->bloque[automata->transiciones[(size_t)representante * columnas + c]];
+            if (numero[destino] < 0) {
+                cola[cantidad] = destino;
+                numero[destino] = cantidad++;
+            }
+            transiciones[(size_t)i * columnas + c] = numero[destino];
+        }
+    }
+    tfree(automata->transiciones);
+    tfree(automata->esFinal);
+    automata->transiciones = transiciones;
+    automata->esFinal = esFinal;
+    automata->estadoInicial = numero[bloqueInicial];
+    automata->cantidadEstados = cantidad;
+    tfree(numero);
+    tfree(cola);
+    return true;
+}
+
+bool minimizarAutomata(Automata *automata) {
+    const int n = automata->cantidadEstados;
+    const int simbolos = automata->cantidadColumnas - 1;
+    Particion particion = {0};
+    TransicionesInversas inversas = {0};
+    ListaEspera espera = {0};
+    if (!crearParticion(&particion, automata)) {
+        memprinterr();
+        return false;
+    }
+    if (!crearTransicionesInversas(&inversas, automata, simbolos)) {
+        memprinterr();
+        destruirParticion(&particion);
+        return false;
+    }
+    espera.pares = tmalloc(((size_t)n * simbolos + 1) * sizeof(int), MEMORIA_AUTOMATA);
+    espera.enEspera = tcalloc((size_t)n * simbolos + 1, sizeof(bool), MEMORIA_AUTOMATA);
+    int *tocados = tmalloc(n * sizeof(int), MEMORIA_AUTOMATA);
+    int *divisor = tmalloc(n * sizeof(int), MEMORIA_AUTOMATA);
+    bool exito = espera.pares != NULL && espera.enEspera != NULL && tocados != NULL && divisor != NULL;
+    if (exito) {
+        // Alcanza con empezar por el bloque más chico de la partición inicial.
+        if (particion.cantidadBloques == 2) {
+            const int menor = particion.fin[0] - particion.inicio[0] <= particion.fin[1] - particion.inicio[1] ? 0 : 1;
+            for (int c = 0; c < simbolos; c++) {
+                agregarEnEspera(&espera, menor, c, simbolos);
+            }
+        }
+        refinarParticion(&particion, &inversas, &espera, n, simbolos, tocados, divisor);
+        exito = construirCociente(automata, &particion);
+    }
+    if (!exito) {
+        memprinterr();
+    }
+    tfree(espera.pares);
+    tfree(espera.enEspera);
+    tfree(tocados);
+    tfree(divisor);
+    tfree(inversas.inicio);
+    tfree(inversas.origenes);
+    destruirParticion(&particion);
+    return exito;
+}
+
+size_t bytesTablaAutomata(const Automata *automata) {
+    return (size_t)automata->cantidadEstados * automata->cantidadColumnas * sizeof(int32_t) +
+           automata->cantidadEstados * sizeof(bool) + sizeof(automata->clase);
+}
+
+void mostrarEstadisticasAutomata(const Automata *automata, FILE *salida) {
+    fprintf(salida, "Estados del AFN: %d\n", automata->estadosAFN);
+    fprintf(salida, "Estados del AFD: %d (minimizado: %d, incluye el sumidero)\n", automata->estadosSinMinimizar, automata->cantidadEstados);
+    fprintf(salida, "Simbolos del alfabeto: %d\n", automata->cantidadColumnas - 1);
+    fprintf(salida, "Bytes de la tabla: %zu\n", bytesTablaAutomata(automata));
+}
+
+void destruirAutomata(Automata *automata) {
+    if (automata != NULL) {
+        tfree(automata->simbolos);
+        tfree(automata->transiciones);
+        tfree(automata->esFinal);
+        tfree(automata);
+    }
+}
+
+Automata *construirAutomata(const GramaticaCompilada *compilada) {
+    Automata *automata = tcalloc(1, sizeof(Automata), MEMORIA_AUTOMATA);
+    if (automata == NULL) {
+        memprinterr();
+        return NULL;
+    }
+    AFN afn;
+    if (!construirAlfabeto(compilada, automata) || !construirAFN(compilada, automata, &afn)) {
+        memprinterr();
+        destruirAutomata(automata);
+        return NULL;
+    }
+    automata->estadosAFN = afn.cantidadEstados;
+    const bool exito = determinizar(&afn, automata) && minimizarAutomata(automata);
+    destruirAFN(&afn);
+    if (!exito) {
+        destruirAutomata(automata);
+        return NULL;
+    }
+    return automata;
+}
+
+bool aceptaPalabra(const Automata *automata, const char *palabra, const size_t longitud) {
+    const int32_t *transiciones = automata->transiciones;
+    const uint16_t *clase = automata->clase;
+    const size_t columnas = automata->cantidadColumnas;
+    int32_t estado = automata->estadoInicial;
+    for (size_t i = 0; i < longitud; i++) {
+        estado = transiciones[estado * columnas + clase[(unsigned char)palabra[i]]];
+        if (estado == ESTADO_SUMIDERO) {
+            return false;
+        }
+    }
+    return automata->esFinal[estado];
+}
+
+/*
+        Lee cadenas separadas por '\n' desde "entrada" en bloques grandes y
+        escribe en "salida" una línea por cadena: 1 si pertenece al lenguaje y
+        0 si no. Una línea que queda cortada al final de un bloque se mueve al
+        principio del buffer antes de leer el siguiente.
+ */
+bool reconocerEntrada(const Automata *automata, FILE *entrada, FILE *salida) {
+    BufferPalabras lectura, resultado;
+    inicializarBufferPalabras(&lectura, MEMORIA_AUTOMATA);
+    inicializarBufferPalabras(&resultado, MEMORIA_AUTOMATA);
+    size_t cadenas = 0, aceptadas = 0, bytesLeidos = 0;
+    bool exito = reservarBufferPalabras(&lectura, TAMANIO_BLOQUE_ENTRADA);
+    const double inicio = obtenerTiempoSegundos();
+    bool finEntrada = false;
+    while (exito && !finEntrada) {
+        if (lectura.capacidad - lectura.longitud < TAMANIO_BLOQUE_ENTRADA / 2) {
+            exito = reservarBufferPalabras(&lectura, lectura.capacidad * 2);
+        }
+        const size_t leidos = fread(lectura.datos + lectura.longitud, 1, lectura.capacidad - lectura.longitud, entrada);
+        bytesLeidos += leidos;
+        lectura.longitud += leidos;
+        finEntrada = leidos == 0;
+        resultado.longitud = 0;
+        size_t inicioLinea = 0;
+        while (exito && inicioLinea < lectura.longitud) {
+            const char *finLinea = memchr(lectura.datos + inicioLinea, '\n', lectura.longitud - inicioLinea);
+            if (finLinea == NULL && !finEntrada) {
+                break;
+            }
+            const size_t fin = finLinea != NULL ? (size_t)(finLinea - lectura.datos) : lectura.longitud;
+            size_t longitud = fin - inicioLinea;
+            if (longitud > 0 && lectura.datos[inicioLinea + longitud - 1] == '\r') {
+                longitud--;
+            }
+            const bool acepta = aceptaPalabra(automata, lectura.datos + inicioLinea, longitud);
+            aceptadas += acepta;
+            cadenas++;
+            exito = reservarBufferPalabras(&resultado, resultado.longitud + 2);
+            if (exito) {
+                resultado.datos[resultado.longitud++] = acepta ? '1' : '0';
+                resultado.datos[resultado.longitud++] = '\n';
+            }
+            inicioLinea = finLinea != NULL ? fin + 1 : fin;
+        }
+        memmove(lectura.datos, lectura.datos + inicioLinea, lectura.longitud - inicioLinea);
+        lectura.longitud -= inicioLinea;
+        if (exito && fwrite(resultado.datos, 1, resultado.longitud, salida) != resultado.longitud) {
+            exito = false;
+        }
+    }
+    const double tiempo = obtenerTiempoSegundos() - inicio;
+    liberarBufferPalabras(&lectura);
+    liberarBufferPalabras(&resultado);
+    fflush(salida);
+    fprintf(stderr, "Cadenas: %zu, aceptadas: %zu, %.3f s (%.1f MB/s)\n", cadenas, aceptadas, tiempo,
+            tiempo > 0 ? bytesLeidos / tiempo / 1e6 : 0.0);
+    return exito;
+}
+
+// --- Muestreo por longitud ---
+
+/*
+        Muestreo uniforme entre todas las palabras de una longitud exacta n.
+        Se cuenta sobre el AFD mínimo (y no sobre las producciones) porque en
+        un autómata determinista cada palabra corresponde a un único camino;
+        en una gramática ambigua contar derivaciones favorecería a las palabras
+        con más de una derivación. C[r][q] es la cantidad de caminos de r
+        símbolos desde q hasta un estado final:
+            C[0][q] = esFinal[q],  C[r][q] = suma sobre a de C[r - 1][d(q, a)]
+        Al muestrear, desde el estado actual con r símbolos restantes se elige
+        cada símbolo a con probabilidad proporcional a C[r - 1][d(q, a)].
+        Las cantidades crecen exponencialmente con n, así que cada fila se
+        guarda en doubles escalada por una potencia de 2 (exacta) cuando su
+        máximo supera ESCALA_MUESTREO. Como al muestrear solo se comparan
+        valores de una misma fila, la escala no afecta las probabilidades.
+ */
+
+#define ESCALA_MUESTREO 0x1.0p512
+
+void destruirMuestreadorLongitud(MuestreadorLongitud *muestreador) {
+    if (muestreador != NULL) {
+        tfree(muestreador->completaciones);
+        tfree(muestreador->escalas);
+        tfree(muestreador);
+    }
+}
+
+MuestreadorLongitud *crearMuestreadorLongitud(const Automata *automata, const size_t longitud) {
+    const size_t estados = automata->cantidadEstados;
+    const int simbolos = automata->cantidadColumnas - 1;
+    if (longitud >= SIZE_MAX / sizeof(double) / estados - 1) {
+        printerr("La longitud pedida es demasiado grande: %zu\n", longitud);
+        return NULL;
+    }
+    MuestreadorLongitud *muestreador = tcalloc(1, sizeof(MuestreadorLongitud), MEMORIA_MUESTREO);
+    if (muestreador == NULL) {
+        memprinterr();
+        return NULL;
+    }
+    muestreador->automata = automata;
+    muestreador->longitud = longitud;
+    muestreador->completaciones = tmalloc((longitud + 1) * estados * sizeof(double), MEMORIA_MUESTREO);
+    muestreador->escalas = tmalloc((longitud + 1) * sizeof(int), MEMORIA_MUESTREO);
+    if (muestreador->completaciones == NULL || muestreador->escalas == NULL) {
+        memprinterr();
+        destruirMuestreadorLongitud(muestreador);
+        return NULL;
+    }
+    double *fila = muestreador->completaciones;
+    for (size_t q = 0; q < estados; q++) {
+        fila[q] = automata->esFinal[q] ? 1.0 : 0.0;
+    }
+    muestreador->escalas[0] = 0;
+    for (size_t r = 1; r <= longitud; r++) {
+        const double *anterior = fila;
+        fila += estados;
+        double maximo = 0;
+        for (size_t q = 0; q < estados; q++) {
+            const int32_t *transiciones = automata->transiciones + q * automata->cantidadColumnas;
+            double suma = 0;
+            for (int columna = 0; columna < simbolos; columna++) {
+                suma += anterior[transiciones[columna]];
+            }
+            fila[q] = suma;
+            if (suma > maximo) {
+                maximo = suma;
+            }
+        }
+        muestreador->escalas[r] = muestreador->escalas[r - 1];
+        if (maximo > ESCALA_MUESTREO) {
+            for (size_t q = 0; q < estados; q++) {
+                fila[q] /= ESCALA_MUESTREO;
+            }
+            muestreador->escalas[r]++;
+        }
+    }
+    return muestreador;
+}
+
+bool hayPalabrasDeLongitud(const MuestreadorLongitud *muestreador) {
+    const size_t estados = muestreador->automata->cantidadEstados;
+    return muestreador->completaciones[muestreador->longitud * estados + muestreador->automata->estadoInicial] > 0;
+}
+
+void mostrarCantidadPalabrasLongitud(const MuestreadorLongitud *muestreador, FILE *salida) {
+    const size_t estados = muestreador->automata->cantidadEstados;
+    const double cantidad = muestreador->completaciones[muestreador->longitud * estados + muestreador->automata->estadoInicial];
+    const int escalas = muestreador->escalas[muestreador->longitud];
+    fprintf(salida, "Palabras de longitud %zu: ", muestreador->longitud);
+    // Hasta 2^53 el double es la cantidad exacta.
+    if (escalas == 0 && cantidad <= 0x1.0p53) {
+        fprintf(salida, "%.0f\n", cantidad);
+    } else {
+        mostrarCantidadAproximada(cantidad, escalas * 512, salida);
+        fprintf(salida, "\n");
+    }
+}
+
+// Agrega al final de "destino" una palabra elegida de manera uniforme entre las de la longitud del muestreador.
+bool muestrearPalabra(const MuestreadorLongitud *muestreador, GeneradorAleatorio *generador, BufferPalabras *destino) {
+    const Automata *automata = muestreador->automata;
+    const size_t estados = automata->cantidadEstados;
+    const int simbolos = automata->cantidadColumnas - 1;
+    if (!reservarBufferPalabras(destino, destino->longitud + muestreador->longitud)) {
+        return false;
+    }
+    int32_t estado = automata->estadoInicial;
+    for (size_t restantes = muestreador->longitud; restantes > 0; restantes--) {
+        const double *fila = muestreador->completaciones + (restantes - 1) * estados;
+        const int32_t *transiciones = automata->transiciones + (size_t)estado * automata->cantidadColumnas;
+        double total = 0;
+        for (int columna = 0; columna < simbolos; columna++) {
+            total += fila[transiciones[columna]];
+        }
+        if (total <= 0) {
+            return false;
+        }
+        const double objetivo = aleatorioUnitario(generador) * total;
+        double acumulado = 0;
+        int elegida = -1;
+        for (int columna = 0; columna < simbolos; columna++) {
+            const double peso = fila[transiciones[columna]];
+            if (peso > 0) {
+                elegida = columna;
+                acumulado += peso;
+                if (objetivo < acumulado) {
+                    break;
+                }
+            }
+        }
+        destino->datos[destino->longitud++] = automata->simbolos[elegida];
+        estado = transiciones[elegida];
+    }
+    return true;
+}
+
+size_t muestrearPalabras(const void *muestreador, GeneradorAleatorio *generador, const size_t cantidadPalabras, BufferPalabras *destino) {
+    for (size_t i = 0; i < cantidadPalabras; i++) {
+        if (!muestrearPalabra(muestreador, generador, destino) || !reservarBufferPalabras(destino, destino->longitud + 1)) {
+            return i;
+        }
+        destino->datos[destino->longitud++] = '\n';
+    }
+    return cantidadPalabras;
+}
+
+// --- Enumeracion ---
+
+/*
+        Enumera todas las palabras del lenguaje de longitud 0 a "longitudMaxima"
+        en orden shortlex (primero por longitud y, a igual longitud, en orden
+        lexicográfico de bytes). Se recorre el AFD mínimo en profundidad, así
+        que cada palabra aparece una sola vez aunque la gramática sea ambigua
+        y la memoria no depende de la cantidad de palabras. Para no explorar
+        ramas muertas se precalcula alcanzaFinal[r][q]: si desde q se llega a
+        un estado final con exactamente r símbolos.
+        En paralelo: cada longitud se divide en una rama por primer símbolo;
+        cada hilo enumera una rama en su propio buffer y los buffers se
+        escriben en orden, así la salida es la misma con cualquier cantidad de
+        hilos.
+ */
+
+void destruirEnumerador(Enumerador *enumerador) {
+    if (enumerador != NULL) {
+        tfree(enumerador->alcanzaFinal);
+        tfree(enumerador);
+    }
+}
+
+Enumerador *crearEnumerador(const Automata *automata, const size_t longitudMaxima) {
+    const size_t estados = automata->cantidadEstados;
+    const int simbolos = automata->cantidadColumnas - 1;
+    if (longitudMaxima >= SIZE_MAX / estados - 1) {
+        printerr("La longitud pedida es demasiado grande: %zu\n", longitudMaxima);
+        return NULL;
+    }
+    Enumerador *enumerador = tcalloc(1, sizeof(Enumerador), MEMORIA_ENUMERACION);
+    if (enumerador == NULL) {
+        memprinterr();
+        return NULL;
+    }
+    enumerador->automata = automata;
+    enumerador->longitudMaxima = longitudMaxima;
+    enumerador->alcanzaFinal = tmalloc((longitudMaxima + 1) * estados * sizeof(bool), MEMORIA_ENUMERACION);
+    if (enumerador->alcanzaFinal == NULL) {
+        memprinterr();
+        destruirEnumerador(enumerador);
+        return NULL;
+    }
+    bool *fila = enumerador->alcanzaFinal;
+    memcpy(fila, automata->esFinal, estados * sizeof(bool));
+    for (size_t r = 1; r <= longitudMaxima; r++) {
+        const bool *anterior = fila;
+        fila += estados;
+        for (size_t q = 0; q < estados; q++) {
+            const int32_t *transiciones = automata->transiciones + q * automata->cantidadColumnas;
+            bool alcanza = false;
+            for (int columna = 0; columna < simbolos && !alcanza; columna++) {
+                alcanza = anterior[transiciones[columna]];
+            }
+            fila[q] = alcanza;
+        }
+    }
+    return enumerador;
+}
+
+static inline bool alcanzaFinal(const Enumerador *enumerador, const size_t restantes, const int32_t estado) {
+    return enumerador->alcanzaFinal[restantes * enumerador->automata->cantidadEstados + estado];
+}
+
+typedef struct {
+    const Enumerador *enumerador;
+    size_t longitud;
+    int primeraColumna;         // Solo se enumeran las palabras que empiezan con este símbolo (si longitud > 0).
+    size_t palabrasEnumeradas;
+    bool exito;
+    BufferPalabras salida;
+} TrabajoEnumeracion;
+
+// Agrega a "destino" las palabras de la rama en orden lexicográfico, sin recursión (la pila tiene "longitud" niveles).
+static bool enumerarRama(TrabajoEnumeracion *trabajo, int32_t *estados, int *columnas, char *palabra) {
+    const Enumerador *enumerador = trabajo->enumerador;
+    const Automata *automata = enumerador->automata;
+    const size_t longitud = trabajo->longitud;
+    const int simbolos = automata->cantidadColumnas - 1;
+    BufferPalabras *destino = &trabajo->salida;
+    if (longitud == 0) {
+        if (!automata->esFinal[automata->estadoInicial]) {
+            return true;
+        }
+        if (!reservarBufferPalabras(destino, destino->longitud + 1)) {
+            return false;
+        }
+        destino->datos[destino->longitud++] = '\n';
+        trabajo->palabrasEnumeradas++;
+        return true;
+    }
+    estados[0] = automata->estadoInicial;
+    columnas[0] = trabajo->primeraColumna;
+    size_t nivel = 0;
+    for (;;) {
+        const int limite = nivel == 0 ? trabajo->primeraColumna + 1 : simbolos;
+        if (columnas[nivel] >= limite) {
+            if (nivel == 0) {
+                return true;
+            }
+            columnas[--nivel]++;
+            continue;
+        }
+        const int columna = columnas[nivel];
+        const int32_t siguiente = automata->transiciones[(size_t)estados[nivel] * automata->cantidadColumnas + columna];
+        const size_t restantes = longitud - nivel - 1;
+        if (!alcanzaFinal(enumerador, restantes, siguiente)) {
+            columnas[nivel]++;
+            continue;
+        }
+        palabra[nivel] = automata->simbolos[columna];
+        if (restantes == 0) {
+            if (!reservarBufferPalabras(destino, destino->longitud + longitud + 1)) {
+                return false;
+            }
+            memcpy(destino->datos + destino->longitud, palabra, longitud);
+            destino->longitud += longitud;
+            destino->datos[destino->longitud++] = '\n';
+            trabajo->palabrasEnumeradas++;
+            columnas[nivel]++;
+        } else {
+            estados[++nivel] = siguiente;
+            columnas[nivel] = 0;
+        }
+    }
+}
+
+static RETORNO_HILO ejecutarTrabajoEnumeracion(void *argumento) {
+    TrabajoEnumeracion *trabajo = argumento;
+    const size_t longitud = trabajo->longitud;
+    trabajo->salida.longitud = 0;
+    trabajo->palabrasEnumeradas = 0;
+    int32_t *estados = tmalloc((longitud + 1) * sizeof(int32_t), MEMORIA_ENUMERACION);
+    int *columnas = tmalloc((longitud + 1) * sizeof(int), MEMORIA_ENUMERACION);
+    char *palabra = tmalloc(longitud + 1, MEMORIA_ENUMERACION);
+    trabajo->exito = estados != NULL && columnas != NULL && palabra != NULL &&
+                     enumerarRama(trabajo, estados, columnas, palabra);
+    tfree(estados);
+    tfree(columnas);
+    tfree(palabra);
+    volcarContadoresMemoria();
+    return 0;
+}
+
+// Escribe en "salida" todas las palabras de longitud hasta la del enumerador, una por línea y en orden shortlex.
+bool enumerarPalabrasEnSalida(const Enumerador *enumerador, int cantidadHilos, FILE *salida) {
+    const Automata *automata = enumerador->automata;
+    const int simbolos = automata->cantidadColumnas - 1;
+    if (cantidadHilos < 1) {
+        cantidadHilos = 1;
+    }
+    if (cantidadHilos > MAX_HILOS) {
+        cantidadHilos = MAX_HILOS;
+    }
+    TrabajoEnumeracion *trabajos = tcalloc(cantidadHilos, sizeof(TrabajoEnumeracion), MEMORIA_ENUMERACION);
+    Hilo *hilos = tmalloc(cantidadHilos * sizeof(Hilo), MEMORIA_ENUMERACION);
+    if (trabajos == NULL || hilos == NULL) {
+        memprinterr();
+        tfree(trabajos);
+        tfree(hilos);
+        return false;
+    }
+    for (int i = 0; i < cantidadHilos; i++) {
+        trabajos[i].enumerador = enumerador;
+        inicializarBufferPalabras(&trabajos[i].salida, MEMORIA_ENUMERACION);
+    }
+    const double inicio = obtenerTiempoSegundos();
+    size_t palabrasEnumeradas = 0;
+    bool exito = true;
+    // Las ramas se recorren en orden shortlex: longitud 0 (una sola rama) y luego, por cada longitud, un símbolo inicial a la vez.
+    size_t longitud = 0;
+    int columna = 0;
+    while (exito && longitud <= enumerador->longitudMaxima) {
+        int trabajosRonda = 0;
+        while (trabajosRonda < cantidadHilos && longitud <= enumerador->longitudMaxima) {
+            const bool esRama = longitud == 0 ||
+                alcanzaFinal(enumerador, longitud - 1, automata->transiciones[(size_t)automata->estadoInicial * automata->cantidadColumnas + columna]);
+            if (esRama) {
+                trabajos[trabajosRonda].longitud = longitud;
+                trabajos[trabajosRonda].primeraColumna = columna;
+                trabajosRonda++;
+            }
+            if (longitud == 0 || ++columna == simbolos) {
+                longitud++;
+                columna = 0;
+            }
+        }
+        ejecutarEnParalelo(ejecutarTrabajoEnumeracion, trabajos, sizeof(TrabajoEnumeracion), trabajosRonda, hilos);
+        for (int i = 0; exito && i < trabajosRonda; i++) {
+            const TrabajoEnumeracion *trabajo = &trabajos[i];
+            palabrasEnumeradas += trabajo->palabrasEnumeradas;
+            exito = trabajo->exito &&
+                    fwrite(trabajo->salida.datos, 1, trabajo->salida.longitud, salida) == trabajo->salida.longitud;
+        }
+    }
+    const double tiempo = obtenerTiempoSegundos() - inicio;
+    for (int i = 0; i < cantidadHilos; i++) {
+        liberarBufferPalabras(&trabajos[i].salida);
+    }
+    tfree(trabajos);
+    tfree(hilos);
+    fflush(salida);
+    fprintf(stderr, "Palabras enumeradas: %zu hasta longitud %zu en %.3f s con %d hilo(s)\n",
+            palabrasEnumeradas, enumerador->longitudMaxima, tiempo, cantidadHilos);
+    if (!exito) {
+        printerr("No se pudieron enumerar todas las palabras.\n");
+    }
+    return exito;
+}
+
+// --- Conteo ---
+
+/*
+        Cuenta |L(G) ∩ Σ^n| sobre el AFD mínimo: cada palabra es un único
+        camino, así que la cantidad es e_inicial · M^n · finales, donde
+        M[q][q'] es la cantidad de símbolos que llevan de q a q' (matriz de
+        transferencia). Para un n grande se usa exponenciación por cuadrados
+        (O(Q^3 log n)); para todas las longitudes 0..k se hace un barrido
+        vector por matriz (O(k Q |alfabeto|)).
+        Cada cantidad se lleva de dos formas: exacta módulo "modulo" (si es 0,
+        módulo 2^64) y aproximada como mantisa double * 2^exponente, que no
+        desborda para ningún n. Sin módulo, si la aproximación indica que la
+        cantidad entra en 63 bits, el residuo módulo 2^64 es la cantidad exacta.
+ */
+
+// Cuando el máximo de una matriz supera este valor se la divide por él (es una potencia de 2, la división es exacta).
+#define ESCALA_CONTEO 0x1.0p256
+
+#define BITS_ESCALA_CONTEO 256
+
+#define LIMITE_EXACTO_CONTEO 0x1.0p63
+
+// Con más estados la matriz de transferencia ocupa demasiado y se cuenta con el barrido.
+#define MAX_ESTADOS_MATRIZ_CONTEO 2048
+
+typedef struct {
+    int dimension;
+    uint64_t *residuos;     // dimension * dimension.
+    double *aproximados;    // dimension * dimension, escalados por 2^exponente.
+    int exponente;
+} MatrizConteo;
+
+static inline uint64_t sumarModulo(const uint64_t a, const uint64_t b, const uint64_t modulo) {
+    if (modulo == 0) {
+        return a + b;
+    }
+    const uint64_t suma = a + b;
+    return suma >= modulo ? suma - modulo : suma;
+}
+
+static inline uint64_t multiplicarModulo(const uint64_t a, const uint64_t b, const uint64_t modulo) {
+    if (modulo == 0) {
+        return a * b;
+    }
+    return (uint64_t)((unsigned __int128)a * b % modulo);
+}
+
+static bool crearMatrizConteo(MatrizConteo *matriz, const int dimension) {
+    matriz->dimension = dimension;
+    matriz->exponente = 0;
+    matriz->residuos = tcalloc((size_t)dimension * dimension, sizeof(uint64_t), MEMORIA_CONTEO);
+    matriz->aproximados = tcalloc((size_t)dimension * dimension, sizeof(double), MEMORIA_CONTEO);
+    return matriz->residuos != NULL && matriz->aproximados != NULL;
+}
+
+static void destruirMatrizConteo(MatrizConteo *matriz) {
+    tfree(matriz->residuos);
+    tfree(matriz->aproximados);
+}
+
+// Escala los valores aproximados por potencias de ESCALA_CONTEO para que su máximo quede entre 1 y ESCALA_CONTEO.
+static void normalizarAproximados(double *valores, const size_t cantidad, int *exponente) {
+    double maximo = 0;
+    for (size_t i = 0; i < cantidad; i++) {
+        if (valores[i] > maximo) {
+            maximo = valores[i];
+        }
+    }
+    while (maximo > ESCALA_CONTEO) {
+        for (size_t i = 0; i < cantidad; i++) {
+            valores[i] /= ESCALA_CONTEO;
+        }
+        maximo /= ESCALA_CONTEO;
+        *exponente += BITS_ESCALA_CONTEO;
+    }
+    // Al multiplicar valores escalados el máximo también puede quedar muy chico; se lo vuelve a subir para que no se anule.
+    while (maximo > 0 && maximo < 1.0) {
+        for (size_t i = 0; i < cantidad; i++) {
+            valores[i] *= ESCALA_CONTEO;
+        }
+        maximo *= ESCALA_CONTEO;
+        *exponente -= BITS_ESCALA_CONTEO;
+    }
+}
+
+// resultado = a * b. "resultado" no puede ser ninguno de los operandos.
+static void multiplicarMatricesConteo(const MatrizConteo *a, const MatrizConteo *b, MatrizConteo *resultado, const uint64_t modulo) {
+    const int n = a->dimension;
+    memset(resultado->residuos, 0, (size_t)n * n * sizeof(uint64_t));
+    memset(resultado->aproximados, 0, (size_t)n * n * sizeof(double));
+    for (int i = 0; i < n; i++) {
+        uint64_t *residuosFila = resultado->residuos + (size_t)i * n;
+        double *aproximadosFila = resultado->aproximados + (size_t)i * n;
+        for (int k = 0; k < n; k++) {
+            const uint64_t residuo = a->residuos[(size_t)i * n + k];
+            const double aproximado = a->aproximados[(size_t)i * n + k];
+            if (residuo == 0 && aproximado == 0) {
+                continue;
+            }
+            const uint64_t *residuosB = b->residuos + (size_t)k * n;
+            const double *aproximadosB = b->aproximados + (size_t)k * n;
+            for (int j = 0; j < n; j++) {
+                residuosFila[j] = sumarModulo(residuosFila[j], multiplicarModulo(residuo, residuosB[j], modulo), modulo);
+                aproximadosFila[j] += aproximado * aproximadosB[j];
+            }
+        }
+    }
+    resultado->exponente = a->exponente + b->exponente;
+    normalizarAproximados(resultado->aproximados, (size_t)n * n, &resultado->exponente);
+}
+
+// Vector columna de conteo: v' = m * v.
+static void multiplicarMatrizVector(const MatrizConteo *matriz, const uint64_t *residuos, const double *aproximados,
+                                    uint64_t *residuosResultado, double *aproximadosResultado, const uint64_t modulo) {
+    const int n = matriz->dimension;
+    for (int i = 0; i < n; i++) {
+        uint64_t residuo = 0;
+        double aproximado = 0;
+        for (int j = 0; j < n; j++) {
+            residuo = sumarModulo(residuo, multiplicarModulo(matriz->residuos[(size_t)i * n + j], residuos[j], modulo), modulo);
+            aproximado += matriz->aproximados[(size_t)i * n + j] * aproximados[j];
+        }
+        residuosResultado[i] = residuo;
+        aproximadosResultado[i] = aproximado;
+    }
+}
+
+// Barrido C[r + 1] = M * C[r] hasta "longitudMaxima". Si "salida" no es NULL escribe "longitud<TAB>cantidad" para cada longitud.
+static bool barrerConteo(const Automata *automata, const size_t longitudMaxima, const uint64_t modulo, FILE *salida, CantidadPalabras *ultima) {
+    const size_t estados = automata->cantidadEstados;
+    const int simbolos = automata->cantidadColumnas - 1;
+    uint64_t *residuos = tmalloc(2 * estados * sizeof(uint64_t), MEMORIA_CONTEO);
+    double *aproximados = tmalloc(2 * estados * sizeof(double), MEMORIA_CONTEO);
+    if (residuos == NULL || aproximados == NULL) {
+        memprinterr();
+        tfree(residuos);
+        tfree(aproximados);
+        return false;
+    }
+    uint64_t *residuosActuales = residuos, *residuosSiguientes = residuos + estados;
+    double *aproximadosActuales = aproximados, *aproximadosSiguientes = aproximados + estados;
+    for (size_t q = 0; q < estados; q++) {
+        residuosActuales[q] = automata->esFinal[q] && modulo != 1 ? 1 : 0;
+        aproximadosActuales[q] = automata->esFinal[q] ? 1.0 : 0.0;
+    }
+    int exponente = 0;
+    for (size_t longitud = 0; longitud <= longitudMaxima; longitud++) {
+        const CantidadPalabras cantidad = {residuosActuales[automata->estadoInicial], aproximadosActuales[automata->estadoInicial], exponente};
+        if (salida != NULL) {
+            fprintf(salida, "%zu\t", longitud);
+            mostrarCantidadPalabras(&cantidad, modulo, salida);
+            fputc('\n', salida);
+        }
+        if (longitud == longitudMaxima) {
+            *ultima = cantidad;
+            break;
+        }
+        // C[r + 1][q] = suma sobre los símbolos de C[r][d(q, a)].
+        for (size_t q = 0; q < estados; q++) {
+            const int32_t *transiciones = automata->transiciones + q * automata->cantidadColumnas;
+            uint64_t residuo = 0;
+            double aproximado = 0;
+            for (int columna = 0; columna < simbolos; columna++) {
+                residuo = sumarModulo(residuo, residuosActuales[transiciones[columna]], modulo);
+                aproximado += aproximadosActuales[transiciones[columna]];
+            }
+            residuosSiguientes[q] = residuo;
+            aproximadosSiguientes[q] = aproximado;
+        }
+        normalizarAproximados(aproximadosSiguientes, estados, &exponente);
+        uint64_t *auxiliarResiduos = residuosActuales;
+        residuosActuales = residuosSiguientes;
+        residuosSiguientes = auxiliarResiduos;
+        double *auxiliarAproximados = aproximadosActuales;
+        aproximadosActuales = aproximadosSiguientes;
+        aproximadosSiguientes = auxiliarAproximados;
+    }
+    tfree(residuos);
+    tfree(aproximados);
+    return true;
+}
+
+// Escribe "longitud<TAB>cantidad" para todas las longitudes de 0 a "longitudMaxima" con un único barrido.
+bool contarPalabrasHasta(const Automata *automata, const size_t longitudMaxima, const uint64_t modulo, FILE *salida) {
+    CantidadPalabras ultima;
+    const bool exito = barrerConteo(automata, longitudMaxima, modulo, salida, &ultima);
+    fflush(salida);
+    return exito;
+}
+
+// Cantidad de palabras de longitud exactamente "longitud", por exponenciación por cuadrados de la matriz de transferencia.
+// Si la longitud es chica frente a la cantidad de estados, el barrido es más barato y se usa ese.
+bool contarPalabrasLongitud(const Automata *automata, size_t longitud, const uint64_t modulo, CantidadPalabras *cantidad) {
+    const int n = automata->cantidadEstados;
+    const int simbolos = automata->cantidadColumnas - 1;
+    if (n > MAX_ESTADOS_MATRIZ_CONTEO || longitud <= (size_t)n * 64) {
+        return barrerConteo(automata, longitud, modulo, NULL, cantidad);
+    }
+    MatrizConteo potencia, producto;
+    const bool potenciaCreada = crearMatrizConteo(&potencia, n);
+    const bool productoCreado = crearMatrizConteo(&producto, n);
+    uint64_t *residuos = tmalloc(2 * (size_t)n * sizeof(uint64_t), MEMORIA_CONTEO);
+    double *aproximados = tmalloc(2 * (size_t)n * sizeof(double), MEMORIA_CONTEO);
+    const bool exito = potenciaCreada && productoCreado && residuos != NULL && aproximados != NULL;
+    if (exito) {
+        // El sumidero se deja afuera: no aporta palabras y, como crece más rápido que el resto, taparía sus valores aproximados.
+        for (int q = 0; q < n; q++) {
+            for (int columna = 0; q != ESTADO_SUMIDERO && columna < simbolos; columna++) {
+                const int32_t destino = automata->transiciones[(size_t)q * automata->cantidadColumnas + columna];
+                if (destino == ESTADO_SUMIDERO) {
+                    continue;
+                }
+                const size_t posicion = (size_t)q * n + destino;
+                potencia.residuos[posicion] = sumarModulo(potencia.residuos[posicion], modulo == 1 ? 0 : 1, modulo);
+                potencia.aproximados[posicion] += 1.0;
+            }
+            residuos[q] = automata->esFinal[q] && modulo != 1 ? 1 : 0;
+            aproximados[q] = automata->esFinal[q] ? 1.0 : 0.0;
+        }
+        // v = M^longitud * finales, aplicando las potencias M^(2^i) que correspondan a los bits de "longitud".
+        int exponenteVector = 0;
+        uint64_t *residuosAuxiliares = residuos + n;
+        double *aproximadosAuxiliares = aproximados + n;
+        while (longitud > 0) {
+            if (longitud & 1) {
+                multiplicarMatrizVector(&potencia, residuos, aproximados, residuosAuxiliares, aproximadosAuxiliares, modulo);
+                memcpy(residuos, residuosAuxiliares, (size_t)n * sizeof(uint64_t));
+                memcpy(aproximados, aproximadosAuxiliares, (size_t)n * sizeof(double));
+                exponenteVector += potencia.exponente;
+                normalizarAproximados(aproximados, n, &exponenteVector);
+            }
+            longitud >>= 1;
+            if (longitud > 0) {
+                multiplicarMatricesConteo(&potencia, &potencia, &producto, modulo);
+                const MatrizConteo auxiliar = potencia;
+                potencia = producto;
+                producto = auxiliar;
+            }
+        }
+        cantidad->residuo = residuos[automata->estadoInicial];
+        cantidad->mantisa = aproximados[automata->estadoInicial];
+        cantidad->exponente = exponenteVector;
+    } else {
+        memprinterr();
+    }
+    destruirMatrizConteo(&potencia);
+    destruirMatrizConteo(&producto);
+    tfree(residuos);
+    tfree(aproximados);
+    return exito;
+}
+
+void mostrarCantidadPalabras(const CantidadPalabras *cantidad, const uint64_t modulo, FILE *salida) {
+    if (modulo != 0) {
+        fprintf(salida, "%llu", (unsigned long long)cantidad->residuo);
+    } else if (cantidad->exponente == 0 && cantidad->mantisa < LIMITE_EXACTO_CONTEO) {
+        fprintf(salida, "%llu", (unsigned long long)cantidad->residuo);
+    } else {
+        mostrarCantidadAproximada(cantidad->mantisa, cantidad->exponente, salida);
+    }
+}
+
+// --- Equivalencia ---
+
+/*
+        Compara los lenguajes de dos gramáticas sin construir sus AFD completos.
+        Cada gramática se convierte en un AFN sobre un alfabeto común y se
+        determiniza de forma perezosa: la fila de un estado del AFD se calcula
+        recién cuando se la necesita. Sobre el producto de ambos AFD se hace un
+        BFS al estilo de Hopcroft–Karp: los estados de los dos lados se agrupan
+        con union-find y un par solo se explora si sus estados todavía estaban
+        en clases distintas. El primer par en el que un lado acepta y el otro no
+        da el contraejemplo, que por el BFS es una palabra de longitud mínima.
+        La inclusión L1 ⊆ L2 se verifica como la equivalencia de L1 ∪ L2 y L2
+        (el AFN de la unión es la unión disjunta de ambos AFN).
+ */
+
+// AFD construido a demanda a partir de un AFN: solo existen los estados alcanzados y solo tienen fila los expandidos.
+typedef struct {
+    AFN afn;
+    TablaConjuntos tabla;
+    int cantidadColumnas;
+    int capacidadEstados;
+    int32_t *transiciones;      // capacidadEstados * cantidadColumnas; la fila de un estado vale si "expandido" lo indica.
+    bool *expandido;
+    bool *esFinal;
+    int32_t estadoInicial;
+    uint64_t *siguientes;       // Conjuntos destino de cada columna al expandir un estado.
+} AFDPerezoso;
+
+typedef struct {
+    int32_t *padre;
+    int cantidadElementos;
+    int capacidadElementos;
+} ConjuntosDisjuntos;
+
+typedef struct {
+    int32_t estados[2];
+    int32_t anterior;           // Par desde el que se llegó a este (-1 para el par inicial).
+    int columna;                // Columna del símbolo leído desde el par anterior.
+} ParProducto;
+
+typedef struct {
+    AFDPerezoso *afds;
+    ConjuntosDisjuntos clases;  // El estado q del lado l es el elemento 2 * q + l.
+    ParProducto *pares;         // Cola del BFS; los pares ya explorados se conservan para reconstruir el contraejemplo.
+    int cantidadPares;
+    int capacidadPares;
+} ProductoPerezoso;
+
+// Arma un AFN que acepta la unión de los lenguajes de "a" y "b": los estados de "b" se numeran a continuación de los de "a".
+static bool unirAFN(const AFN *a, const AFN *b, AFN *resultado) {
+    const int aristasA = a->inicioAristas[a->cantidadEstados];
+    const int aristasB = b->inicioAristas[b->cantidadEstados];
+    resultado->cantidadEstados = a->cantidadEstados + b->cantidadEstados;
+    resultado->palabrasPorConjunto = palabrasConjunto(resultado->cantidadEstados);
+    resultado->inicioAristas = tmalloc((resultado->cantidadEstados + 1) * sizeof(int), MEMORIA_AUTOMATA);
+    resultado->aristas = tmalloc((aristasA + aristasB + 1) * sizeof(AristaAFN), MEMORIA_AUTOMATA);
+    resultado->iniciales = tcalloc(resultado->palabrasPorConjunto, sizeof(uint64_t), MEMORIA_AUTOMATA);
+    resultado->finales = tcalloc(resultado->palabrasPorConjunto, sizeof(uint64_t), MEMORIA_AUTOMATA);
+    if (resultado->inicioAristas == NULL || resultado->aristas == NULL || resultado->iniciales == NULL || resultado->finales == NULL) {
+        destruirAFN(resultado);
+        return false;
+    }
+    const int desplazamiento = a->cantidadEstados;
+    memcpy(resultado->inicioAristas, a->inicioAristas, a->cantidadEstados * sizeof(int));
+    for (int q = 0; q <= b->cantidadEstados; q++) {
+        resultado->inicioAristas[desplazamiento + q] = aristasA + b->inicioAristas[q];
+    }
+    memcpy(resultado->aristas, a->aristas, aristasA * sizeof(AristaAFN));
+    for (int i = 0; i < aristasB; i++) {
+        resultado->aristas[aristasA + i] = (AristaAFN){b->aristas[i].columna, desplazamiento + b->aristas[i].destino};
+    }
+    for (int q = 0; q < a->cantidadEstados; q++) {
+        if (contieneElemento(a->iniciales, q)) {
+            agregarElemento(resultado->iniciales, q);
+        }
+        if (contieneElemento(a->finales, q)) {
+            agregarElemento(resultado->finales, q);
+        }
+    }
+    for (int q = 0; q < b->cantidadEstados; q++) {
+        if (contieneElemento(b->iniciales, q)) {
+            agregarElemento(resultado->iniciales, desplazamiento + q);
+        }
+        if (contieneElemento(b->finales, q)) {
+            agregarElemento(resultado->finales, desplazamiento + q);
+        }
+    }
+    return true;
+}
 
-    printmsg("Generador de palabras aleatorias - Grupo 10\n\n");
+static void destruirAFDPerezoso(AFDPerezoso *afd) {
+    destruirAFN(&afd->afn);
+    tfree(afd->tabla.conjuntos);
+    tfree(afd->tabla.tabla);
+    tfree(afd->transiciones);
+    tfree(afd->expandido);
+    tfree(afd->esFinal);
+    tfree(afd->siguientes);
+}
 
-    Gramatica *gramatica = crearGramatica();
-    if (gramatica == NULL) {
+// Devuelve el estado asociado al conjunto, agregándolo sin expandir si no existía. Devuelve -1 si no se pudo agregar.
+static int agregarEstadoPerezoso(AFDPerezoso *afd, const uint64_t *conjunto) {
+    bool esNuevo;
+    const int estado = buscarOAgregarConjunto(&afd->tabla, conjunto, &esNuevo);
+    if (estado < 0) {
+        memprinterr();
+        return -1;
+    }
+    if (!esNuevo) {
+        return estado;
+    }
+    if (estado >= MAX_ESTADOS_AFD) {
+        printerr("El automata determinista supera los %d estados.\n", MAX_ESTADOS_AFD);
         return -1;
     }
+    if (estado == afd->capacidadEstados) {
+        const int nuevaCapacidad = afd->capacidadEstados * 2;
+        int32_t *nuevasTransiciones = trealloc(afd->transiciones, (size_t)nuevaCapacidad * afd->cantidadColumnas * sizeof(int32_t), MEMORIA_EQUIVALENCIA);
+        if (nuevasTransiciones != NULL) {
+            afd->transiciones = nuevasTransiciones;
+        }
+        bool *nuevosExpandidos = trealloc(afd->expandido, nuevaCapacidad * sizeof(bool), MEMORIA_EQUIVALENCIA);
+        if (nuevosExpandidos != NULL) {
+            afd->expandido = nuevosExpandidos;
+        }
+        bool *nuevosFinales = trealloc(afd->esFinal, nuevaCapacidad * sizeof(bool), MEMORIA_EQUIVALENCIA);
+        if (nuevosFinales != NULL) {
+            afd->esFinal = nuevosFinales;
+        }
+        if (nuevasTransiciones == NULL || nuevosExpandidos == NULL || nuevosFinales == NULL) {
+            memprinterr();
+            return -1;
+        }
+        afd->capacidadEstados = nuevaCapacidad;
+    }
+    bool esFinal = false;
+    for (int i = 0; i < afd->afn.palabrasPorConjunto; i++) {
+        esFinal |= (conjunto[i] & afd->afn.finales[i]) != 0;
+    }
+    afd->esFinal[estado] = esFinal;
+    afd->expandido[estado] = false;
+    return estado;
+}
+
+// "afd->afn" ya tiene que estar construido. Agrega el sumidero (conjunto vacío) y el estado inicial.
+static bool inicializarAFDPerezoso(AFDPerezoso *afd, const int cantidadColumnas) {
+    const int palabras = afd->afn.palabrasPorConjunto;
+    afd->cantidadColumnas = cantidadColumnas;
+    afd->capacidadEstados = 16;
+    afd->tabla = (TablaConjuntos){palabras, NULL, 0, 16, NULL, 0};
+    afd->tabla.conjuntos = tmalloc((size_t)afd->tabla.capacidadConjuntos * palabras * sizeof(uint64_t), MEMORIA_AUTOMATA);
+    afd->transiciones = tmalloc((size_t)afd->capacidadEstados * cantidadColumnas * sizeof(int32_t), MEMORIA_EQUIVALENCIA);
+    afd->expandido = tmalloc(afd->capacidadEstados * sizeof(bool), MEMORIA_EQUIVALENCIA);
+    afd->esFinal = tmalloc(afd->capacidadEstados * sizeof(bool), MEMORIA_EQUIVALENCIA);
+    afd->siguientes = tcalloc((size_t)cantidadColumnas * palabras, sizeof(uint64_t), MEMORIA_EQUIVALENCIA);
+    if (afd->tabla.conjuntos == NULL || afd->transiciones == NULL || afd->expandido == NULL || afd->esFinal == NULL ||
+        afd->siguientes == NULL || !redimensionarTablaConjuntos(&afd->tabla, 64)) {
+        memprinterr();
+        return false;
+    }
+    // "siguientes" todavía está en cero: su primer conjunto es el vacío, que queda como estado 0.
+    if (agregarEstadoPerezoso(afd, afd->siguientes) != ESTADO_SUMIDERO) {
+        return false;
+    }
+    afd->estadoInicial = agregarEstadoPerezoso(afd, afd->afn.iniciales);
+    return afd->estadoInicial >= 0;
+}
 
-    if (esGramaticaRegular(gramatica)) {
-        mostrarGramatica(gramatica);
-        generarPalabraAleatoria(gramatica);
+// Devuelve la fila de transiciones del estado, calculándola si hace falta. La fila deja de valer al expandir otro estado.
+static const int32_t *obtenerFilaPerezosa(AFDPerezoso *afd, const int estado) {
+    const int palabras = afd->afn.palabrasPorConjunto;
+    const int columnas = afd->cantidadColumnas;
+    if (!afd->expandido[estado]) {
+        const AFN *afn = &afd->afn;
+        const uint64_t *conjunto = &afd->tabla.conjuntos[(size_t)estado * palabras];
+        memset(afd->siguientes, 0, (size_t)columnas * palabras * sizeof(uint64_t));
+        // Los conjuntos alcanzados suelen ser chicos: se recorren solo los bits encendidos.
+        for (int i = 0; i < palabras; i++) {
+            for (uint64_t bits = conjunto[i]; bits != 0; bits &= bits - 1) {
+                const int q = i * 64 + __builtin_ctzll(bits);
+                for (int a = afn->inicioAristas[q]; a < afn->inicioAristas[q + 1]; a++) {
+                    agregarElemento(&afd->siguientes[(size_t)afn->aristas[a].columna * palabras], afn->aristas[a].destino);
+                }
+            }
+        }
+        // A partir de acá "conjunto" puede quedar invalidado si la tabla crece.
+        for (int columna = 0; columna < columnas - 1; columna++) {
+            const int destino = agregarEstadoPerezoso(afd, &afd->siguientes[(size_t)columna * palabras]);
+            if (destino < 0) {
+                return NULL;
+            }
+            afd->transiciones[(size_t)estado * columnas + columna] = destino;
+        }
+        afd->transiciones[(size_t)estado * columnas + columnas - 1] = ESTADO_SUMIDERO;
+        afd->expandido[estado] = true;
+    }
+    return &afd->transiciones[(size_t)estado * columnas];
+}
+
+static bool asegurarElementos(ConjuntosDisjuntos *clases, const int cantidad) {
+    if (cantidad > clases->capacidadElementos) {
+        int nuevaCapacidad = clases->capacidadElementos > 0 ? clases->capacidadElementos : 64;
+        while (nuevaCapacidad < cantidad) {
+            nuevaCapacidad *= 2;
+        }
+        int32_t *nuevoPadre = trealloc(clases->padre, nuevaCapacidad * sizeof(int32_t), MEMORIA_EQUIVALENCIA);
+        if (nuevoPadre == NULL) {
+            return false;
+        }
+        clases->padre = nuevoPadre;
+        clases->capacidadElementos = nuevaCapacidad;
+    }
+    for (; clases->cantidadElementos < cantidad; clases->cantidadElementos++) {
+        clases->padre[clases->cantidadElementos] = clases->cantidadElementos;
+    }
+    return true;
+}
+
+// Busca el representante de la clase acortando el camino a la mitad (cada elemento pasa a apuntar a su abuelo).
+static int32_t buscarRepresentante(ConjuntosDisjuntos *clases, int32_t elemento) {
+    int32_t *padre = clases->padre;
+    while (padre[elemento] != elemento) {
+        padre[elemento] = padre[padre[elemento]];
+        elemento = padre[elemento];
+    }
+    return elemento;
+}
+
+// Si los estados del par no estaban en la misma clase, las une y encola el par. "distingue" indica si un lado acepta y el otro no.
+static bool visitarPar(ProductoPerezoso *producto, const int32_t estados[2], const int32_t anterior, const int columna, bool *distingue) {
+    *distingue = false;
+    const int32_t elementos[2] = {2 * estados[0], 2 * estados[1] + 1};
+    if (!asegurarElementos(&producto->clases, (elementos[0] > elementos[1] ? elementos[0] : elementos[1]) + 1)) {
+        memprinterr();
+        return false;
+    }
+    const int32_t representantes[2] = {buscarRepresentante(&producto->clases, elementos[0]), buscarRepresentante(&producto->clases, elementos[1])};
+    if (representantes[0] == representantes[1]) {
+        return true;
+    }
+    producto->clases.padre[representantes[0]] = representantes[1];
+    if (producto->cantidadPares == producto->capacidadPares) {
+        const int nuevaCapacidad = producto->capacidadPares > 0 ? producto->capacidadPares * 2 : 64;
+        ParProducto *nuevosPares = trealloc(producto->pares, nuevaCapacidad * sizeof(ParProducto), MEMORIA_EQUIVALENCIA);
+        if (nuevosPares == NULL) {
+            memprinterr();
+            return false;
+        }
+        producto->pares = nuevosPares;
+        producto->capacidadPares = nuevaCapacidad;
+    }
+    producto->pares[producto->cantidadPares++] = (ParProducto){{estados[0], estados[1]}, anterior, columna};
+    *distingue = producto->afds[0].esFinal[estados[0]] != producto->afds[1].esFinal[estados[1]];
+    return true;
+}
+
+// Reconstruye la palabra que lleva del par inicial al último par encolado siguiendo los pares anteriores.
+static bool reconstruirContraejemplo(const ProductoPerezoso *producto, const char *simbolos, ResultadoComparacion *resultado) {
+    const int ultimo = producto->cantidadPares - 1;
+    size_t longitud = 0;
+    for (int32_t par = ultimo; producto->pares[par].anterior >= 0; par = producto->pares[par].anterior) {
+        longitud++;
+    }
+    resultado->contraejemplo = tmalloc(longitud + 1, MEMORIA_EQUIVALENCIA);
+    if (resultado->contraejemplo == NULL) {
+        memprinterr();
+        return false;
+    }
+    resultado->contraejemplo[longitud] = '\0';
+    resultado->longitudContraejemplo = longitud;
+    for (int32_t par = ultimo; producto->pares[par].anterior >= 0; par = producto->pares[par].anterior) {
+        resultado->contraejemplo[--longitud] = simbolos[producto->pares[par].columna];
+    }
+    resultado->perteneceAPrimera = producto->afds[0].esFinal[producto->pares[ultimo].estados[0]];
+    return true;
+}
+
+// BFS sobre el producto de los dos AFD perezosos. La última columna (bytes fuera del alfabeto) lleva siempre al sumidero y no se explora.
+static EstadoComparacion explorarProducto(AFDPerezoso afds[2], const Automata *alfabeto, ResultadoComparacion *resultado) {
+    ProductoPerezoso producto = {afds, {NULL, 0, 0}, NULL, 0, 0};
+    const int32_t iniciales[2] = {afds[0].estadoInicial, afds[1].estadoInicial};
+    bool distingue;
+    bool exito = visitarPar(&producto, iniciales, -1, 0, &distingue);
+    for (int32_t actual = 0; exito && !distingue && actual < producto.cantidadPares; actual++) {
+        const int32_t estados[2] = {producto.pares[actual].estados[0], producto.pares[actual].estados[1]};
+        const int32_t *filas[2] = {obtenerFilaPerezosa(&afds[0], estados[0]), obtenerFilaPerezosa(&afds[1], estados[1])};
+        exito = filas[0] != NULL && filas[1] != NULL;
+        for (int columna = 0; exito && !distingue && columna < alfabeto->cantidadColumnas - 1; columna++) {
+            const int32_t destinos[2] = {filas[0][columna], filas[1][columna]};
+            exito = visitarPar(&producto, destinos, actual, columna, &distingue);
+        }
+    }
+    EstadoComparacion estado = COMPARACION_ERROR;
+    if (exito) {
+        resultado->paresExplorados = producto.cantidadPares;
+        if (!distingue) {
+            estado = COMPARACION_SE_CUMPLE;
+        } else if (reconstruirContraejemplo(&producto, alfabeto->simbolos, resultado)) {
+            estado = COMPARACION_NO_SE_CUMPLE;
+        }
+    }
+    tfree(producto.clases.padre);
+    tfree(producto.pares);
+    return estado;
+}
+
+EstadoComparacion compararLenguajes(const GramaticaCompilada *primera, const GramaticaCompilada *segunda,
+                                    const RelacionLenguajes relacion, ResultadoComparacion *resultado) {
+    memset(resultado, 0, sizeof(ResultadoComparacion));
+    // Ambos AFN se arman sobre el mismo alfabeto para que sus columnas coincidan.
+    Automata alfabeto;
+    memset(&alfabeto, 0, sizeof(Automata));
+    bool usado[256] = {false};
+    marcarTerminales(primera, usado);
+    marcarTerminales(segunda, usado);
+    AFDPerezoso afds[2];
+    memset(afds, 0, sizeof(afds));
+    AFN afnPrimera;
+    memset(&afnPrimera, 0, sizeof(AFN));
+    bool exito = asignarAlfabeto(usado, &alfabeto) && construirAFN(primera, &alfabeto, &afnPrimera) &&
+                 construirAFN(segunda, &alfabeto, &afds[1].afn);
+    if (exito && relacion == RELACION_INCLUSION) {
+        exito = unirAFN(&afnPrimera, &afds[1].afn, &afds[0].afn);
+        destruirAFN(&afnPrimera);
+    } else {
+        afds[0].afn = afnPrimera;
+    }
+    if (!exito) {
+        memprinterr();
+    }
+    EstadoComparacion estado = COMPARACION_ERROR;
+    if (exito && inicializarAFDPerezoso(&afds[0], alfabeto.cantidadColumnas) &&
+        inicializarAFDPerezoso(&afds[1], alfabeto.cantidadColumnas)) {
+        estado = explorarProducto(afds, &alfabeto, resultado);
+    }
+    for (int lado = 0; lado < 2; lado++) {
+        resultado->estadosConstruidos[lado] = afds[lado].tabla.cantidadConjuntos;
+        destruirAFDPerezoso(&afds[lado]);
+    }
+    tfree(alfabeto.simbolos);
+    return estado;
+}
+
+void liberarResultadoComparacion(ResultadoComparacion *resultado) {
+    tfree(resultado->contraejemplo);
+    resultado->contraejemplo = NULL;
+}
+
+// --- Linea de comandos ---
+
+typedef enum {
+    MODO_DERIVACION,        // Genera una única palabra mostrando su derivación.
+    MODO_GENERACION,        // Genera "cantidadPalabras" palabras sin mostrar derivaciones.
+    MODO_RECONOCIMIENTO,    // Indica para cada cadena de stdin si pertenece al lenguaje.
+    MODO_ENUMERACION,       // Lista todas las palabras hasta "longitudMaxima" en orden shortlex.
+    MODO_CONTEO,            // Cuenta las palabras de longitud "longitudConteo" (o de todas las longitudes hasta ella).
+    MODO_COMPARACION,       // Compara el lenguaje con el de la gramática de referencia ("relacion").
+    MODO_BUSQUEDA,          // Lista las subcadenas de "archivoBusqueda" que pertenecen al lenguaje.
+    MODO_CODIGO,            // Escribe en "archivoCodigo" un programa en C especializado en la gramática.
+    MODO_BENCHMARK,         // Mide cada etapa sobre gramáticas sintéticas (no lee ninguna gramática).
+    MODO_SERVIDOR           // Atiende pedidos de stdin con las gramáticas en memoria (ver ejecutarServidor).
+} ModoEjecucion;
+
+typedef struct {
+    ModoEjecucion modo;
+    size_t cantidadPalabras;
+    uint64_t semilla;
+    int cantidadHilos;
+    bool reportarMemoria;
+    bool mostrarEstadisticas;
+    bool fijarLongitud;         // Si es true, las palabras se muestrean uniformemente entre las de longitud "longitudPalabras".
+    size_t longitudPalabras;
+    size_t longitudMaxima;
+    FormatoBenchmark formatoBenchmark;
+    size_t longitudConteo;
+    bool contarHasta;
+    uint64_t moduloConteo;      // 0 para contar sin módulo.
+    // Origen de la gramática: un archivo, los argumentos o (si no se indica ninguno) stdin de forma interactiva.
+    const char *archivoGramaticas;
+    const char *simbolosNoTerminales;
+    const char *simbolosTerminales;
+    const char *producciones;
+    const char *axioma;
+    // Gramática compilada en formato binario: se guarda después de compilar o se carga en lugar de leer una gramática.
+    const char *archivoCompiladoSalida;
+    const char *archivoCompiladoEntrada;
+    // Caché de gramáticas compiladas (capacidadCache == 0 la desactiva).
+    int capacidadCache;
+    const char *directorioCache;
+    bool generarEnFlujo;        // Con -n, escribe los terminales a medida que se derivan (ver generarPalabrasEnFlujo).
+    // Gramática de referencia del modo de comparación: la primera del archivo, compilada en main.
+    const char *archivoReferencia;
+    RelacionLenguajes relacion;
+    GramaticaCompilada *referencia;
+    const char *archivoBusqueda;
+    const char *archivoCodigo;
+} Opciones;
+
+void mostrarUso(const char *programa) {
+    fprintf(stderr, "Uso: %s [-g archivo | -N no-terminales -T terminales -P producciones -A axioma | --cargar archivo]\n", programa);
+    fprintf(stderr, "          [-n cantidad | --reconocer | --enumerar k | --contar n | --contar-hasta k |\n");
+    fprintf(stderr, "           --equivalente archivo | --incluida archivo | --buscar archivo]\n");
+    fprintf(stderr, "          [-l longitud] [--modulo m] [-s semilla] [-t hilos] [--memoria] [--estadisticas]\n");
+    fprintf(stderr, "          [--cache n] [--cache-dir directorio]\n");
+    fprintf(stderr, "     %s [-N no-terminales -T terminales -P producciones -A axioma] --guardar archivo\n", programa);
+    fprintf(stderr, "     %s [-g archivo | -N ... -A axioma | --cargar archivo] --generar-c archivo\n", programa);
+    fprintf(stderr, "     %s --benchmark csv|json\n", programa);
+    fprintf(stderr, "     %s --servidor [-t hilos] [-s semilla]\n", programa);
+    fprintf(stderr, "  -g archivo    Lee una o mas gramaticas de un archivo (\"-\" para stdin) sin hacer preguntas.\n");
+    fprintf(stderr, "  -N, -T, -P, -A Indican la gramatica en los argumentos (por ej. -N ST -T ab -P \"S->aT,T->b\" -A S).\n");
+    fprintf(stderr, "                 Los no terminales son mayusculas o nombres entre <> (por ej. -N \"<Inicio><Fin>\").\n");
+    fprintf(stderr, "  --guardar archivo Valida y compila la gramatica y la guarda (con su automata) en formato binario.\n");
+    fprintf(stderr, "  --cargar archivo  Usa una gramatica guardada con --guardar, sin volver a leerla ni validarla.\n");
+    fprintf(stderr, "  --cache n     Guarda hasta n gramaticas compiladas; las que se repiten (salvo por el orden) no se vuelven a compilar.\n");
+    fprintf(stderr, "  --cache-dir directorio Respalda la cache en un directorio (un archivo por gramatica) entre ejecuciones.\n");
+    fprintf(stderr, "  --generar-c archivo Escribe (\"-\" para stdout) un programa en C con un generador y un reconocedor\n");
+    fprintf(stderr, "                especializados en la gramatica; con -n y -s genera las mismas palabras que este programa.\n");
+    fprintf(stderr, "  --benchmark   Mide parseo, validacion, compilacion y generacion sobre gramaticas sinteticas.\n");
+    fprintf(stderr, "  --servidor    Atiende pedidos de stdin (\"<id> gramatica|descartar|validar|generar|reconocer ...\")\n");
+    fprintf(stderr, "                y responde en stdout con marcos \"<id> datos|ok|error <bytes>\" seguidos de los datos.\n");
+    fprintf(stderr, "  -n cantidad   Genera la cantidad indicada de palabras (una por linea) sin mostrar derivaciones.\n");
+    fprintf(stderr, "  --reconocer   Luego de la gramatica lee cadenas de stdin (una por linea) e imprime 1 si pertenecen al lenguaje o 0 si no.\n");
+    fprintf(stderr, "  --enumerar k  Lista todas las palabras de longitud hasta k (una por linea, en orden shortlex).\n");
+    fprintf(stderr, "  --contar n    Cuenta las palabras de longitud n (exponenciando la matriz de transferencia).\n");
+    fprintf(stderr, "  --contar-hasta k Cuenta las palabras de cada longitud de 0 a k (\"longitud<TAB>cantidad\").\n");
+    fprintf(stderr, "  --equivalente archivo Indica si el lenguaje es igual al de la primera gramatica del archivo;\n");
+    fprintf(stderr, "                si no lo es, muestra la palabra mas corta que pertenece a uno solo de los dos.\n");
+    fprintf(stderr, "  --incluida archivo Indica si el lenguaje esta incluido en el de la primera gramatica del archivo.\n");
+    fprintf(stderr, "  --buscar archivo Lista las subcadenas del archivo que pertenecen al lenguaje (\"desplazamiento<TAB>subcadena\"),\n");
+    fprintf(stderr, "                de izquierda a derecha y la mas larga de las que empiezan en cada lugar.\n");
+    fprintf(stderr, "  --modulo m    Muestra las cantidades modulo m (hasta 2^63); sin modulo, las que no entran en 63 bits se aproximan.\n");
+    fprintf(stderr, "  -l longitud   Elige las palabras de manera uniforme entre todas las de esa longitud.\n");
+    fprintf(stderr, "  -s semilla    Semilla del generador aleatorio (por defecto se toma de la hora actual).\n");
+    fprintf(stderr, "  -t hilos      Cantidad de hilos para generar (por defecto, uno por nucleo).\n");
+    fprintf(stderr, "  --flujo       Con -n, escribe cada palabra mientras se deriva, en un hilo y con memoria constante.\n");
+    fprintf(stderr, "  --memoria     Al finalizar muestra el uso de memoria por subsistema.\n");
+    fprintf(stderr, "  --estadisticas Muestra el tamanio del automata minimo de la gramatica.\n");
+}
+
+bool parsearNumero(const char *cadena, size_t *resultado) {
+    // strtoull acepta espacios y signos al principio y satura en vez de fallar, asi que se exige
+    // un digito inicial y se rechazan los valores fuera de rango.
+    if (cadena == NULL || *cadena < '0' || *cadena > '9') {
+        return false;
+    }
+    char *fin;
+    errno = 0;
+    const unsigned long long valor = strtoull(cadena, &fin, 10);
+    if (*fin != '\0' || errno == ERANGE || (size_t)valor != valor) {
+        return false;
+    }
+    *resultado = (size_t)valor;
+    return true;
+}
+
+bool parsearArgumentos(const int argc, char *argv[], Opciones *opciones) {
+    opciones->modo = MODO_DERIVACION;
+    opciones->cantidadPalabras = 0;
+    opciones->semilla = (uint64_t)time(NULL) ^ ((uint64_t)clock() << 32);
+    opciones->cantidadHilos = obtenerCantidadNucleos();
+    opciones->reportarMemoria = false;
+    opciones->mostrarEstadisticas = false;
+    opciones->fijarLongitud = false;
+    opciones->longitudPalabras = 0;
+    opciones->longitudMaxima = 0;
+    opciones->formatoBenchmark = FORMATO_CSV;
+    opciones->longitudConteo = 0;
+    opciones->contarHasta = false;
+    opciones->moduloConteo = 0;
+    opciones->archivoGramaticas = NULL;
+    opciones->simbolosNoTerminales = NULL;
+    opciones->simbolosTerminales = NULL;
+    opciones->producciones = NULL;
+    opciones->axioma = NULL;
+    opciones->archivoCompiladoSalida = NULL;
+    opciones->archivoCompiladoEntrada = NULL;
+    opciones->capacidadCache = 0;
+    opciones->directorioCache = NULL;
+    opciones->generarEnFlujo = false;
+    opciones->archivoReferencia = NULL;
+    opciones->relacion = RELACION_EQUIVALENCIA;
+    opciones->referencia = NULL;
+    opciones->archivoBusqueda = NULL;
+    opciones->archivoCodigo = NULL;
+    for (int i = 1; i < argc; i++) {
+        size_t valor;
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            if (!parsearNumero(argv[++i], &opciones->cantidadPalabras) || opciones->cantidadPalabras == 0) {
+                printerr("Cantidad de palabras invalida: %s\n", argv[i]);
+                return false;
+            }
+            opciones->modo = MODO_GENERACION;
+        } else if (strcmp(argv[i], "--reconocer") == 0) {
+            opciones->modo = MODO_RECONOCIMIENTO;
+        } else if (strcmp(argv[i], "--enumerar") == 0 && i + 1 < argc) {
+            if (!parsearNumero(argv[++i], &opciones->longitudMaxima)) {
+                printerr("Longitud invalida: %s\n", argv[i]);
+                return false;
+            }
+            opciones->modo = MODO_ENUMERACION;
+        } else if ((strcmp(argv[i], "--contar") == 0 || strcmp(argv[i], "--contar-hasta") == 0) && i + 1 < argc) {
+            opciones->contarHasta = strcmp(argv[i], "--contar-hasta") == 0;
+            if (!parsearNumero(argv[++i], &opciones->longitudConteo)) {
+                printerr("Longitud invalida: %s\n", argv[i]);
+                return false;
+            }
+            opciones->modo = MODO_CONTEO;
+        } else if ((strcmp(argv[i], "--equivalente") == 0 || strcmp(argv[i], "--incluida") == 0) && i + 1 < argc) {
+            opciones->relacion = strcmp(argv[i], "--incluida") == 0 ? RELACION_INCLUSION : RELACION_EQUIVALENCIA;
+            opciones->archivoReferencia = argv[++i];
+            opciones->modo = MODO_COMPARACION;
+        } else if (strcmp(argv[i], "--buscar") == 0 && i + 1 < argc) {
+            opciones->archivoBusqueda = argv[++i];
+            opciones->modo = MODO_BUSQUEDA;
+        } else if (strcmp(argv[i], "--generar-c") == 0 && i + 1 < argc) {
+            opciones->archivoCodigo = argv[++i];
+            opciones->modo = MODO_CODIGO;
+        } else if (strcmp(argv[i], "--modulo") == 0 && i + 1 < argc) {
+            if (!parsearNumero(argv[++i], &valor) || valor == 0 || (uint64_t)valor > ((uint64_t)1 << 63)) {
+                printerr("Modulo invalido: %s\n", argv[i]);
+                return false;
+            }
+            opciones->moduloConteo = valor;
+        } else if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "csv") == 0) {
+                opciones->formatoBenchmark = FORMATO_CSV;
+            } else if (strcmp(argv[i], "json") == 0) {
+                opciones->formatoBenchmark = FORMATO_JSON;
+            } else {
+                printerr("Formato de benchmark invalido: %s\n", argv[i]);
+                return false;
+            }
+            opciones->modo = MODO_BENCHMARK;
+        } else if (strcmp(argv[i], "--servidor") == 0) {
+            opciones->modo = MODO_SERVIDOR;
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            if (!parsearNumero(argv[++i], &opciones->longitudPalabras)) {
+                printerr("Longitud invalida: %s\n", argv[i]);
+                return false;
+            }
+            opciones->fijarLongitud = true;
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            if (!parsearNumero(argv[++i], &valor)) {
+                printerr("Semilla invalida: %s\n", argv[i]);
+                return false;
+            }
+            opciones->semilla = valor;
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            if (!parsearNumero(argv[++i], &valor) || valor < 1 || valor > MAX_HILOS) {
+                printerr("Cantidad de hilos invalida: %s\n", argv[i]);
+                return false;
+            }
+            opciones->cantidadHilos = (int)valor;
+        } else if (strcmp(argv[i], "--flujo") == 0) {
+            opciones->generarEnFlujo = true;
+        } else if (strcmp(argv[i], "--memoria") == 0) {
+            opciones->reportarMemoria = true;
+        } else if (strcmp(argv[i], "--estadisticas") == 0) {
+            opciones->mostrarEstadisticas = true;
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            opciones->archivoGramaticas = argv[++i];
+        } else if (strcmp(argv[i], "--guardar") == 0 && i + 1 < argc) {
+            opciones->archivoCompiladoSalida = argv[++i];
+        } else if (strcmp(argv[i], "--cargar") == 0 && i + 1 < argc) {
+            opciones->archivoCompiladoEntrada = argv[++i];
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            if (!parsearNumero(argv[++i], &valor) || valor < 1 || valor > INT32_MAX / 2) {
+                printerr("Capacidad de cache invalida: %s\n", argv[i]);
+                return false;
+            }
+            opciones->capacidadCache = (int)valor;
+        } else if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc) {
+            opciones->directorioCache = argv[++i];
+        } else if (strcmp(argv[i], "-N") == 0 && i + 1 < argc) {
+            opciones->simbolosNoTerminales = argv[++i];
+        } else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+            opciones->simbolosTerminales = argv[++i];
+        } else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc) {
+            opciones->producciones = argv[++i];
+        } else if (strcmp(argv[i], "-A") == 0 && i + 1 < argc) {
+            opciones->axioma = argv[++i];
+        } else {
+            printerr("Argumento desconocido: %s\n", argv[i]);
+            return false;
+        }
+    }
+    const bool algunCampo = opciones->simbolosNoTerminales != NULL || opciones->simbolosTerminales != NULL ||
+                            opciones->producciones != NULL || opciones->axioma != NULL;
+    const bool todosLosCampos = opciones->simbolosNoTerminales != NULL && opciones->simbolosTerminales != NULL &&
+                                opciones->producciones != NULL && opciones->axioma != NULL;
+    if (algunCampo && (!todosLosCampos || opciones->archivoGramaticas != NULL)) {
+        printerr("Para indicar la gramatica en los argumentos se necesitan -N, -T, -P y -A (y no se puede usar -g).\n");
+        return false;
+    }
+    if (opciones->archivoCompiladoEntrada != NULL && (algunCampo || opciones->archivoGramaticas != NULL || opciones->archivoCompiladoSalida != NULL)) {
+        printerr("La opcion --cargar no se puede combinar con -g, -N, -T, -P, -A ni --guardar.\n");
+        return false;
+    }
+    if (opciones->archivoCompiladoSalida != NULL && (opciones->archivoGramaticas != NULL || opciones->modo != MODO_DERIVACION || opciones->fijarLongitud)) {
+        printerr("La opcion --guardar solo guarda una gramatica indicada con -N, -T, -P y -A o de forma interactiva.\n");
+        return false;
+    }
+    if (opciones->fijarLongitud && opciones->modo != MODO_DERIVACION && opciones->modo != MODO_GENERACION) {
+        printerr("La opcion -l solo se puede usar al generar palabras.\n");
+        return false;
+    }
+    if (opciones->generarEnFlujo && (opciones->modo != MODO_GENERACION || opciones->fijarLongitud)) {
+        printerr("La opcion --flujo solo se puede usar con -n (y sin -l).\n");
+        return false;
+    }
+    if (opciones->directorioCache != NULL && opciones->capacidadCache == 0) {
+        opciones->capacidadCache = CAPACIDAD_CACHE_POR_DEFECTO;
+    }
+    return true;
+}
+
+// Genera palabras de la longitud pedida: una sola en el modo de derivación o "cantidadPalabras" en el de generación.
+bool generarPalabrasDeLongitud(const Opciones *opciones, const Automata *automata) {
+    MuestreadorLongitud *muestreador = crearMuestreadorLongitud(automata, opciones->longitudPalabras);
+    if (muestreador == NULL) {
+        return false;
+    }
+    bool exito = hayPalabrasDeLongitud(muestreador);
+    if (!exito) {
+        printerr("El lenguaje no tiene palabras de longitud %zu\n", opciones->longitudPalabras);
+    } else {
+        mostrarCantidadPalabrasLongitud(muestreador, stderr);
+        const size_t cantidad = opciones->modo == MODO_GENERACION ? opciones->cantidadPalabras : 1;
+        exito = generarPalabrasEnSalida(muestrearPalabras, muestreador, cantidad, opciones->semilla, opciones->cantidadHilos, stdout);
+    }
+    destruirMuestreadorLongitud(muestreador);
+    return exito;
+}
+
+bool enumerarPalabras(const Opciones *opciones, const Automata *automata) {
+    Enumerador *enumerador = crearEnumerador(automata, opciones->longitudMaxima);
+    if (enumerador == NULL) {
+        return false;
+    }
+    const bool exito = enumerarPalabrasEnSalida(enumerador, opciones->cantidadHilos, stdout);
+    destruirEnumerador(enumerador);
+    return exito;
+}
+
+bool buscarPalabras(const Opciones *opciones, const Automata *automata) {
+    Buscador *buscador = crearBuscador(automata);
+    if (buscador == NULL) {
+        return false;
+    }
+    const bool exito = buscarEnArchivo(buscador, opciones->archivoBusqueda, opciones->cantidadHilos, stdout);
+    destruirBuscador(buscador);
+    return exito;
+}
+
+bool generarCodigo(const Opciones *opciones, const GramaticaCompilada *compilada, const Automata *automata) {
+    if (esLenguajeVacio(compilada)) {
+        printerr("El axioma no deriva ninguna palabra: el lenguaje de la gramatica es vacio.\n");
+        return false;
+    }
+    const bool esStdout = strcmp(opciones->archivoCodigo, "-") == 0;
+    FILE *archivo = esStdout ? stdout : fopen(opciones->archivoCodigo, "w");
+    if (archivo == NULL) {
+        printerr("No se pudo crear el archivo: %s\n", opciones->archivoCodigo);
+        return false;
+    }
+    bool exito = escribirCodigoC(compilada, automata, archivo);
+    if (!esStdout) {
+        exito = fclose(archivo) == 0 && exito;
+    }
+    if (exito) {
+        fprintf(stderr, "Programa en C escrito en %s (%d filas en el generador, %d estados en el reconocedor)\n",
+                opciones->archivoCodigo, compilada->cantidadNoTerminales, automata->cantidadEstados - 1);
+    } else {
+        printerr("No se pudo escribir el programa en C.\n");
+    }
+    return exito;
+}
+
+bool contarPalabras(const Opciones *opciones, const Automata *automata) {
+    const double inicio = obtenerTiempoSegundos();
+    bool exito;
+    if (opciones->contarHasta) {
+        exito = contarPalabrasHasta(automata, opciones->longitudConteo, opciones->moduloConteo, stdout);
+    } else {
+        CantidadPalabras cantidad;
+        exito = contarPalabrasLongitud(automata, opciones->longitudConteo, opciones->moduloConteo, &cantidad);
+        if (exito) {
+            printf("%zu\t", opciones->longitudConteo);
+            mostrarCantidadPalabras(&cantidad, opciones->moduloConteo, stdout);
+            printf("\n");
+            fflush(stdout);
+        }
+    }
+    fprintf(stderr, "Conteo en %.3f s\n", obtenerTiempoSegundos() - inicio);
+    return exito;
+}
+
+// Compara el lenguaje de la gramática con el de la referencia. Que la relación no se cumpla es un resultado, no un error.
+EstadoComparacion compararConReferencia(const Opciones *opciones, const GramaticaCompilada *compilada) {
+    const double inicio = obtenerTiempoSegundos();
+    ResultadoComparacion resultado;
+    const EstadoComparacion estado = compararLenguajes(compilada, opciones->referencia, opciones->relacion, &resultado);
+    if (estado == COMPARACION_ERROR) {
+        liberarResultadoComparacion(&resultado);
+        return estado;
+    }
+    const bool esInclusion = opciones->relacion == RELACION_INCLUSION;
+    fprintf(stderr, "Comparacion en %.3f s: %d pares explorados, %d y %d estados construidos\n", obtenerTiempoSegundos() - inicio,
+            resultado.paresExplorados, resultado.estadosConstruidos[0], resultado.estadosConstruidos[1]);
+    if (estado == COMPARACION_SE_CUMPLE) {
+        printf("%s\n", esInclusion ? "incluida" : "equivalentes");
     } else {
+        printf("%s\n", esInclusion ? "no incluida" : "distintas");
+        if (resultado.longitudContraejemplo == 0) {
+            printf("%c\n", EPSILON);
+        } else {
+            printf("%s\n", resultado.contraejemplo);
+        }
+        fprintf(stderr, "La palabra de longitud %zu la genera %s.\n", resultado.longitudContraejemplo,
+                resultado.perteneceAPrimera ? "la gramatica pero no la de referencia" : "la gramatica de referencia pero no esta");
+    }
+    fflush(stdout);
+    liberarResultadoComparacion(&resultado);
+    return estado;
+}
+
+bool mostrarLongitudEsperada(const GramaticaCompilada *compilada) {
+    double longitudEsperada;
+    if (!calcularLongitudEsperada(compilada, &longitudEsperada)) {
+        memprinterr();
+        return false;
+    }
+    fprintf(stderr, "Longitud esperada de las palabras: %.3f\n", longitudEsperada);
+    return true;
+}
+
+// Si "automataCompilado" es NULL, el autómata se construye solo en los modos que lo necesitan.
+bool ejecutarModo(const Opciones *opciones, const GramaticaCompilada *compilada, const Automata *automataCompilado) {
+    const bool usaAutomata = opciones->modo == MODO_RECONOCIMIENTO || opciones->modo == MODO_ENUMERACION ||
+                             opciones->modo == MODO_CONTEO || opciones->modo == MODO_BUSQUEDA ||
+                             opciones->modo == MODO_CODIGO || opciones->fijarLongitud;
+    if (usaAutomata || opciones->mostrarEstadisticas) {
+        Automata *construido = automataCompilado == NULL ? construirAutomata(compilada) : NULL;
+        const Automata *automata = automataCompilado != NULL ? automataCompilado : construido;
+        if (automata == NULL) {
+            return false;
+        }
+        if (opciones->mostrarEstadisticas) {
+            if (!mostrarLongitudEsperada(compilada)) {
+                destruirAutomata(construido);
+                return false;
+            }
+            mostrarEstadisticasAutomata(automata, stderr);
+        }
+        bool exito = true;
+        if (opciones->modo == MODO_RECONOCIMIENTO) {
+            exito = reconocerEntrada(automata, stdin, stdout);
+        } else if (opciones->modo == MODO_ENUMERACION) {
+            exito = enumerarPalabras(opciones, automata);
+        } else if (opciones->modo == MODO_CONTEO) {
+            exito = contarPalabras(opciones, automata);
+        } else if (opciones->modo == MODO_BUSQUEDA) {
+            exito = buscarPalabras(opciones, automata);
+        } else if (opciones->modo == MODO_CODIGO) {
+            exito = generarCodigo(opciones, compilada, automata);
+        } else if (opciones->fijarLongitud) {
+            exito = generarPalabrasDeLongitud(opciones, automata);
+            INSTRUMENTAR(reportarInstrumentacion(compilada, stderr);)
+        }
+        destruirAutomata(construido);
+        if (usaAutomata) {
+            return exito;
+        }
+    }
+    if (opciones->modo == MODO_COMPARACION) {
+        return compararConReferencia(opciones, compilada) != COMPARACION_ERROR;
+    }
+    if (esLenguajeVacio(compilada)) {
+        printerr("El axioma no deriva ninguna palabra: el lenguaje de la gramatica es vacio.\n");
+        return false;
+    }
+    if (opciones->modo == MODO_GENERACION) {
+        if (compilada->esPonderada && !mostrarLongitudEsperada(compilada)) {
+            return false;
+        }
+        const bool exito = opciones->generarEnFlujo
+                           ? generarPalabrasEnFlujo(compilada, opciones->cantidadPalabras, opciones->semilla, stdout)
+                           : generarPalabrasEnSalida(generarPalabrasGramatica, compilada, opciones->cantidadPalabras, opciones->semilla, opciones->cantidadHilos, stdout);
+        INSTRUMENTAR(reportarInstrumentacion(compilada, stderr);)
+        return exito;
+    }
+    GeneradorAleatorio generador;
+    sembrarGenerador(&generador, opciones->semilla);
+    char *palabra = generarPalabraAleatoria(compilada, &generador, true);
+    tfree(palabra);
+    return palabra != NULL;
+}
+
+// Informa el análisis de la gramática y la guarda (--guardar) o ejecuta el modo elegido. "automata" puede ser NULL.
+bool ejecutarGramaticaCompilada(const Opciones *opciones, const GramaticaCompilada *compilada, const Automata *automata) {
+    mostrarAnalisisGramatica(compilada, stderr);
+    if (opciones->archivoCompiladoSalida == NULL) {
+        return ejecutarModo(opciones, compilada, automata);
+    }
+    Automata *construido = automata == NULL ? construirAutomata(compilada) : NULL;
+    const bool exito = (automata != NULL || construido != NULL) &&
+                       guardarGramaticaCompilada(opciones->archivoCompiladoSalida, compilada, automata != NULL ? automata : construido);
+    destruirAutomata(construido);
+    if (exito) {
+        fprintf(stderr, "Gramatica compilada guardada en %s\n", opciones->archivoCompiladoSalida);
+    }
+    return exito;
+}
+
+// Valida, compila y ejecuta el modo elegido sobre una gramática. Si "mostrar" es true se imprime la gramática.
+bool procesarGramatica(const Opciones *opciones, const Gramatica *gramatica, const bool mostrar) {
+    if (!esGramaticaRegular(gramatica)) {
         printerr("La gramatica ingresada no es regular\n");
+        return false;
+    }
+    if (mostrar) {
+        mostrarGramatica(gramatica);
+    }
+    GramaticaCompilada *compilada = compilarGramatica(gramatica);
+    if (compilada == NULL) {
+        return false;
+    }
+    const bool exito = ejecutarGramaticaCompilada(opciones, compilada, NULL);
+    destruirGramaticaCompilada(compilada);
+    return exito;
+}
+
+// Procesa una gramática leída de un archivo o de los argumentos, a través de la caché si está activa.
+bool procesarDescripcion(const Opciones *opciones, CacheGramaticas *cache, const DescripcionGramatica *descripcion) {
+    if (cache == NULL) {
+        Gramatica *gramatica = crearGramaticaDesdeCadenas(descripcion->simbolosNoTerminales, descripcion->simbolosTerminales,
+                                                          descripcion->producciones, descripcion->axioma);
+        if (gramatica == NULL) {
+            return false;
+        }
+        const bool exito = procesarGramatica(opciones, gramatica, false);
+        destruirGramatica(gramatica);
+        return exito;
+    }
+    const EntradaCache *entrada = obtenerGramaticaCompilada(cache, descripcion);
+    return entrada != NULL && ejecutarGramaticaCompilada(opciones, entrada->compilada, entrada->automata);
+}
+
+// Ejecuta el modo elegido sobre una gramática guardada con --guardar.
+bool procesarGramaticaCargada(const Opciones *opciones) {
+    GramaticaCargada cargada;
+    if (!cargarGramaticaCompilada(opciones->archivoCompiladoEntrada, &cargada)) {
+        return false;
+    }
+    const bool exito = ejecutarGramaticaCompilada(opciones, &cargada.compilada, &cargada.automata);
+    cerrarGramaticaCargada(&cargada);
+    return exito;
+}
+
+bool procesarArchivoGramaticas(const Opciones *opciones, CacheGramaticas *cache) {
+    const bool esStdin = strcmp(opciones->archivoGramaticas, "-") == 0;
+    FILE *archivo = esStdin ? stdin : fopen(opciones->archivoGramaticas, "r");
+    if (archivo == NULL) {
+        printerr("No se pudo abrir el archivo: %s\n", opciones->archivoGramaticas);
+        return false;
+    }
+    LectorGramaticas lector;
+    inicializarLectorGramaticas(&lector, archivo);
+    int leidas = 0, procesadas = 0;
+    DescripcionGramatica descripcion;
+    bool hayErrores;
+    while (leerSiguienteGramatica(&lector, &descripcion, &hayErrores)) {
+        leidas++;
+        if (hayErrores) {
+            printerr("La gramatica %d del archivo tiene errores.\n", leidas);
+            continue;
+        }
+        if (procesarDescripcion(opciones, cache, &descripcion)) {
+            procesadas++;
+        } else {
+            printerr("No se pudo procesar la gramatica %d del archivo.\n", leidas);
+        }
+    }
+    liberarLectorGramaticas(&lector);
+    if (!esStdin) {
+        fclose(archivo);
+    }
+    fprintf(stderr, "Gramaticas leidas: %d, procesadas correctamente: %d\n", leidas, procesadas);
+    return leidas > 0 && procesadas == leidas;
+}
+
+// Lee, valida y compila la primera gramática del archivo de referencia del modo de comparación.
+GramaticaCompilada *compilarGramaticaReferencia(const char *ruta) {
+    FILE *archivo = fopen(ruta, "r");
+    if (archivo == NULL) {
+        printerr("No se pudo abrir el archivo: %s\n", ruta);
+        return NULL;
+    }
+    LectorGramaticas lector;
+    inicializarLectorGramaticas(&lector, archivo);
+    GramaticaCompilada *compilada = NULL;
+    DescripcionGramatica descripcion;
+    bool hayErrores;
+    if (!leerSiguienteGramatica(&lector, &descripcion, &hayErrores) || hayErrores) {
+        printerr("El archivo %s no tiene una gramatica de referencia valida.\n", ruta);
+    } else {
+        Gramatica *gramatica = crearGramaticaDesdeCadenas(descripcion.simbolosNoTerminales, descripcion.simbolosTerminales,
+                                                          descripcion.producciones, descripcion.axioma);
+        if (gramatica != NULL && !esGramaticaRegular(gramatica)) {
+            printerr("La gramatica de referencia no es regular\n");
+        } else if (gramatica != NULL) {
+            compilada = compilarGramatica(gramatica);
+        }
+        destruirGramatica(gramatica);
+    }
+    liberarLectorGramaticas(&lector);
+    fclose(archivo);
+    return compilada;
+}
+
+// Ejecuta el modo elegido sobre la gramática cargada, las del archivo o los argumentos, o la ingresada de forma interactiva.
+int procesarGramaticas(const Opciones *opciones) {
+    if (opciones->archivoCompiladoEntrada != NULL) {
+        return procesarGramaticaCargada(opciones) ? 0 : -1;
+    }
+
+    if (opciones->archivoGramaticas != NULL || opciones->simbolosNoTerminales != NULL) {
+        CacheGramaticas *cache = NULL;
+        if (opciones->capacidadCache > 0) {
+            cache = crearCacheGramaticas(opciones->capacidadCache, opciones->directorioCache);
+            if (cache == NULL) {
+                return -1;
+            }
+        }
+        bool exito;
+        if (opciones->archivoGramaticas != NULL) {
+            exito = procesarArchivoGramaticas(opciones, cache);
+        } else {
+            const DescripcionGramatica descripcion = {opciones->simbolosNoTerminales, opciones->simbolosTerminales,
+                                                      opciones->producciones, opciones->axioma};
+            exito = procesarDescripcion(opciones, cache, &descripcion);
+        }
+        if (cache != NULL) {
+            mostrarEstadisticasCache(cache, stderr);
+            destruirCacheGramaticas(cache);
+        }
+        return exito ? 0 : -1;
+    }
+
+    printmsg("Generador de palabras aleatorias - Grupo 10\n\n");
+    Gramatica *gramatica = crearGramatica();
+    if (gramatica == NULL) {
+        return -1;
     }
 
+    const bool exito = procesarGramatica(opciones, gramatica, true);
+
     destruirGramatica(gramatica);
-    return 0;
+    return opciones->modo == MODO_COMPARACION && !exito ? -1 : 0;
+}
+
+int main(const int argc, char *argv[]) {
+
+    Opciones opciones;
+    if (!parsearArgumentos(argc, argv, &opciones)) {
+        mostrarUso(argv[0]);
+        return -1;
+    }
+
+    if (opciones.reportarMemoria) {
+        atexit(reportarMemoria);
+    }
+
+    if (opciones.modo == MODO_BENCHMARK) {
+        return ejecutarBenchmark(opciones.formatoBenchmark, stdout) ? 0 : -1;
+    }
+
+    if (opciones.modo == MODO_SERVIDOR) {
+        return ejecutarServidor(opciones.cantidadHilos, opciones.semilla, stdin, stdout) ? 0 : -1;
+    }
+
+    if (opciones.modo == MODO_COMPARACION) {
+        opciones.referencia = compilarGramaticaReferencia(opciones.archivoReferencia);
+        if (opciones.referencia == NULL) {
+            return -1;
+        }
+    }
+
+    const int codigo = procesarGramaticas(&opciones);
+    destruirGramaticaCompilada(opciones.referencia);
+    return codigo;
 }
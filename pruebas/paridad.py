@@ -0,0 +1,314 @@
+#!/usr/bin/env python3
+"""
+Pruebas de paridad de gramatica.exe (se corren con "make check").
+
+Uso: python3 pruebas/paridad.py gramatica.exe gramatica-pruebas.exe
+
+El segundo ejecutable se compila con fragmentos de búsqueda chicos para que
+textos de pocos KB crucen muchos bordes entre fragmentos.
+
+    - Código generado: para gramáticas lineales por derecha, por izquierda,
+      con pesos y con nombres entre <>, compila con -O3 el programa de
+      --generar-c y compara su salida con la de gramatica.exe para -n/-s y
+      para --reconocer.
+    - Contraejemplos: --equivalente e --incluida deben responder como la
+      enumeración por fuerza bruta de ambos lenguajes y, si no se cumplen,
+      mostrar una palabra de la diferencia de longitud mínima.
+    - Búsqueda: --buscar debe devolver las mismas coincidencias (la que empieza
+      más a la izquierda y, entre esas, la más larga) que la fuerza bruta sobre
+      la gramática y que el módulo re de Python sobre expresiones equivalentes.
+
+Las gramáticas aleatorias salen de una semilla fija, así que una falla se puede
+reproducir. Sale con 1 si alguna comprobación falla.
+"""
+
+import itertools
+import os
+import random
+import re
+import subprocess
+import sys
+import tempfile
+
+SEMILLA = 2024
+LONGITUD_FUERZA_BRUTA = 9
+SEPARADOR = 'x'                 # Nunca es terminal: corta las coincidencias en el texto de búsqueda.
+
+# Gramáticas fijas (no terminales, terminales, producciones, axioma) con una expresión regular del mismo lenguaje.
+CASOS_FIJOS = [
+    (('S', 'ab', 'S->aS,S->bS,S->a', 'S'), r'[ab]*a'),
+    (('ST', 'ab', 'S->aT,T->bS,T->b', 'S'), r'(ab)+'),
+    (('ST', 'abc', 'S->aS,S->bT,S->b,T->cT,T->c', 'S'), r'a*bc*'),
+    (('ST', 'ab', 'S->Sa,S->Tb,T->Tb,T->a', 'S'), r'ab+a*'),
+    (('SAB', 'abc', 'S->Ac,S->Bc,A->Aa,A->a,B->Bb,B->b', 'S'), r'(a+|b+)c'),
+    (('S', 'ab', 'S->aS:3,S->bS:0.5,S->b:1', 'S'), r'[ab]*b'),
+    (('<Palabra><Resto>', 'abc', '<Palabra>->a<Resto>,<Resto>->b<Resto>,<Resto>->c', '<Palabra>'), r'ab*c'),
+    (('<Num><Cola>', 'ab', '<Num>-><Cola>a:2,<Num>->b:1,<Cola>-><Num>b:1.5', '<Num>'), r'b(ba)*'),
+]
+
+fallas = 0
+
+
+def fallar(*mensaje):
+    global fallas
+    fallas += 1
+    print('FALLA:', *mensaje)
+
+
+# --- Gramáticas ---
+
+def simbolos(texto):
+    return re.findall(r'<[^>]*>|.', texto)
+
+
+def producciones(gramatica):
+    noTerminales = set(simbolos(gramatica[0]))
+    resultado = []
+    for produccion in gramatica[2].split(','):
+        cabeza, cuerpo = produccion.split('->')
+        cuerpo = simbolos(cuerpo.split(':')[0])
+        resultado.append((cabeza, cuerpo, [s in noTerminales for s in cuerpo]))
+    return resultado
+
+
+def argumentos(gramatica):
+    noTerminales, terminales, producciones, axioma = gramatica
+    return ['-N', noTerminales, '-T', terminales, '-P', producciones, '-A', axioma]
+
+
+def aleatoria(r, izquierda):
+    noTerminales = ''.join(r.sample('SABCDE', r.randint(1, 5)))
+    if 'S' not in noTerminales:
+        noTerminales = 'S' + noTerminales[1:]
+    terminales = ''.join(r.sample('abc', r.randint(1, 3)))
+    lista = []
+    for cabeza in noTerminales:
+        for _ in range(r.randint(0, 3)):
+            terminal = r.choice(terminales)
+            if r.random() < 0.7:
+                siguiente = r.choice(noTerminales)
+                lista.append(cabeza + '->' + (siguiente + terminal if izquierda else terminal + siguiente))
+            else:
+                lista.append(cabeza + '->' + terminal)
+    lista = list(dict.fromkeys(lista)) or ['S->' + terminales[0]]
+    return noTerminales, terminales, ','.join(lista), 'S'
+
+
+def conPesos(r, gramatica):
+    lista = [p + ':' + str(r.choice([1, 2, 0.5, 3.25, 7])) for p in gramatica[2].split(',')]
+    return gramatica[0], gramatica[1], ','.join(lista), gramatica[3]
+
+
+def conNombres(r, gramatica):
+    # Cambia cada no terminal por un nombre entre <> y desordena las producciones: el lenguaje no cambia.
+    nombres = {x: '<' + x.strip('<>') + 'v' + str(r.randint(0, 99)) + '>' for x in simbolos(gramatica[0])}
+    renombrar = lambda texto: ''.join(nombres.get(s, s) for s in simbolos(texto))
+    lista = [renombrar(p) for p in gramatica[2].split(',')]
+    r.shuffle(lista)
+    return renombrar(gramatica[0]), gramatica[1], ','.join(lista), nombres[gramatica[3]]
+
+
+def esIzquierda(gramatica):
+    return any(len(cuerpo) == 2 and marcas[0] for _, cuerpo, marcas in producciones(gramatica))
+
+
+def lenguaje(gramatica, longitud):
+    lista = producciones(gramatica)
+    memoria = {}
+
+    def derivar(noTerminal, n):
+        if (noTerminal, n) not in memoria:
+            palabras = set()
+            for cabeza, cuerpo, marcas in lista:
+                if cabeza != noTerminal:
+                    continue
+                if len(cuerpo) == 1:
+                    if n == 1:
+                        palabras.add(cuerpo[0])
+                elif n >= 2:
+                    if marcas[0]:
+                        palabras |= {w + cuerpo[1] for w in derivar(cuerpo[0], n - 1)}
+                    else:
+                        palabras |= {cuerpo[0] + w for w in derivar(cuerpo[1], n - 1)}
+            memoria[(noTerminal, n)] = frozenset(palabras)
+        return memoria[(noTerminal, n)]
+
+    return set().union(*(derivar(gramatica[3], n) for n in range(1, longitud + 1)))
+
+
+def reconocedor(gramatica):
+    # Simula el AFN de la gramática: hacia adelante si es lineal por derecha y hacia atrás si es por izquierda.
+    izquierda = esIzquierda(gramatica)
+    transiciones = {}
+    for cabeza, cuerpo, _ in producciones(gramatica):
+        terminal = cuerpo[-1] if izquierda else cuerpo[0]
+        destino = (cuerpo[0] if izquierda else cuerpo[1]) if len(cuerpo) == 2 else None
+        transiciones.setdefault((cabeza, terminal), set()).add(destino)
+
+    def pertenece(palabra):
+        actuales = {gramatica[3]}
+        for i, c in enumerate(reversed(palabra) if izquierda else palabra):
+            ultimo = i == len(palabra) - 1
+            siguientes = set()
+            for estado in actuales:
+                for destino in transiciones.get((estado, c), ()):
+                    if destino is None:
+                        if ultimo:
+                            return True
+                    else:
+                        siguientes.add(destino)
+            actuales = siguientes
+            if not actuales:
+                return False
+        return False
+
+    return pertenece
+
+
+def ejecutar(comando, entrada=None):
+    return subprocess.run(comando, input=entrada, capture_output=True)
+
+
+# --- Código generado ---
+
+def probarCodigo(programa, gramatica, directorio, r):
+    fuente = os.path.join(directorio, 'generado.c')
+    ejecutable = os.path.join(directorio, 'generado')
+    if ejecutar([programa] + argumentos(gramatica) + ['--generar-c', fuente]).returncode != 0:
+        return False
+    compilador = os.environ.get('CC', 'gcc')
+    compilacion = ejecutar([compilador, '-O3', '-Wall', '-Wextra', '-Werror', '-o', ejecutable, fuente])
+    if compilacion.returncode != 0:
+        fallar('no compila el codigo generado', gramatica, compilacion.stderr.decode()[:500])
+        return True
+    for cantidad in (10, 1000, 70000):
+        semilla = str(r.randint(0, 10 ** 12))
+        hilos = str(r.randint(1, 4))
+        esperado = ejecutar([programa] + argumentos(gramatica) + ['-n', str(cantidad), '-s', semilla, '-t', hilos]).stdout
+        obtenido = ejecutar([ejecutable, '-n', str(cantidad), '-s', semilla]).stdout
+        if esperado != obtenido:
+            fallar('-n', cantidad, '-s', semilla, '-t', hilos, 'difiere del codigo generado', gramatica)
+    palabras = [''.join(p) for k in range(6) for p in itertools.product(gramatica[1] + SEPARADOR, repeat=k)]
+    entrada = '\n'.join(w + ('\r' if r.random() < 0.2 else '') for w in palabras).encode()
+    esperado = ejecutar([programa] + argumentos(gramatica) + ['--reconocer'], entrada).stdout
+    obtenido = ejecutar([ejecutable, '--reconocer'], entrada).stdout
+    if esperado != obtenido or esperado.count(b'\n') != len(palabras):
+        fallar('--reconocer difiere del codigo generado', gramatica)
+    return True
+
+
+# --- Contraejemplos ---
+
+def probarComparacion(programa, gramatica, referencia, directorio):
+    archivo = os.path.join(directorio, 'referencia.txt')
+    with open(archivo, 'w') as f:
+        f.write('no-terminales: %s\nterminales: %s\nproducciones: %s\naxioma: %s\n' % referencia)
+    propio = lenguaje(gramatica, LONGITUD_FUERZA_BRUTA)
+    ajeno = lenguaje(referencia, LONGITUD_FUERZA_BRUTA)
+    for opcion, diferencia, cumple in (('--equivalente', propio ^ ajeno, 'equivalentes'), ('--incluida', propio - ajeno, 'incluida')):
+        proceso = ejecutar([programa] + argumentos(gramatica) + [opcion, archivo])
+        salida = proceso.stdout.decode().split('\n')
+        if proceso.returncode != 0:
+            fallar(opcion, 'termino con', proceso.returncode, gramatica, referencia, proceso.stderr.decode())
+        elif salida[0] == cumple:
+            if diferencia:
+                fallar(opcion, 'dice', cumple, 'pero difieren en', sorted(diferencia, key=len)[:3], gramatica, referencia)
+        else:
+            palabra = '' if salida[1] == '@' else salida[1]
+            if diferencia:
+                minima = min(len(w) for w in diferencia)
+                if palabra not in diferencia or len(palabra) != minima:
+                    fallar(opcion, 'contraejemplo', repr(palabra), 'no es de longitud minima', minima, gramatica, referencia)
+            elif len(palabra) <= LONGITUD_FUERZA_BRUTA:
+                fallar(opcion, 'contraejemplo', repr(palabra), 'inexistente', gramatica, referencia)
+
+
+# --- Búsqueda ---
+
+def coincidencias(texto, pertenece):
+    # Fuerza bruta de "grep -o": el primer inicio con alguna coincidencia y, desde ahí, el fin más lejano.
+    resultado = []
+    posicion = 0
+    while posicion < len(texto):
+        encontrada = None
+        for inicio in range(posicion, len(texto)):
+            corte = texto.find(SEPARADOR, inicio)
+            for fin in range(len(texto) if corte < 0 else corte, inicio, -1):
+                if pertenece(texto[inicio:fin]):
+                    encontrada = (inicio, fin)
+                    break
+            if encontrada:
+                break
+        if not encontrada:
+            break
+        resultado.append(encontrada)
+        posicion = encontrada[1]
+    return resultado
+
+
+def probarBusqueda(programas, gramatica, pertenece, directorio, r):
+    longitud = r.choice([50, 300, 2000])
+    probabilidadSeparador = r.choice([0.01, 0.05, 0.2])
+    texto = ''.join(SEPARADOR if r.random() < probabilidadSeparador else r.choice(gramatica[1]) for _ in range(longitud))
+    archivo = os.path.join(directorio, 'texto.txt')
+    with open(archivo, 'w') as f:
+        f.write(texto)
+    esperado = coincidencias(texto, pertenece)
+    for programa in programas:
+        for hilos in (1, 3, 8):
+            proceso = ejecutar([programa] + argumentos(gramatica) + ['--buscar', archivo, '-t', str(hilos)])
+            obtenido = []
+            for linea in proceso.stdout.decode().split('\n')[:-1]:
+                desplazamiento, palabra = linea.split('\t', 1)
+                obtenido.append((int(desplazamiento), int(desplazamiento) + len(palabra)))
+            if proceso.returncode != 0 or obtenido != esperado:
+                fallar('--buscar', os.path.basename(programa), '-t', hilos, gramatica, 'texto de', longitud, 'bytes:',
+                       'se esperaban', len(esperado), 'coincidencias y hubo', len(obtenido))
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__.strip().split('\n')[2])
+        return 2
+    programa = os.path.abspath(sys.argv[1])
+    fragmentado = os.path.abspath(sys.argv[2])
+    r = random.Random(SEMILLA)
+    aleatorias = []
+    for i in range(40):
+        gramatica = aleatoria(r, i % 2 == 1)
+        if i % 4 >= 2:
+            gramatica = conPesos(r, gramatica)
+        if i % 8 >= 4:
+            gramatica = conNombres(r, gramatica)
+        aleatorias.append(gramatica)
+
+    with tempfile.TemporaryDirectory() as directorio:
+        compiladas = 0
+        for gramatica in [g for g, _ in CASOS_FIJOS] + aleatorias:
+            compiladas += probarCodigo(programa, gramatica, directorio, r)
+        print('Codigo generado: %d gramaticas' % compiladas)
+
+        for gramatica in aleatorias:
+            otra = r.choice([aleatoria(r, r.random() < 0.3), conNombres(r, gramatica), gramatica])
+            probarComparacion(programa, gramatica, otra, directorio)
+            probarComparacion(programa, otra, gramatica, directorio)
+        print('Contraejemplos: %d pares' % len(aleatorias))
+
+        for gramatica, expresion in CASOS_FIJOS:
+            patron = re.compile(expresion)
+            palabras = {''.join(p) for k in range(1, LONGITUD_FUERZA_BRUTA + 1) for p in itertools.product(gramatica[1], repeat=k)}
+            if {w for w in palabras if patron.fullmatch(w)} != lenguaje(gramatica, LONGITUD_FUERZA_BRUTA):
+                fallar('la expresion', expresion, 'no describe el lenguaje de', gramatica)
+            pertenece = lambda palabra: patron.fullmatch(palabra) is not None
+            for _ in range(4):
+                probarBusqueda([programa, fragmentado], gramatica, pertenece, directorio, r)
+        for gramatica in aleatorias:
+            probarBusqueda([fragmentado], gramatica, reconocedor(gramatica), directorio, r)
+        print('Busqueda: %d gramaticas' % (len(CASOS_FIJOS) + len(aleatorias)))
+
+    print('Fallas: %d' % fallas)
+    return 1 if fallas else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
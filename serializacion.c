@@ -0,0 +1,325 @@
+#include "serializacion.h"
+
+/*
+        Formato binario de una gramática validada y compilada, junto con su
+        autómata mínimo, para no volver a leerla, validarla ni compilarla en
+        cada ejecución. Después de un encabezado fijo vienen las mismas tablas
+        que se usan en memoria, cada una alineada a 8 bytes, así que al cargar
+        el archivo con mmap las estructuras apuntan directamente a él: no se
+        copia nada y solo se leen las páginas que se usan. Las tablas quedan
+        con la representación de la máquina que las escribió, por lo que el
+        encabezado lleva una versión y una marca de orden de bytes, y el
+        tamaño de cada sección se compara con el que corresponde a las
+        estructuras de este programa. Un checksum de todo lo que sigue a su
+        campo rechaza los archivos truncados o modificados.
+ */
+
+#define MAGIA_SERIALIZACION "SSLG10GC"
+#define VERSION_SERIALIZACION 3
+#define MARCA_ORDEN_BYTES 0x01020304u
+#define ALINEACION_SERIALIZACION 8
+
+typedef enum {
+    SECCION_INICIO_FILA,
+    SECCION_PRODUCCIONES,
+    SECCION_TRANSICIONES,
+    SECCION_PROBABILIDAD_ALIAS,
+    SECCION_ALIAS,
+    SECCION_SIMBOLOS,
+    SECCION_TRANSICIONES_AUTOMATA,
+    SECCION_FINALES,
+    SECCION_CONJUNTOS,
+    SECCION_INICIO_NOMBRES,
+    SECCION_NOMBRES,
+    CANTIDAD_SECCIONES
+} SeccionSerializada;
+
+typedef struct {
+    uint64_t desplazamiento;    // Desde el inicio del archivo.
+    uint64_t tamanio;
+} UbicacionSeccion;
+
+typedef struct {
+    char magia[8];
+    uint32_t version;
+    uint32_t marcaOrden;
+    uint64_t tamanioArchivo;
+    uint64_t checksum;          // De todo lo que sigue a este campo (el resto del encabezado y las secciones).
+    // Gramática compilada.
+    int32_t cantidadNoTerminales;
+    int32_t cantidadProducciones;
+    int32_t axioma;
+    int32_t produccionesDescartadas;
+    int32_t cantidadNombres;
+    int32_t palabrasPorConjunto;
+    uint64_t longitudNombres;
+    uint8_t esLinealAIzquierda;
+    uint8_t esPonderada;
+    // Autómata.
+    int32_t cantidadEstados;
+    int32_t cantidadColumnas;
+    int32_t estadoInicial;
+    int32_t estadosAFN;
+    int32_t estadosSinMinimizar;
+    uint16_t clase[256];
+    UbicacionSeccion secciones[CANTIDAD_SECCIONES];
+} EncabezadoSerializado;
+
+static size_t alinearSeccion(const size_t desplazamiento) {
+    return (desplazamiento + ALINEACION_SERIALIZACION - 1) & ~(size_t)(ALINEACION_SERIALIZACION - 1);
+}
+
+static uint64_t calcularChecksum(const unsigned char *datos, const size_t tamanio) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= tamanio; i += sizeof(uint64_t)) {
+        uint64_t palabra;
+        memcpy(&palabra, datos + i, sizeof(palabra));
+        hash = (hash ^ palabra) * 0x100000001B3ULL;
+        hash ^= hash >> 29;
+    }
+    for (; i < tamanio; i++) {
+        hash = (hash ^ datos[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// El checksum cubre desde el campo siguiente al checksum hasta el final del archivo.
+static uint64_t checksumArchivo(const unsigned char *datos, const size_t tamanio) {
+    const size_t inicio = offsetof(EncabezadoSerializado, checksum) + sizeof(uint64_t);
+    return calcularChecksum(datos + inicio, tamanio - inicio);
+}
+
+// Tamaño en bytes que debe tener cada sección según los contadores del encabezado.
+static void calcularTamaniosSecciones(const EncabezadoSerializado *encabezado, const bool conAlias, uint64_t *tamanios) {
+    const uint64_t producciones = (uint64_t)encabezado->cantidadProducciones;
+    const uint64_t estados = (uint64_t)encabezado->cantidadEstados;
+    tamanios[SECCION_INICIO_FILA] = ((uint64_t)encabezado->cantidadNoTerminales + 1) * sizeof(int);
+    tamanios[SECCION_PRODUCCIONES] = producciones * sizeof(Produccion);
+    tamanios[SECCION_TRANSICIONES] = producciones * sizeof(Transicion);
+    tamanios[SECCION_PROBABILIDAD_ALIAS] = conAlias ? producciones * sizeof(double) : 0;
+    tamanios[SECCION_ALIAS] = conAlias ? producciones * sizeof(int) : 0;
+    tamanios[SECCION_SIMBOLOS] = (uint64_t)encabezado->cantidadColumnas - 1;
+    tamanios[SECCION_TRANSICIONES_AUTOMATA] = estados * (uint64_t)encabezado->cantidadColumnas * sizeof(int32_t);
+    tamanios[SECCION_FINALES] = estados * sizeof(bool);
+    tamanios[SECCION_CONJUNTOS] = 3 * (uint64_t)encabezado->palabrasPorConjunto * sizeof(uint64_t);
+    tamanios[SECCION_INICIO_NOMBRES] = (uint64_t)encabezado->cantidadNombres * sizeof(int);
+    tamanios[SECCION_NOMBRES] = encabezado->longitudNombres;
+}
+
+bool guardarGramaticaCompilada(const char *ruta, const GramaticaCompilada *compilada, const Automata *automata) {
+    EncabezadoSerializado encabezado;
+    memset(&encabezado, 0, sizeof(encabezado));
+    memcpy(encabezado.magia, MAGIA_SERIALIZACION, sizeof(encabezado.magia));
+    encabezado.version = VERSION_SERIALIZACION;
+    encabezado.marcaOrden = MARCA_ORDEN_BYTES;
+    encabezado.cantidadNoTerminales = compilada->cantidadNoTerminales;
+    encabezado.cantidadProducciones = compilada->cantidadProducciones;
+    encabezado.axioma = compilada->axioma;
+    encabezado.produccionesDescartadas = compilada->produccionesDescartadas;
+    encabezado.cantidadNombres = compilada->cantidadNombres;
+    encabezado.palabrasPorConjunto = compilada->palabrasPorConjunto;
+    encabezado.longitudNombres = compilada->longitudNombres;
+    encabezado.esLinealAIzquierda = compilada->esLinealAIzquierda;
+    encabezado.esPonderada = compilada->esPonderada;
+    encabezado.cantidadEstados = automata->cantidadEstados;
+    encabezado.cantidadColumnas = automata->cantidadColumnas;
+    encabezado.estadoInicial = automata->estadoInicial;
+    encabezado.estadosAFN = automata->estadosAFN;
+    encabezado.estadosSinMinimizar = automata->estadosSinMinimizar;
+    memcpy(encabezado.clase, automata->clase, sizeof(encabezado.clase));
+
+    const void *secciones[CANTIDAD_SECCIONES] = {
+        compilada->inicioFila, compilada->producciones, compilada->transiciones, compilada->probabilidadAlias,
+        compilada->alias, automata->simbolos, automata->transiciones, automata->esFinal,
+        compilada->usados, compilada->inicioNombre, compilada->nombres
+    };
+    uint64_t tamanios[CANTIDAD_SECCIONES];
+    calcularTamaniosSecciones(&encabezado, compilada->alias != NULL, tamanios);
+    size_t desplazamiento = alinearSeccion(sizeof(encabezado));
+    for (int seccion = 0; seccion < CANTIDAD_SECCIONES; seccion++) {
+        encabezado.secciones[seccion] = (UbicacionSeccion){desplazamiento, tamanios[seccion]};
+        desplazamiento = alinearSeccion(desplazamiento + (size_t)tamanios[seccion]);
+    }
+    encabezado.tamanioArchivo = desplazamiento;
+
+    unsigned char *contenido = tcalloc(desplazamiento, 1, MEMORIA_SERIALIZACION);
+    if (contenido == NULL) {
+        memprinterr();
+        return false;
+    }
+    for (int seccion = 0; seccion < CANTIDAD_SECCIONES; seccion++) {
+        if (tamanios[seccion] > 0) {
+            memcpy(contenido + encabezado.secciones[seccion].desplazamiento, secciones[seccion], (size_t)tamanios[seccion]);
+        }
+    }
+    memcpy(contenido, &encabezado, sizeof(encabezado));
+    encabezado.checksum = checksumArchivo(contenido, desplazamiento);
+    memcpy(contenido + offsetof(EncabezadoSerializado, checksum), &encabezado.checksum, sizeof(encabezado.checksum));
+
+    FILE *archivo = fopen(ruta, "wb");
+    bool exito = archivo != NULL && fwrite(contenido, 1, desplazamiento, archivo) == desplazamiento;
+    if (archivo != NULL) {
+        exito &= fclose(archivo) == 0;
+    }
+    tfree(contenido);
+    if (!exito) {
+        printerr("No se pudo escribir el archivo: %s\n", ruta);
+        return false;
+    }
+    return true;
+}
+
+// Verifica que los contadores tengan sentido y que cada sección esté alineada, dentro del archivo y con el tamaño esperado.
+static bool esEncabezadoConsistente(const EncabezadoSerializado *encabezado, const size_t tamanioArchivo) {
+    if (encabezado->cantidadNoTerminales < 1 || encabezado->cantidadNombres < 1 ||
+        encabezado->cantidadNoTerminales > encabezado->cantidadNombres + 1 ||
+        encabezado->palabrasPorConjunto != palabrasConjunto(encabezado->cantidadNombres + 1) || encabezado->axioma < 0 || encabezado->axioma >= encabezado->cantidadNoTerminales || encabezado->cantidadProducciones < 0 ||
+        encabezado->cantidadEstados < 1 || encabezado->cantidadColumnas < 1 || encabezado->cantidadColumnas > 257 ||
+        encabezado->estadoInicial < 0 || encabezado->estadoInicial >= encabezado->cantidadEstados) {
+        return false;
+    }
+    const bool conAlias = encabezado->secciones[SECCION_ALIAS].tamanio != 0;
+    uint64_t tamanios[CANTIDAD_SECCIONES];
+    calcularTamaniosSecciones(encabezado, conAlias, tamanios);
+    for (int seccion = 0; seccion < CANTIDAD_SECCIONES; seccion++) {
+        const UbicacionSeccion ubicacion = encabezado->secciones[seccion];
+        if (ubicacion.tamanio != tamanios[seccion] || ubicacion.desplazamiento % ALINEACION_SERIALIZACION != 0 ||
+            ubicacion.desplazamiento < sizeof(EncabezadoSerializado) || ubicacion.desplazamiento > tamanioArchivo ||
+            ubicacion.tamanio > tamanioArchivo - ubicacion.desplazamiento) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+        Recorre una vez las tablas mapeadas para verificar los índices que el
+        generador y el reconocedor usan sin controlar: que las filas estén
+        ordenadas y cubran todas las producciones, que cada transición vaya a
+        una fila existente, que cada alias quede dentro de la fila de su
+        producción y que cada transición del autómata vaya a un estado
+        existente. Así un archivo corrupto con checksum válido se rechaza en
+        lugar de leer fuera de las tablas.
+ */
+static bool sonTablasConsistentes(const GramaticaCompilada *compilada, const Automata *automata) {
+    const int *inicioFila = compilada->inicioFila;
+    if (inicioFila[0] != 0 || inicioFila[compilada->cantidadNoTerminales] != compilada->cantidadProducciones) {
+        return false;
+    }
+    for (int fila = 0; fila < compilada->cantidadNoTerminales; fila++) {
+        if (inicioFila[fila] > inicioFila[fila + 1]) {
+            return false;
+        }
+        for (int i = inicioFila[fila]; i < inicioFila[fila + 1]; i++) {
+            const int siguiente = compilada->transiciones[i].siguiente;
+            if ((siguiente != SIN_NO_TERMINAL && (siguiente < 0 || siguiente >= compilada->cantidadNoTerminales)) ||
+                (compilada->alias != NULL && (compilada->alias[i] < inicioFila[fila] || compilada->alias[i] >= inicioFila[fila + 1]))) {
+                return false;
+            }
+        }
+    }
+    for (int byte = 0; byte < 256; byte++) {
+        if (automata->clase[byte] >= automata->cantidadColumnas) {
+            return false;
+        }
+    }
+    const size_t cantidadTransiciones = (size_t)automata->cantidadEstados * automata->cantidadColumnas;
+    for (size_t i = 0; i < cantidadTransiciones; i++) {
+        if (automata->transiciones[i] < 0 || automata->transiciones[i] >= automata->cantidadEstados) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Valida el archivo ya mapeado en "cargada" y arma las estructuras. Devuelve NULL o la descripción del problema.
+const char *leerGramaticaMapeada(GramaticaCargada *cargada) {
+    const unsigned char *datos = cargada->archivo.datos;
+    const size_t tamanio = cargada->archivo.tamanio;
+    EncabezadoSerializado encabezado;
+    const char *error = NULL;
+    if (tamanio < sizeof(encabezado)) {
+        error = "no es una gramatica compilada";
+    } else {
+        memcpy(&encabezado, datos, sizeof(encabezado));
+        if (memcmp(encabezado.magia, MAGIA_SERIALIZACION, sizeof(encabezado.magia)) != 0) {
+            error = "no es una gramatica compilada";
+        } else if (encabezado.version != VERSION_SERIALIZACION || encabezado.marcaOrden != MARCA_ORDEN_BYTES) {
+            error = "fue generado por otra version del programa o en otra plataforma (volver a generarlo con --guardar)";
+        } else if (encabezado.tamanioArchivo != tamanio || encabezado.checksum != checksumArchivo(datos, tamanio) ||
+                   !esEncabezadoConsistente(&encabezado, tamanio)) {
+            error = "esta truncado o corrupto";
+        }
+    }
+    if (error != NULL) {
+        return error;
+    }
+
+    GramaticaCompilada *compilada = &cargada->compilada;
+    compilada->cantidadNoTerminales = encabezado.cantidadNoTerminales;
+    compilada->cantidadProducciones = encabezado.cantidadProducciones;
+    compilada->axioma = encabezado.axioma;
+    compilada->produccionesDescartadas = encabezado.produccionesDescartadas;
+    compilada->cantidadNombres = encabezado.cantidadNombres;
+    compilada->palabrasPorConjunto = encabezado.palabrasPorConjunto;
+    compilada->longitudNombres = (size_t)encabezado.longitudNombres;
+    compilada->esLinealAIzquierda = encabezado.esLinealAIzquierda;
+    compilada->esPonderada = encabezado.esPonderada;
+    Automata *automata = &cargada->automata;
+    automata->cantidadEstados = encabezado.cantidadEstados;
+    automata->cantidadColumnas = encabezado.cantidadColumnas;
+    automata->estadoInicial = encabezado.estadoInicial;
+    automata->estadosAFN = encabezado.estadosAFN;
+    automata->estadosSinMinimizar = encabezado.estadosSinMinimizar;
+    memcpy(automata->clase, encabezado.clase, sizeof(automata->clase));
+
+    // Las tablas no se copian: apuntan al archivo mapeado (de solo lectura).
+    void *secciones[CANTIDAD_SECCIONES];
+    for (int seccion = 0; seccion < CANTIDAD_SECCIONES; seccion++) {
+        const UbicacionSeccion ubicacion = encabezado.secciones[seccion];
+        secciones[seccion] = ubicacion.tamanio > 0 ? (void *)(datos + ubicacion.desplazamiento) : NULL;
+    }
+    compilada->inicioFila = secciones[SECCION_INICIO_FILA];
+    compilada->producciones = secciones[SECCION_PRODUCCIONES];
+    compilada->transiciones = secciones[SECCION_TRANSICIONES];
+    compilada->probabilidadAlias = secciones[SECCION_PROBABILIDAD_ALIAS];
+    compilada->alias = secciones[SECCION_ALIAS];
+    automata->simbolos = secciones[SECCION_SIMBOLOS];
+    automata->transiciones = secciones[SECCION_TRANSICIONES_AUTOMATA];
+    automata->esFinal = secciones[SECCION_FINALES];
+    compilada->usados = secciones[SECCION_CONJUNTOS];
+    compilada->productivos = compilada->usados + compilada->palabrasPorConjunto;
+    compilada->alcanzables = compilada->productivos + compilada->palabrasPorConjunto;
+    compilada->inicioNombre = secciones[SECCION_INICIO_NOMBRES];
+    compilada->nombres = secciones[SECCION_NOMBRES];
+    // Los nombres se muestran como C Strings: cada uno tiene que empezar dentro de la sección y esta terminar en '\0'.
+    if (compilada->longitudNombres == 0 || compilada->nombres[compilada->longitudNombres - 1] != '\0') {
+        return "esta truncado o corrupto";
+    }
+    for (int i = 0; i < compilada->cantidadNombres; i++) {
+        if (compilada->inicioNombre[i] < 0 || (size_t)compilada->inicioNombre[i] >= compilada->longitudNombres) {
+            return "esta truncado o corrupto";
+        }
+    }
+    return sonTablasConsistentes(compilada, automata) ? NULL : "esta truncado o corrupto";
+}
+
+bool cargarGramaticaCompilada(const char *ruta, GramaticaCargada *cargada) {
+    memset(cargada, 0, sizeof(GramaticaCargada));
+    if (!mapearArchivo(ruta, &cargada->archivo)) {
+        printerr("No se pudo abrir el archivo: %s\n", ruta);
+        return false;
+    }
+    const char *error = leerGramaticaMapeada(cargada);
+    if (error != NULL) {
+        printerr("El archivo %s %s\n", ruta, error);
+        desmapearArchivo(&cargada->archivo);
+        return false;
+    }
+    return true;
+}
+
+void cerrarGramaticaCargada(GramaticaCargada *cargada) {
+    desmapearArchivo(&cargada->archivo);
+}
@@ -0,0 +1,21 @@
+#ifndef SERIALIZACION_H
+#define SERIALIZACION_H
+
+#include "gramatica.h"
+
+// Gramática cargada desde un archivo: sus tablas apuntan al archivo mapeado (no se liberan con destruirGramaticaCompilada).
+typedef struct {
+    ArchivoMapeado archivo;
+    GramaticaCompilada compilada;
+    Automata automata;
+} GramaticaCargada;
+
+bool guardarGramaticaCompilada(const char* ruta, const GramaticaCompilada* compilada, const Automata* automata);
+
+bool cargarGramaticaCompilada(const char* ruta, GramaticaCargada* cargada);
+
+void cerrarGramaticaCargada(GramaticaCargada* cargada);
+
+const char* leerGramaticaMapeada(GramaticaCargada* cargada);
+
+#endif
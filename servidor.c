@@ -0,0 +1,452 @@
+#include "servidor.h"
+#include "cache.h"
+
+/*
+        Modo servidor: lee pedidos de stdin, uno por línea, y mantiene en
+        memoria las gramáticas compiladas entre pedidos. Cada pedido empieza
+        con un identificador elegido por el cliente:
+
+            <id> gramatica <nombre> <no-terminales> <terminales> <producciones> <axioma>
+            <id> descartar <nombre>
+            <id> validar <no-terminales> <terminales> <producciones> <axioma>
+            <id> generar <nombre> <cantidad> [semilla]
+            <id> reconocer <nombre> <cadena>...     ("@" es la cadena vacía)
+
+        Las respuestas se escriben en stdout como marcos "<id> <tipo>
+        <bytes>\n" seguidos de exactamente <bytes> bytes. Un pedido puede
+        enviar varios marcos "datos" (por ejemplo, un bloque de palabras a la
+        vez) y termina siempre con un marco "ok" o "error". Los marcos de
+        pedidos distintos pueden intercalarse, pero cada marco se escribe
+        completo. El cuerpo de un marco "error" explica el problema; en
+        "gramatica" y "validar" es el diagnóstico del parseo o la validación,
+        que nunca se escribe en stderr.
+
+        El hilo lector ejecuta en orden los pedidos "gramatica" y
+        "descartar", así que un pedido siempre ve las gramáticas definidas
+        antes que él; el resto se reparte entre los trabajadores por una cola
+        acotada. Cada pedido toma una referencia a su gramática, de modo que
+        redefinirla o descartarla no afecta a los pedidos en curso. "generar"
+        usa la misma semilla por bloque que la opción -n, por lo que con la
+        misma semilla devuelve las mismas palabras.
+ */
+
+#define CAPACIDAD_COLA_SERVIDOR 256
+
+typedef struct {
+    GramaticaCompilada *compilada;
+    Automata *automata;
+    atomic_int referencias;     // Pedidos que la usan, más uno mientras está registrada.
+} GramaticaCompartida;
+
+typedef struct {
+    char *nombre;
+    GramaticaCompartida *gramatica;
+} GramaticaRegistrada;
+
+typedef enum {
+    PEDIDO_VALIDAR,
+    PEDIDO_GENERAR,
+    PEDIDO_RECONOCER
+} TipoPedido;
+
+typedef struct {
+    TipoPedido tipo;
+    char *linea;                        // Copia de la línea; "id" y "argumentos" apuntan dentro de ella.
+    const char *id;
+    char *argumentos;                   // Campos que quedan sin leer.
+    GramaticaCompartida *gramatica;     // NULL en "validar".
+    size_t cantidad;
+    uint64_t semilla;
+} PedidoServidor;
+
+typedef struct {
+    Mutex mutexCola;
+    Condicion hayPedidos;
+    Condicion hayLugar;
+    PedidoServidor *cola[CAPACIDAD_COLA_SERVIDOR];
+    int inicioCola;
+    int cantidadCola;
+    bool cerrando;
+    Mutex mutexSalida;
+    FILE *salida;
+} Servidor;
+
+// Devuelve el siguiente campo separado por espacios (terminándolo en el lugar) o NULL si no quedan.
+static char *siguienteCampo(char **cursor) {
+    char *inicio = *cursor;
+    while (*inicio == ' ' || *inicio == '\t') {
+        inicio++;
+    }
+    if (*inicio == '\0') {
+        *cursor = inicio;
+        return NULL;
+    }
+    char *fin = inicio;
+    while (*fin != '\0' && *fin != ' ' && *fin != '\t') {
+        fin++;
+    }
+    *cursor = *fin != '\0' ? fin + 1 : fin;
+    *fin = '\0';
+    return inicio;
+}
+
+static void responder(Servidor *servidor, const char *id, const char *tipo, const char *datos, const size_t longitud) {
+    bloquearMutex(&servidor->mutexSalida);
+    fprintf(servidor->salida, "%s %s %zu\n", id, tipo, longitud);
+    fwrite(datos, 1, longitud, servidor->salida);
+    fflush(servidor->salida);
+    desbloquearMutex(&servidor->mutexSalida);
+}
+
+static void responderMensaje(Servidor *servidor, const char *id, const char *tipo, const char *mensaje) {
+    responder(servidor, id, tipo, mensaje, strlen(mensaje));
+}
+
+// Responde un marco "error" con los diagnósticos capturados durante el pedido o, si no hubo ninguno, con "mensaje".
+static void responderDiagnosticos(Servidor *servidor, const char *id, Diagnosticos *diagnosticos, const char *mensaje) {
+    if (diagnosticos->longitud == 0) {
+        responderMensaje(servidor, id, "error", mensaje);
+        return;
+    }
+    if (diagnosticos->texto[diagnosticos->longitud - 1] != '\n') {
+        if (diagnosticos->longitud == sizeof(diagnosticos->texto) - 1) {
+            diagnosticos->longitud--;
+        }
+        diagnosticos->texto[diagnosticos->longitud++] = '\n';
+    }
+    responder(servidor, id, "error", diagnosticos->texto, diagnosticos->longitud);
+}
+
+static void liberarGramaticaCompartida(GramaticaCompartida *gramatica) {
+    if (gramatica != NULL && atomic_fetch_sub(&gramatica->referencias, 1) == 1) {
+        destruirAutomata(gramatica->automata);
+        destruirGramaticaCompilada(gramatica->compilada);
+        tfree(gramatica);
+    }
+}
+
+static void destruirPedido(PedidoServidor *pedido) {
+    liberarGramaticaCompartida(pedido->gramatica);
+    tfree(pedido->linea);
+    tfree(pedido);
+}
+
+// Lee los cuatro campos de una gramática. Devuelve false si falta alguno.
+static bool leerDescripcionPedido(char **cursor, DescripcionGramatica *descripcion) {
+    descripcion->simbolosNoTerminales = siguienteCampo(cursor);
+    descripcion->simbolosTerminales = siguienteCampo(cursor);
+    descripcion->producciones = siguienteCampo(cursor);
+    descripcion->axioma = siguienteCampo(cursor);
+    return descripcion->axioma != NULL;
+}
+
+// Los errores de parseo y validación se devuelven en el marco "error" (el trabajador captura sus diagnósticos).
+static void atenderValidacion(Servidor *servidor, PedidoServidor *pedido, Diagnosticos *diagnosticos) {
+    DescripcionGramatica descripcion;
+    if (!leerDescripcionPedido(&pedido->argumentos, &descripcion)) {
+        responderMensaje(servidor, pedido->id, "error", "faltan campos de la gramatica\n");
+        return;
+    }
+    Gramatica *gramatica = crearGramaticaDesdeCadenas(descripcion.simbolosNoTerminales, descripcion.simbolosTerminales,
+                                                      descripcion.producciones, descripcion.axioma);
+    if (gramatica == NULL) {
+        responderDiagnosticos(servidor, pedido->id, diagnosticos, "la gramatica tiene errores de formato\n");
+    } else if (!esGramaticaRegular(gramatica)) {
+        responderDiagnosticos(servidor, pedido->id, diagnosticos, "la gramatica no es regular\n");
+    } else {
+        responderMensaje(servidor, pedido->id, "ok", "la gramatica es regular\n");
+    }
+    destruirGramatica(gramatica);
+}
+
+static void atenderGeneracion(Servidor *servidor, PedidoServidor *pedido, BufferPalabras *buffer) {
+    const GramaticaCompilada *compilada = pedido->gramatica->compilada;
+    if (esLenguajeVacio(compilada)) {
+        responderMensaje(servidor, pedido->id, "error", "el lenguaje de la gramatica es vacio\n");
+        return;
+    }
+    for (size_t generadas = 0; generadas < pedido->cantidad; generadas += BLOQUE_PALABRAS) {
+        const size_t restantes = pedido->cantidad - generadas;
+        const size_t cantidadBloque = restantes < BLOQUE_PALABRAS ? restantes : BLOQUE_PALABRAS;
+        GeneradorAleatorio generador;
+        sembrarGenerador(&generador, pedido->semilla + generadas / BLOQUE_PALABRAS);
+        buffer->longitud = 0;
+        if (generarPalabras(compilada, &generador, cantidadBloque, buffer) != cantidadBloque) {
+            responderMensaje(servidor, pedido->id, "error", "no se pudieron generar todas las palabras\n");
+            return;
+        }
+        responder(servidor, pedido->id, "datos", buffer->datos, buffer->longitud);
+    }
+    responder(servidor, pedido->id, "ok", "", 0);
+}
+
+static void atenderReconocimiento(Servidor *servidor, PedidoServidor *pedido, BufferPalabras *buffer) {
+    buffer->longitud = 0;
+    const char *cadena;
+    while ((cadena = siguienteCampo(&pedido->argumentos)) != NULL) {
+        const size_t longitud = strcmp(cadena, (char[]){EPSILON, '\0'}) == 0 ? 0 : strlen(cadena);
+        if (!reservarBufferPalabras(buffer, buffer->longitud + 2)) {
+            responderMensaje(servidor, pedido->id, "error", "no hay memoria\n");
+            return;
+        }
+        buffer->datos[buffer->longitud++] = aceptaPalabra(pedido->gramatica->automata, cadena, longitud) ? '1' : '0';
+        buffer->datos[buffer->longitud++] = '\n';
+    }
+    responder(servidor, pedido->id, "ok", buffer->datos, buffer->longitud);
+}
+
+static RETORNO_HILO ejecutarTrabajadorServidor(void *argumento) {
+    Servidor *servidor = argumento;
+    BufferPalabras buffer;
+    inicializarBufferPalabras(&buffer, MEMORIA_SERVIDOR);
+    // Los trabajadores no escriben en stderr: lo que reportaría printerr queda en "diagnosticos".
+    Diagnosticos diagnosticos;
+    while (true) {
+        bloquearMutex(&servidor->mutexCola);
+        while (servidor->cantidadCola == 0 && !servidor->cerrando) {
+            esperarCondicion(&servidor->hayPedidos, &servidor->mutexCola);
+        }
+        if (servidor->cantidadCola == 0) {
+            desbloquearMutex(&servidor->mutexCola);
+            break;
+        }
+        PedidoServidor *pedido = servidor->cola[servidor->inicioCola];
+        servidor->inicioCola = (servidor->inicioCola + 1) % CAPACIDAD_COLA_SERVIDOR;
+        servidor->cantidadCola--;
+        despertarUno(&servidor->hayLugar);
+        desbloquearMutex(&servidor->mutexCola);
+
+        capturarDiagnosticos(&diagnosticos);
+        if (pedido->tipo == PEDIDO_VALIDAR) {
+            atenderValidacion(servidor, pedido, &diagnosticos);
+        } else if (pedido->tipo == PEDIDO_GENERAR) {
+            atenderGeneracion(servidor, pedido, &buffer);
+        } else {
+            atenderReconocimiento(servidor, pedido, &buffer);
+        }
+        destruirPedido(pedido);
+    }
+    capturarDiagnosticos(NULL);
+    liberarBufferPalabras(&buffer);
+    INSTRUMENTAR(volcarInstrumentacion();)
+    volcarContadoresMemoria();
+    return 0;
+}
+
+static void encolarPedido(Servidor *servidor, PedidoServidor *pedido) {
+    bloquearMutex(&servidor->mutexCola);
+    while (servidor->cantidadCola == CAPACIDAD_COLA_SERVIDOR) {
+        esperarCondicion(&servidor->hayLugar, &servidor->mutexCola);
+    }
+    servidor->cola[(servidor->inicioCola + servidor->cantidadCola) % CAPACIDAD_COLA_SERVIDOR] = pedido;
+    servidor->cantidadCola++;
+    despertarUno(&servidor->hayPedidos);
+    desbloquearMutex(&servidor->mutexCola);
+}
+
+// Registro de gramáticas por nombre (solo lo usa el hilo lector).
+typedef struct {
+    GramaticaRegistrada *gramaticas;
+    int cantidad;
+    int capacidad;
+} RegistroGramaticas;
+
+static int buscarGramaticaRegistrada(const RegistroGramaticas *registro, const char *nombre) {
+    for (int i = 0; i < registro->cantidad; i++) {
+        if (strcmp(registro->gramaticas[i].nombre, nombre) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void descartarGramaticaRegistrada(RegistroGramaticas *registro, const int indice) {
+    tfree(registro->gramaticas[indice].nombre);
+    liberarGramaticaCompartida(registro->gramaticas[indice].gramatica);
+    registro->gramaticas[indice] = registro->gramaticas[--registro->cantidad];
+}
+
+static bool registrarGramatica(RegistroGramaticas *registro, const char *nombre, GramaticaCompartida *gramatica) {
+    const int existente = buscarGramaticaRegistrada(registro, nombre);
+    if (existente >= 0) {
+        liberarGramaticaCompartida(registro->gramaticas[existente].gramatica);
+        registro->gramaticas[existente].gramatica = gramatica;
+        return true;
+    }
+    if (registro->cantidad == registro->capacidad) {
+        const int nuevaCapacidad = registro->capacidad > 0 ? registro->capacidad * 2 : 16;
+        GramaticaRegistrada *nuevas = trealloc(registro->gramaticas, nuevaCapacidad * sizeof(GramaticaRegistrada), MEMORIA_SERVIDOR);
+        if (nuevas == NULL) {
+            return false;
+        }
+        registro->gramaticas = nuevas;
+        registro->capacidad = nuevaCapacidad;
+    }
+    char *copia = tmalloc(strlen(nombre) + 1, MEMORIA_SERVIDOR);
+    if (copia == NULL) {
+        return false;
+    }
+    strcpy(copia, nombre);
+    registro->gramaticas[registro->cantidad++] = (GramaticaRegistrada){copia, gramatica};
+    return true;
+}
+
+// Compila y registra la gramática del pedido "gramatica" (en el hilo lector).
+static void atenderDefinicion(Servidor *servidor, RegistroGramaticas *registro, const char *id, const char *nombre, char *argumentos) {
+    DescripcionGramatica descripcion;
+    if (nombre == NULL || !leerDescripcionPedido(&argumentos, &descripcion)) {
+        responderMensaje(servidor, id, "error", "uso: <id> gramatica <nombre> <no-terminales> <terminales> <producciones> <axioma>\n");
+        return;
+    }
+    GramaticaCompartida *gramatica = tcalloc(1, sizeof(GramaticaCompartida), MEMORIA_SERVIDOR);
+    if (gramatica == NULL) {
+        responderMensaje(servidor, id, "error", "no hay memoria\n");
+        return;
+    }
+    Diagnosticos diagnosticos;
+    capturarDiagnosticos(&diagnosticos);
+    const bool esValida = compilarDescripcion(&descripcion, &gramatica->compilada, &gramatica->automata);
+    capturarDiagnosticos(NULL);
+    if (!esValida) {
+        tfree(gramatica);
+        responderDiagnosticos(servidor, id, &diagnosticos, "la gramatica no es valida\n");
+        return;
+    }
+    atomic_init(&gramatica->referencias, 1);
+    if (!registrarGramatica(registro, nombre, gramatica)) {
+        liberarGramaticaCompartida(gramatica);
+        responderMensaje(servidor, id, "error", "no hay memoria\n");
+        return;
+    }
+    responder(servidor, id, "ok", "", 0);
+}
+
+// Interpreta una línea. Los pedidos para los trabajadores se encolan y el resto se responde acá.
+static void atenderLinea(Servidor *servidor, RegistroGramaticas *registro, const char *linea, const uint64_t semillaPorDefecto) {
+    PedidoServidor *pedido = tcalloc(1, sizeof(PedidoServidor), MEMORIA_SERVIDOR);
+    char *copia = tmalloc(strlen(linea) + 1, MEMORIA_SERVIDOR);
+    if (pedido == NULL || copia == NULL) {
+        memprinterr();
+        tfree(pedido);
+        tfree(copia);
+        return;
+    }
+    strcpy(copia, linea);
+    pedido->linea = copia;
+    char *cursor = copia;
+    pedido->id = siguienteCampo(&cursor);
+    const char *comando = siguienteCampo(&cursor);
+    if (pedido->id == NULL || pedido->id[0] == '#') {
+        destruirPedido(pedido);
+        return;
+    }
+    if (comando == NULL) {
+        responderMensaje(servidor, pedido->id, "error", "falta el comando\n");
+        destruirPedido(pedido);
+        return;
+    }
+    if (strcmp(comando, "gramatica") == 0 || strcmp(comando, "descartar") == 0) {
+        const char *nombre = siguienteCampo(&cursor);
+        if (comando[0] == 'g') {
+            atenderDefinicion(servidor, registro, pedido->id, nombre, cursor);
+        } else {
+            const int indice = nombre != NULL ? buscarGramaticaRegistrada(registro, nombre) : -1;
+            if (indice >= 0) {
+                descartarGramaticaRegistrada(registro, indice);
+                responder(servidor, pedido->id, "ok", "", 0);
+            } else {
+                responderMensaje(servidor, pedido->id, "error", "gramatica desconocida\n");
+            }
+        }
+        destruirPedido(pedido);
+        return;
+    }
+    const char *error = NULL;
+    if (strcmp(comando, "validar") == 0) {
+        pedido->tipo = PEDIDO_VALIDAR;
+    } else if (strcmp(comando, "generar") == 0 || strcmp(comando, "reconocer") == 0) {
+        pedido->tipo = comando[0] == 'g' ? PEDIDO_GENERAR : PEDIDO_RECONOCER;
+        const char *nombre = siguienteCampo(&cursor);
+        const int indice = nombre != NULL ? buscarGramaticaRegistrada(registro, nombre) : -1;
+        if (indice < 0) {
+            error = "gramatica desconocida\n";
+        } else {
+            pedido->gramatica = registro->gramaticas[indice].gramatica;
+            atomic_fetch_add(&pedido->gramatica->referencias, 1);
+        }
+        if (error == NULL && pedido->tipo == PEDIDO_GENERAR) {
+            const char *cantidad = siguienteCampo(&cursor);
+            const char *semilla = siguienteCampo(&cursor);
+            size_t valor = semillaPorDefecto;
+            if (!parsearNumero(cantidad, &pedido->cantidad) || (semilla != NULL && !parsearNumero(semilla, &valor))) {
+                error = "uso: <id> generar <nombre> <cantidad> [semilla]\n";
+            }
+            pedido->semilla = valor;
+        }
+    } else {
+        error = "comando desconocido\n";
+    }
+    if (error != NULL) {
+        responderMensaje(servidor, pedido->id, "error", error);
+        destruirPedido(pedido);
+        return;
+    }
+    pedido->argumentos = cursor;
+    encolarPedido(servidor, pedido);
+}
+
+// Atiende los pedidos de "entrada" hasta que se termina y espera a que se respondan todos.
+bool ejecutarServidor(int cantidadHilos, const uint64_t semillaPorDefecto, FILE *entrada, FILE *salida) {
+    if (cantidadHilos > MAX_HILOS) {
+        cantidadHilos = MAX_HILOS;
+    }
+    Servidor servidor;
+    memset(&servidor, 0, sizeof(servidor));
+    servidor.salida = salida;
+    inicializarMutex(&servidor.mutexCola);
+    inicializarMutex(&servidor.mutexSalida);
+    inicializarCondicion(&servidor.hayPedidos);
+    inicializarCondicion(&servidor.hayLugar);
+    Hilo *hilos = tmalloc(cantidadHilos * sizeof(Hilo), MEMORIA_SERVIDOR);
+    if (hilos == NULL) {
+        memprinterr();
+        return false;
+    }
+    int hilosCreados = 0;
+    while (hilosCreados < cantidadHilos && crearHilo(&hilos[hilosCreados], ejecutarTrabajadorServidor, &servidor)) {
+        hilosCreados++;
+    }
+    bool exito = hilosCreados > 0;
+    if (!exito) {
+        printerr("No se pudo crear ningun hilo para el servidor.\n");
+    }
+
+    RegistroGramaticas registro = {NULL, 0, 0};
+    BufferPalabras linea;
+    inicializarBufferPalabras(&linea, MEMORIA_SERVIDOR);
+    size_t pedidos = 0;
+    while (exito && leerLinea(entrada, &linea)) {
+        atenderLinea(&servidor, &registro, linea.datos, semillaPorDefecto);
+        pedidos++;
+    }
+    liberarBufferPalabras(&linea);
+
+    bloquearMutex(&servidor.mutexCola);
+    servidor.cerrando = true;
+    despertarTodos(&servidor.hayPedidos);
+    desbloquearMutex(&servidor.mutexCola);
+    for (int i = 0; i < hilosCreados; i++) {
+        esperarHilo(hilos[i]);
+    }
+    while (registro.cantidad > 0) {
+        descartarGramaticaRegistrada(&registro, registro.cantidad - 1);
+    }
+    tfree(registro.gramaticas);
+    tfree(hilos);
+    destruirCondicion(&servidor.hayPedidos);
+    destruirCondicion(&servidor.hayLugar);
+    destruirMutex(&servidor.mutexCola);
+    destruirMutex(&servidor.mutexSalida);
+    fprintf(stderr, "Servidor: %zu lineas atendidas con %d trabajador(es)\n", pedidos, hilosCreados);
+    return exito;
+}
@@ -0,0 +1,8 @@
+#ifndef SERVIDOR_H
+#define SERVIDOR_H
+
+#include "gramatica.h"
+
+bool ejecutarServidor(int cantidadHilos, uint64_t semillaPorDefecto, FILE* entrada, FILE* salida);
+
+#endif